@@ -1,6 +1,14 @@
 TEMPLATE = subdirs
 
-SUBDIRS = editor
+SUBDIRS = editor cli
 
 editor.file = src/editor.pro
+cli.file = src/cli.pro
 
+
+# Benchmarks, built with `qmake CONFIG+=bench`.
+bench {
+  SUBDIRS += bench_render bench_edit
+  bench_render.file = src/bench_render.pro
+  bench_edit.file = src/bench_edit.pro
+}
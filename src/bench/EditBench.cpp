@@ -0,0 +1,355 @@
+// Times the event-list operations and edit actions behind every
+// collaborative edit, at a range of song sizes, to track how they scale.
+//
+// Songs come from the synthetic generator with a fixed number of units and a
+// growing number of events. Each result is printed as one JSON object per
+// line, e.g.
+//   {"bench":"evelist.add","events":10000,"units":8,"param":0,"ops":2000,
+//    "ns_per_op":1234.5}
+// where [param] is bench-specific (e.g. the number of uncommitted local
+// actions for controller.remote, or notes per paste for action.paste_*). The
+// wire.* benches don't depend on the song and report bytes per action per
+// codec instead.
+
+#include <QCoreApplication>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SyntheticSong.h"
+#include "editor/PxtoneController.h"
+#include "protocol/PxtoneEditAction.h"
+#include "protocol/WireCodec.h"
+
+namespace {
+constexpr int UNIT_NUM = 8;
+constexpr int NOTES_PER_MEAS = 4;
+constexpr int PARAMS_PER_MEAS = 1;
+// Events the generator makes per measure per unit: key, velocity and on per
+// note, plus params.
+constexpr int EVENTS_PER_UNIT_MEAS = NOTES_PER_MEAS * 3 + PARAMS_PER_MEAS;
+constexpr int EVENT_MAX = 1000000;
+
+void report(const char *bench, int events, int param, int ops, double ns) {
+  std::printf(
+      "{\"bench\":\"%s\",\"events\":%d,\"units\":%d,\"param\":%d,\"ops\":%d,"
+      "\"ns_per_op\":%.1f}\n",
+      bench, events, UNIT_NUM, param, ops, ops ? ns / ops : 0.0);
+  std::fflush(stdout);
+}
+
+void reportWire(const char *bench, const char *codec, int ops, double ns,
+                qint64 bytes) {
+  std::printf(
+      "{\"bench\":\"%s\",\"codec\":\"%s\",\"ops\":%d,"
+      "\"ns_per_op\":%.1f,\"bytes_per_op\":%.1f}\n",
+      bench, codec, ops, ops ? ns / ops : 0.0, ops ? double(bytes) / ops : 0.0);
+  std::fflush(stdout);
+}
+
+const char *codecName(WireCodec codec) {
+  switch (codec) {
+    case WIRE_DATASTREAM:
+      return "datastream";
+    case WIRE_COMPACT:
+      return "compact";
+    case WIRE_COMPACT_DEFLATE:
+      return "compact_deflate";
+  }
+  return "";
+}
+
+double timeNs(const std::function<void()> &f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double, std::nano>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+std::unique_ptr<pxtnService> makeSong(int events, double *build_ns) {
+  SyntheticSongSpec spec{
+      "edit", UNIT_NUM, 1, NOTES_PER_MEAS, PARAMS_PER_MEAS, 0, 0, 5};
+  spec.meas_num = std::max(1, events / (UNIT_NUM * EVENTS_PER_UNIT_MEAS));
+  std::unique_ptr<pxtnService> pxtn = std::make_unique<pxtnService>();
+  if (pxtn->init_collage(EVENT_MAX) != pxtnOK) return nullptr;
+  pxtnERR res;
+  *build_ns = timeNs([&]() { res = generateSyntheticSong(pxtn.get(), spec); });
+  if (res != pxtnOK) return nullptr;
+  return pxtn;
+}
+
+struct Bench {
+  std::mt19937 rng{7};
+  pxtnService *pxtn;
+  int events;
+  int ops;
+
+  int32_t randomClock() {
+    int32_t last = pxtn->master->get_this_clock(
+        pxtn->master->get_meas_num(), 0, 0);
+    return int32_t(rng() % uint32_t(std::max(last, 1)));
+  }
+  uint8_t randomUnit() { return uint8_t(rng() % UNIT_NUM); }
+
+  // Raw pxtnEvelist calls. Each pair of benches leaves the list as it found
+  // it, so later benches see the same song.
+  void evelist() {
+    pxtnEvelist *evels = pxtn->evels;
+    struct Op {
+      int32_t clock;
+      uint8_t unit;
+    };
+    std::vector<Op> adds(ops);
+    // Odd clocks so as not to land on the generator's notes.
+    for (Op &op : adds) op = {randomClock() | 1, randomUnit()};
+
+    report("evelist.add", events, 0, ops, timeNs([&]() {
+             for (const Op &op : adds)
+               evels->Record_Add_i(op.clock, op.unit, EVENTKIND_PORTAMENT, 1);
+           }));
+    report("evelist.delete", events, 0, ops, timeNs([&]() {
+             for (const Op &op : adds)
+               evels->Record_Delete(op.clock, op.clock + 1, op.unit,
+                                    EVENTKIND_PORTAMENT);
+           }));
+
+    const int32_t width = pxtn->master->get_beat_clock() * 4;
+    report("evelist.value_change", events, 0, ops, timeNs([&]() {
+             for (int i = 0; i < ops; ++i) {
+               const Op &op = adds[i];
+               evels->Record_Value_Change(op.clock, op.clock + width, op.unit,
+                                          EVENTKIND_VOLUME,
+                                          (i % 2 == 0 ? 1 : -1));
+             }
+           }));
+    report("evelist.clock_shift", events, 0, ops, timeNs([&]() {
+             for (int i = 0; i < ops; i += 2) {
+               const Op &op = adds[i];
+               evels->Record_Clock_Shift(op.clock, 10, op.unit);
+               evels->Record_Clock_Shift(op.clock + 10, -10, op.unit);
+             }
+           }));
+  }
+
+  std::vector<Action::Primitive> noteAction(qint32 unit_id, qint32 clock) {
+    return {{EVENTKIND_KEY, unit_id, clock, Action::Add{EVENTDEFAULT_KEY}},
+            {EVENTKIND_VELOCITY, unit_id, clock, Action::Add{100}},
+            {EVENTKIND_ON, unit_id, clock, Action::Add{60}}};
+  }
+
+  // Action::apply_and_get_undo, applying an action and then its undo.
+  void actions() {
+    NoIdMap unit_id_map(pxtn->Unit_Num()), woice_id_map(pxtn->Woice_Num());
+    std::vector<std::vector<Action::Primitive>> notes;
+    for (int i = 0; i < ops; ++i)
+      notes.push_back(noteAction(randomUnit(), randomClock() | 1));
+    std::vector<std::vector<Action::Primitive>> undos(ops);
+
+    report("action.add_note", events, 0, ops, timeNs([&]() {
+             for (int i = 0; i < ops; ++i)
+               undos[i] = Action::apply_and_get_undo(
+                   notes[i], pxtn, nullptr, unit_id_map, woice_id_map);
+           }));
+    report("action.undo_add_note", events, 0, ops, timeNs([&]() {
+             for (int i = ops - 1; i >= 0; --i)
+               Action::apply_and_get_undo(undos[i], pxtn, nullptr, unit_id_map,
+                                          woice_id_map);
+           }));
+
+    // Deleting a beat's worth of every kind, then restoring it.
+    const int32_t width = pxtn->master->get_beat_clock();
+    std::vector<std::vector<Action::Primitive>> deletes;
+    for (int i = 0; i < ops; ++i) {
+      qint32 unit = randomUnit(), clock = randomClock();
+      std::vector<Action::Primitive> action;
+      for (EVENTKIND kind :
+           {EVENTKIND_ON, EVENTKIND_KEY, EVENTKIND_VELOCITY, EVENTKIND_VOLUME})
+        action.push_back({kind, unit, clock, Action::Delete{clock + width}});
+      deletes.push_back(action);
+    }
+    int delete_ops = std::max(1, ops / 10);
+    report("action.delete_beat", events, 0, delete_ops, timeNs([&]() {
+             for (int i = 0; i < delete_ops; ++i)
+               undos[i] = Action::apply_and_get_undo(
+                   deletes[i], pxtn, nullptr, unit_id_map, woice_id_map);
+           }));
+    report("action.undo_delete_beat", events, 0, delete_ops, timeNs([&]() {
+             for (int i = delete_ops - 1; i >= 0; --i)
+               Action::apply_and_get_undo(undos[i], pxtn, nullptr, unit_id_map,
+                                          woice_id_map);
+           }));
+
+    // Pasting a run of notes and undoing it, as one Add per event and as one
+    // batch per kind.
+    constexpr int PASTE_NOTES = 256;
+    int paste_ops = std::max(1, ops / 100);
+    const int32_t spacing = pxtn->master->get_beat_clock() / 4;
+    std::vector<std::vector<Action::Primitive>> pastes, batch_pastes;
+    for (int i = 0; i < paste_ops; ++i) {
+      qint32 unit = randomUnit(), clock = randomClock();
+      std::vector<Action::Primitive> paste;
+      std::vector<std::pair<qint32, qint32>> keys, vels, ons;
+      for (int j = 0; j < PASTE_NOTES; ++j) {
+        for (const auto &p : noteAction(unit, clock + j * spacing))
+          paste.push_back(p);
+        keys.emplace_back(j * spacing, EVENTDEFAULT_KEY);
+        vels.emplace_back(j * spacing, 100);
+        ons.emplace_back(j * spacing, spacing);
+      }
+      pastes.push_back(paste);
+      batch_pastes.push_back(
+          {{EVENTKIND_KEY, unit, clock, Action::AddBatch{keys}},
+           {EVENTKIND_VELOCITY, unit, clock, Action::AddBatch{vels}},
+           {EVENTKIND_ON, unit, clock, Action::AddBatch{ons}}});
+    }
+    for (const auto &[name, actions] :
+         {std::make_pair("action.paste_events", &pastes),
+          std::make_pair("action.paste_batch", &batch_pastes)})
+      report(name, events, PASTE_NOTES, paste_ops, timeNs([&]() {
+               for (const auto &paste : *actions)
+                 Action::apply_and_get_undo(
+                     Action::apply_and_get_undo(paste, pxtn, nullptr,
+                                                unit_id_map, woice_id_map),
+                     pxtn, nullptr, unit_id_map, woice_id_map);
+             }));
+  }
+
+  // Encoding and decoding edits as the server would relay them, in each
+  // codec a client can negotiate.
+  void wire() {
+    std::vector<ServerAction> notes, deletes;
+    const int32_t width = pxtn->master->get_beat_clock();
+    for (int i = 0; i < ops; ++i) {
+      qint32 unit = randomUnit(), clock = randomClock();
+      notes.push_back(
+          {1, ClientAction{EditAction{i, noteAction(unit, clock)}}});
+      std::vector<Action::Primitive> action;
+      for (EVENTKIND kind :
+           {EVENTKIND_ON, EVENTKIND_KEY, EVENTKIND_VELOCITY, EVENTKIND_VOLUME})
+        action.push_back({kind, unit, clock, Action::Delete{clock + width}});
+      deletes.push_back({1, ClientAction{EditAction{i, action}}});
+    }
+
+    for (const auto &named :
+         {std::make_pair("note", &notes), std::make_pair("delete", &deletes)})
+      for (WireCodec codec :
+           {WIRE_DATASTREAM, WIRE_COMPACT, WIRE_COMPACT_DEFLATE}) {
+        const std::vector<ServerAction> *actions = named.second;
+        const char *codec_name = codecName(codec);
+        QByteArray buf;
+        double encode_ns = timeNs([&]() {
+          QDataStream out(&buf, QIODevice::WriteOnly);
+          out.setVersion(QDataStream::Qt_5_5);
+          for (const ServerAction &a : *actions) Wire::write(out, codec, a);
+        });
+        double decode_ns = timeNs([&]() {
+          QDataStream in(buf);
+          in.setVersion(QDataStream::Qt_5_5);
+          for (size_t i = 0; i < actions->size(); ++i) {
+            ServerAction a;
+            Wire::read(in, codec, a);
+          }
+        });
+        std::string bench = std::string("wire.") + named.first;
+        reportWire((bench + "_encode").c_str(), codec_name, ops, encode_ns,
+                   buf.size());
+        reportWire((bench + "_decode").c_str(), codec_name, ops, decode_ns,
+                   buf.size());
+      }
+
+    // The history a joining client gets, which deflate sends in one frame.
+    QList<ServerAction> history;
+    for (size_t i = 0; i < notes.size(); ++i)
+      history << notes[i] << deletes[i];
+    for (WireCodec codec :
+         {WIRE_DATASTREAM, WIRE_COMPACT, WIRE_COMPACT_DEFLATE}) {
+      QByteArray buf;
+      double ns = timeNs([&]() {
+        QDataStream out(&buf, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_5);
+        Wire::write(out, codec, history);
+      });
+      reportWire("wire.history_encode", codecName(codec), history.size(), ns,
+                 buf.size());
+    }
+  }
+
+  // PxtoneController::applyRemoteAction from another user while this one
+  // has [pending] local actions in flight, so each arrival rolls them back
+  // and replays them.
+  void remote(int pending) {
+    mooState moo_state;
+    PxtoneController controller(0, pxtn, &moo_state, nullptr);
+    for (int i = 0; i < pending; ++i)
+      controller.applyLocalAction(noteAction(randomUnit(), randomClock() | 1));
+
+    int remote_ops = std::max(1, ops / 10);
+    std::vector<EditAction> remotes;
+    for (int i = 0; i < remote_ops; ++i)
+      remotes.push_back({i, noteAction(randomUnit(), randomClock() | 1)});
+    report("controller.remote", events, pending, remote_ops, timeNs([&]() {
+             for (const EditAction &a : remotes)
+               controller.applyRemoteAction(a, 1);
+           }));
+  }
+};
+
+std::vector<int> parseList(const char *s) {
+  std::vector<int> v;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    if (!item.empty()) v.push_back(std::stoi(item));
+  return v;
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  // For QTextCodec, which the controller uses.
+  QCoreApplication app(argc, argv);
+
+  std::vector<int> sizes{1000, 10000, 50000};
+  std::vector<int> pendings{0, 8, 64};
+  int ops = 2000;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--sizes" && i + 1 < argc)
+      sizes = parseList(argv[++i]);
+    else if (arg == "--pending" && i + 1 < argc)
+      pendings = parseList(argv[++i]);
+    else if (arg == "--ops" && i + 1 < argc)
+      ops = std::max(2, std::atoi(argv[++i]));
+    else {
+      std::fprintf(stderr,
+                   "usage: %s [--sizes N,...] [--pending N,...] [--ops N]\n",
+                   argv[0]);
+      return 1;
+    }
+  }
+
+  bool ran_wire = false;
+  for (int size : sizes) {
+    double build_ns;
+    std::unique_ptr<pxtnService> pxtn = makeSong(size, &build_ns);
+    if (!pxtn) {
+      std::fprintf(stderr, "Could not generate a song of %d events\n", size);
+      return 1;
+    }
+    int events = pxtn->evels->get_Count();
+    report("evelist.build", events, 0, events, build_ns);
+
+    Bench bench{std::mt19937(7), pxtn.get(), events, ops};
+    bench.evelist();
+    bench.actions();
+    for (int pending : pendings) bench.remote(pending);
+    if (!ran_wire) bench.wire();
+    ran_wire = true;
+  }
+  return 0;
+}
@@ -0,0 +1,298 @@
+// Measures how fast the pxtone engine renders, and checks that it still
+// renders the same thing.
+//
+// Renders each song (generated presets plus any ptcop/pttune given) through
+// pxtnService::Moo at every sample rate x buffer size, reporting samples/sec
+// and realtime factor, then does a profiled pass per song for a per-stage
+// breakdown. Output hashes are compared across buffer sizes (they should never
+// differ) and against a golden file, so an engine optimization can be timed
+// and verified in one run. The golden hashes come from an x86-64 build; other
+// architectures may legitimately round differently. Songs with Ogg woices also
+// depend on the libvorbis decoder (the hashes are from 1.3.7).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SyntheticSong.h"
+#include "pxtone/pxtnService.h"
+
+namespace {
+struct Song {
+  std::string name;
+  // Empty for generated songs.
+  std::vector<char> data;
+  const SyntheticSongSpec *spec;
+};
+
+struct Options {
+  double seconds = 30;
+  std::vector<int> sample_rates{22050, 44100, 48000};
+  std::vector<int> buffer_sizes{256, 1024, 8192};
+  std::string golden_file;
+  bool update_golden = false;
+  bool profile = true;
+  bool synthetic = true;
+  std::vector<std::string> inputs;
+};
+
+struct Result {
+  uint64_t hash;
+  double elapsed;
+  int64_t smp_num;
+};
+
+// One pxtnService plus mooState per run, so runs don't share state.
+struct Player {
+  pxtnService pxtn;
+  mooState moo_state;
+};
+
+uint64_t fnv1a(const void *p, size_t size, uint64_t h) {
+  const unsigned char *b = (const unsigned char *)p;
+  for (size_t i = 0; i < size; ++i) {
+    h ^= b[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+}
+
+std::string load(Player &player, const Song &song, int sample_rate) {
+  pxtnService &pxtn = player.pxtn;
+  if (!song.spec) {
+    if (pxtn.init() != pxtnOK) return "init failed";
+    pxtn.set_destination_quality(2, sample_rate);
+    pxtnDescriptor desc;
+    desc.set_memory_r(song.data.data(), int32_t(song.data.size()));
+    pxtnERR res = pxtn.read(&desc);
+    if (res != pxtnOK) return pxtnError_get_string(res);
+  } else {
+    if (pxtn.init_collage(pxtnMAX_EVENTNUM) != pxtnOK) return "init failed";
+    pxtn.set_destination_quality(2, sample_rate);
+    pxtnERR res = generateSyntheticSong(&pxtn, *song.spec);
+    if (res != pxtnOK) return pxtnError_get_string(res);
+  }
+  if (pxtn.tones_ready(player.moo_state) != pxtnOK) return "tones_ready failed";
+
+  pxtnVOMITPREPARATION prep{};
+  prep.flags |= pxtnVOMITPREPFLAG_loop;
+  prep.start_pos_sample = 0;
+  prep.master_volume = 1;
+  if (!pxtn.moo_preparation(&prep, player.moo_state))
+    return "moo_preparation failed";
+  return "";
+}
+
+Result run(Player &player, int sample_rate, int buffer_size, double seconds) {
+  constexpr int ch = 2;
+  std::vector<int16_t> buf(size_t(buffer_size) * ch);
+  Result r{1469598103934665603ull, 0, 0};
+  int64_t total = int64_t(seconds * sample_rate);
+  auto start = std::chrono::steady_clock::now();
+  while (r.smp_num < total) {
+    int n = int(std::min<int64_t>(buffer_size, total - r.smp_num));
+    if (!player.pxtn.Moo(player.moo_state, buf.data(),
+                         n * ch * int(sizeof(int16_t))))
+      break;
+    r.hash = fnv1a(buf.data(), n * ch * sizeof(int16_t), r.hash);
+    r.smp_num += n;
+  }
+  r.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                            start)
+                  .count();
+  return r;
+}
+
+std::vector<int> parseList(const char *s) {
+  std::vector<int> v;
+  std::stringstream ss(s);
+  std::string item;
+  while (std::getline(ss, item, ','))
+    if (!item.empty()) v.push_back(std::stoi(item));
+  return v;
+}
+
+// Hashes depend on how much gets rendered, so that's part of the key.
+std::string goldenKey(const std::string &name, int sample_rate,
+                      double seconds) {
+  char key[256];
+  std::snprintf(key, sizeof(key), "%s %d %g", name.c_str(), sample_rate,
+                seconds);
+  return key;
+}
+
+std::map<std::string, uint64_t> readGolden(const std::string &filename) {
+  std::map<std::string, uint64_t> golden;
+  std::ifstream in(filename);
+  std::string name, hash;
+  int rate;
+  double seconds;
+  while (in >> name >> rate >> seconds >> hash)
+    golden[goldenKey(name, rate, seconds)] = std::stoull(hash, nullptr, 16);
+  return golden;
+}
+
+bool isProject(const std::filesystem::path &p) {
+  return p.extension() == ".ptcop" || p.extension() == ".pttune";
+}
+
+void usage(const char *argv0) {
+  std::printf(
+      "usage: %s [options] [ptcop/pttune files or dirs...]\n"
+      "  --seconds S        audio to render per run (default 30)\n"
+      "  --rates A,B,...    sample rates (default 22050,44100,48000)\n"
+      "  --buffers A,B,...  Moo buffer sizes in samples (default "
+      "256,1024,8192)\n"
+      "  --golden FILE      compare output hashes against FILE\n"
+      "  --update-golden    write the hashes to FILE instead\n"
+      "  --no-profile       skip the per-stage pass\n"
+      "  --no-synthetic     skip the generated songs\n",
+      argv0);
+}
+}  // namespace
+
+int main(int argc, char **argv) {
+  Options opts;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    bool has_value = (i + 1 < argc);
+    if (arg == "--seconds" && has_value)
+      opts.seconds = std::atof(argv[++i]);
+    else if (arg == "--rates" && has_value)
+      opts.sample_rates = parseList(argv[++i]);
+    else if (arg == "--buffers" && has_value)
+      opts.buffer_sizes = parseList(argv[++i]);
+    else if (arg == "--golden" && has_value)
+      opts.golden_file = argv[++i];
+    else if (arg == "--update-golden")
+      opts.update_golden = true;
+    else if (arg == "--no-profile")
+      opts.profile = false;
+    else if (arg == "--no-synthetic")
+      opts.synthetic = false;
+    else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return 0;
+    } else if (arg.rfind("--", 0) == 0) {
+      usage(argv[0]);
+      return 1;
+    } else
+      opts.inputs.push_back(arg);
+  }
+
+  std::vector<Song> songs;
+  if (opts.synthetic)
+    for (const SyntheticSongSpec &spec : syntheticSongPresets())
+      songs.push_back({"synthetic:" + spec.name, {}, &spec});
+  std::vector<std::filesystem::path> paths;
+  for (const std::string &input : opts.inputs) {
+    if (std::filesystem::is_directory(input)) {
+      for (const auto &e :
+           std::filesystem::recursive_directory_iterator(input))
+        if (e.is_regular_file() && isProject(e.path()))
+          paths.push_back(e.path());
+    } else
+      paths.push_back(input);
+  }
+  std::sort(paths.begin(), paths.end());
+  for (const std::filesystem::path &p : paths) {
+    std::ifstream in(p, std::ios::binary);
+    if (!in) {
+      std::fprintf(stderr, "Could not open %s\n", p.string().c_str());
+      return 1;
+    }
+    songs.push_back({p.filename().string(),
+                     std::vector<char>(std::istreambuf_iterator<char>(in),
+                                       std::istreambuf_iterator<char>()),
+                     nullptr});
+  }
+
+  std::map<std::string, uint64_t> golden, new_golden;
+  if (!opts.golden_file.empty() && !opts.update_golden)
+    golden = readGolden(opts.golden_file);
+
+  int failures = 0;
+  std::printf("%-48s %6s %6s %12s %9s %16s %s\n", "song", "rate", "buffer",
+              "smp/s", "realtime", "hash", "check");
+  for (const Song &song : songs) {
+    for (int rate : opts.sample_rates) {
+      std::optional<uint64_t> first_hash;
+      for (int buffer_size : opts.buffer_sizes) {
+        Player player;
+        std::string err = load(player, song, rate);
+        if (!err.empty()) {
+          std::printf("%-48s %6d %6d could not load: %s\n", song.name.c_str(),
+                      rate, buffer_size, err.c_str());
+          ++failures;
+          break;
+        }
+        Result r = run(player, rate, buffer_size, opts.seconds);
+
+        std::string check;
+        std::string key = goldenKey(song.name, rate, opts.seconds);
+        if (first_hash && *first_hash != r.hash)
+          check = "DIFFERS ACROSS BUFFER SIZES";
+        else if (golden.count(key))
+          check = (golden[key] == r.hash ? "ok" : "GOLDEN MISMATCH");
+        else
+          check = "-";
+        if (check != "ok" && check != "-") ++failures;
+        if (!first_hash) first_hash = r.hash;
+        new_golden[key] = r.hash;
+
+        std::printf("%-48s %6d %6d %12.0f %8.1fx %016llx %s\n",
+                    song.name.c_str(), rate, buffer_size,
+                    r.smp_num / r.elapsed, r.smp_num / (r.elapsed * rate),
+                    (unsigned long long)r.hash, check.c_str());
+        std::fflush(stdout);
+      }
+    }
+  }
+
+  if (opts.profile && !opts.sample_rates.empty()) {
+    int rate = opts.sample_rates[opts.sample_rates.size() / 2];
+    std::printf("\nper-stage time at %d Hz (%% of profiled time)\n", rate);
+    std::printf("%-48s", "song");
+    for (int s = 0; s < pxtnMOOSTAGE_num; ++s)
+      std::printf(" %15s", pxtnMooProfile::stage_name(pxtnMOOSTAGE(s)));
+    std::printf("\n");
+    for (const Song &song : songs) {
+      Player player;
+      if (!load(player, song, rate).empty()) continue;
+      pxtnMooProfile profile;
+      player.moo_state.profile = &profile;
+      run(player, rate, 1024, opts.seconds);
+      int64_t total = 0;
+      for (int64_t ns : profile.ns) total += ns;
+      std::printf("%-48s", song.name.c_str());
+      for (int64_t ns : profile.ns)
+        std::printf(" %14.1f%%", total ? 100.0 * ns / total : 0.0);
+      std::printf("\n");
+    }
+  }
+
+  if (opts.update_golden && !opts.golden_file.empty()) {
+    std::ofstream out(opts.golden_file);
+    for (const auto &[key, hash] : new_golden) {
+      char hex[17];
+      std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+      out << key << " " << hex << "\n";
+    }
+    std::printf("\nwrote %zu hashes to %s\n", new_golden.size(),
+                opts.golden_file.c_str());
+  }
+
+  if (failures > 0) {
+    std::printf("\n%d failure(s)\n", failures);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include "SyntheticSong.h"
+
+#include <cmath>
+#include <random>
+
+const std::vector<SyntheticSongSpec> &syntheticSongPresets() {
+  static const std::vector<SyntheticSongSpec> presets{
+      {"sparse", 4, 16, 1, 0, 0, 0, 1},
+      {"dense", 8, 16, 16, 8, 0, 0, 2},
+      {"many-units", pxtnMAX_TUNEUNITSTRUCT, 16, 4, 1, 0, 0, 3},
+      {"effects", 8, 16, 4, 1, pxtnMAX_TUNEDELAYSTRUCT,
+       pxtnMAX_TUNEOVERDRIVESTRUCT, 4},
+  };
+  return presets;
+}
+
+// A single-cycle wave. PCM woices this short are looped by pxtone.
+static std::vector<char> makeWaveform() {
+  constexpr int sps = 44100, smp_num = 100;
+  std::vector<char> wav;
+  auto put = [&wav](uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) wav.push_back(char((v >> (8 * i)) & 0xFF));
+  };
+  auto tag = [&wav](const char *t) { wav.insert(wav.end(), t, t + 4); };
+  tag("RIFF");
+  put(36 + smp_num * 2, 4);
+  tag("WAVE");
+  tag("fmt ");
+  put(16, 4);
+  put(1, 2);  // PCM
+  put(1, 2);  // mono
+  put(sps, 4);
+  put(sps * 2, 4);
+  put(2, 2);
+  put(16, 2);
+  tag("data");
+  put(smp_num * 2, 4);
+  for (int i = 0; i < smp_num; ++i) {
+    // A sine with some harmonics, so it isn't trivially smooth.
+    double t = 2 * M_PI * i / smp_num;
+    double v =
+        std::sin(t) * 0.6 + std::sin(3 * t) * 0.25 + std::sin(5 * t) * 0.1;
+    put(uint16_t(int16_t(v * 20000)), 2);
+  }
+  return wav;
+}
+
+pxtnERR generateSyntheticSong(pxtnService *pxtn,
+                              const SyntheticSongSpec &spec) {
+  // mt19937's output is fully specified, unlike the std distributions, so
+  // songs come out identical across standard libraries.
+  std::mt19937 rng(spec.seed);
+  auto rand_int = [&rng](uint32_t n) { return int32_t(rng() % n); };
+
+  const int32_t beat_num = EVENTDEFAULT_BEATNUM;
+  const int32_t beat_clock = EVENTDEFAULT_BEATCLOCK;
+  pxtn->master->Set(beat_num, EVENTDEFAULT_BEATTEMPO, beat_clock);
+  pxtn->master->set_meas_num(spec.meas_num);
+
+  std::vector<char> wav = makeWaveform();
+  pxtnDescriptor desc;
+  desc.set_memory_r(wav.data(), int32_t(wav.size()));
+  pxtnERR res = pxtn->Woice_read(0, &desc, pxtnWOICE_PCM);
+  if (res != pxtnOK) return res;
+
+  mooState unused;
+  int32_t group_num = pxtn->Group_Num();
+  for (int d = 0; d < spec.delay_num; ++d)
+    if (!pxtn->Delay_Add(DELAYUNIT_Beat, float(1 + d), 33,
+                         (d + 1) % group_num, unused))
+      return pxtnERR_param;
+  for (int o = 0; o < spec.overdrive_num; ++o)
+    if (!pxtn->OverDrive_Add(70, 2, (o + 1) % group_num)) return pxtnERR_param;
+
+  pxtnEvelist *evels = pxtn->evels;
+  const int32_t meas_clock = beat_num * beat_clock;
+  for (int u = 0; u < spec.unit_num; ++u) {
+    if (!pxtn->Unit_AddNew()) return pxtnERR_param;
+    if (!evels->Record_Add_i(0, u, EVENTKIND_VOICENO, 0) ||
+        !evels->Record_Add_i(0, u, EVENTKIND_GROUPNO, u % group_num))
+      return pxtnERR_memory;
+
+    for (int m = 0; m < spec.meas_num; ++m) {
+      int32_t meas_start = m * meas_clock;
+      if (spec.notes_per_meas > 0) {
+        int32_t step = meas_clock / spec.notes_per_meas;
+        for (int n = 0; n < spec.notes_per_meas; ++n) {
+          int32_t clock = meas_start + n * step;
+          int32_t key = EVENTDEFAULT_BASICKEY + (rand_int(36) - 18) * 0x100;
+          if (!evels->Record_Add_i(clock, u, EVENTKIND_KEY, key) ||
+              !evels->Record_Add_i(clock, u, EVENTKIND_VELOCITY,
+                                   32 + rand_int(96)) ||
+              !evels->Record_Add_i(clock, u, EVENTKIND_ON,
+                                   step / 2 + rand_int(step / 2)))
+            return pxtnERR_memory;
+        }
+      }
+      static const EVENTKIND param_kinds[] = {
+          EVENTKIND_VOLUME, EVENTKIND_PAN_VOLUME, EVENTKIND_PAN_TIME};
+      for (int p = 0; p < spec.params_per_meas; ++p) {
+        EVENTKIND kind = param_kinds[rand_int(3)];
+        if (!evels->Record_Add_i(meas_start + rand_int(meas_clock), u, kind,
+                                 rand_int(128)))
+          return pxtnERR_memory;
+      }
+    }
+  }
+  return pxtnOK;
+}
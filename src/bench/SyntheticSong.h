@@ -0,0 +1,34 @@
+#ifndef SYNTHETICSONG_H
+#define SYNTHETICSONG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pxtone/pxtnService.h"
+
+// Shape of a generated project. Everything about the content is derived from
+// [seed], so the same spec always gives the same song.
+struct SyntheticSongSpec {
+  std::string name;
+  int unit_num;
+  int meas_num;
+  // Per unit.
+  int notes_per_meas;
+  // Per unit: volume / pan / velocity changes sprinkled between notes.
+  int params_per_meas;
+  int delay_num;
+  int overdrive_num;
+  uint32_t seed;
+};
+
+// A spread of shapes to benchmark against: sparse, dense, many units and
+// effect-heavy.
+const std::vector<SyntheticSongSpec> &syntheticSongPresets();
+
+// Fills a freshly initialized [pxtn] with a generated project. Events are
+// written through Record_Add_i, so the service should come from init_collage
+// with enough room for them.
+pxtnERR generateSyntheticSong(pxtnService *pxtn, const SyntheticSongSpec &spec);
+
+#endif  // SYNTHETICSONG_H
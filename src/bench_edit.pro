@@ -0,0 +1,25 @@
+TEMPLATE = app
+TARGET = ptcollab-bench-edit
+INCLUDEPATH += .
+win32:INCLUDEPATH += ../deps/include
+macx:INCLUDEPATH += ../deps/include
+
+QT = core
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+HEADERS += bench/SyntheticSong.h \
+           editor/PxtoneController.h
+SOURCES += bench/EditBench.cpp \
+           bench/SyntheticSong.cpp \
+           editor/EditState.cpp \
+           editor/Interval.cpp \
+           editor/PxtoneController.cpp \
+           protocol/Data.cpp \
+           protocol/Hello.cpp \
+           protocol/NoIdMap.cpp \
+           protocol/PxtoneEditAction.cpp \
+           protocol/RemoteAction.cpp \
+           protocol/WireCodec.cpp
+
+include(engine.pri)
@@ -0,0 +1,17 @@
+TEMPLATE = app
+TARGET = ptcollab-bench-render
+INCLUDEPATH += .
+win32:INCLUDEPATH += ../deps/include
+macx:INCLUDEPATH += ../deps/include
+
+QT = core
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+HEADERS += bench/SyntheticSong.h
+SOURCES += bench/RenderBench.cpp \
+           bench/SyntheticSong.cpp
+
+DISTFILES += bench/render_golden.txt
+
+include(engine.pri)
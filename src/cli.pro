@@ -0,0 +1,24 @@
+TEMPLATE = app
+TARGET = ptcollab-render
+INCLUDEPATH += .
+win32:INCLUDEPATH += ../deps/include
+macx:INCLUDEPATH += ../deps/include
+QMAKE_MACOSX_DEPLOYMENT_TARGET = 10.14
+
+QT = core
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+SOURCES += cli/main.cpp
+
+include(engine.pri)
+
+isEmpty(PREFIX) {
+    win32:PREFIX = C:/ptcollab
+    else:PREFIX = /opt/ptcollab
+}
+win32:target.path = $$PREFIX
+else:target.path = $$PREFIX/bin
+INSTALLS += target
@@ -0,0 +1,300 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QTextStream>
+#include <QThread>
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+#include "pxtone/pxtnService.h"
+#include "render/Renderer.h"
+
+// Renders ptcop / pttune files without the editor, e.g. for batch previews.
+
+struct Options {
+  std::optional<double> length;
+  int loops;
+  double fadeout;
+  int sample_rate;
+  pxtnSAMPLEFORMAT sample_format;
+  AudioFileFormat format;
+  pxtnSTEMKIND stems;
+  bool profile;
+};
+
+struct Job {
+  QString input;
+  QString output;
+};
+
+struct Input {
+  QString path;
+  // The directory argument it was found under, if any.
+  QString root;
+};
+
+static std::mutex output_mutex;
+static void report(const QString &s, bool error = false) {
+  std::lock_guard<std::mutex> lock(output_mutex);
+  QTextStream(error ? stderr : stdout) << s << "\n";
+}
+
+// Returns the number of seconds rendered. Throws a QString on failure.
+static double renderJob(const Job &job, const Options &opts,
+                        pxtnMooProfile *profile) {
+  QFile file(job.input);
+  if (!file.open(QIODevice::ReadOnly))
+    throw QString("Could not open file: %1").arg(file.errorString());
+  QByteArray data = file.readAll();
+
+  pxtnService pxtn;
+  if (pxtn.init() != pxtnOK) throw QString("Could not initialize pxtone");
+  if (!pxtn.set_destination_quality(2, opts.sample_rate, opts.sample_format))
+    throw QString("Unsupported sample rate %1").arg(opts.sample_rate);
+  pxtnDescriptor d;
+  d.set_memory_r(data.constData(), data.size());
+  if (pxtnERR err = pxtn.read(&d); err != pxtnOK)
+    throw QString("Could not read project: %1").arg(pxtnError_get_string(err));
+  if (pxtn.Woice_ReadyTones() != pxtnOK)
+    throw QString("Could not get voices ready");
+
+  const pxtnMaster *m = pxtn.master;
+  double secs_per_meas = m->get_beat_num() / m->get_beat_tempo() * 60;
+  double full = m->get_play_meas() * secs_per_meas;
+  double loop = (m->get_play_meas() - m->get_repeat_meas()) * secs_per_meas;
+
+  RenderSettings settings;
+  settings.length = opts.length.value_or(full + (opts.loops - 1) * loop);
+  settings.fadeout = opts.fadeout;
+  settings.format = opts.format;
+  settings.stems = opts.stems;
+  settings.profile = profile;
+  renderToFile(&pxtn, job.output, settings);
+  return settings.length + std::max(settings.fadeout, 0.0);
+}
+
+// Load and a per-stage breakdown, to find what's expensive about a song.
+static QString describeProfile(const pxtnMooProfile &profile,
+                               int sample_rate) {
+  QString s = QString("  %1% of realtime (peak %2%), up to %3 voices:")
+                  .arg(100 * profile.load(sample_rate), 0, 'f', 1)
+                  .arg(100 * profile.peak_load, 0, 'f', 1)
+                  .arg(profile.peak_voices);
+  int64_t total = 0;
+  for (int64_t ns : profile.ns) total += ns;
+  for (int i = 0; i < pxtnMOOSTAGE_num; ++i)
+    s += QString(" %1 %2%")
+             .arg(QString(pxtnMooProfile::stage_name(pxtnMOOSTAGE(i))))
+             .arg(total ? 100.0 * profile.ns[i] / total : 0.0, 0, 'f', 0);
+  return s;
+}
+
+static bool isProject(const QString &path) {
+  QString suffix = QFileInfo(path).suffix().toLower();
+  return suffix == "ptcop" || suffix == "pttune";
+}
+
+int main(int argc, char *argv[]) {
+  QCoreApplication a(argc, argv);
+  a.setApplicationName("ptcollab-render");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+      "Render pxtone projects to audio files. Directories are searched for "
+      "projects, which are rendered in parallel.");
+  parser.addHelpOption();
+  parser.addPositionalArgument("inputs", "ptcop / pttune files or directories.",
+                               "<input>...");
+
+  QCommandLineOption outputOption(
+      QStringList() << "o"
+                    << "output",
+      "Write to this file (with a single input file) or directory. Defaults "
+      "to next to each input.",
+      "path");
+  parser.addOption(outputOption);
+  QCommandLineOption formatOption(
+      QStringList() << "f"
+                    << "format",
+      "File format, by suffix (e.g. wav, flac). Defaults to the output file's "
+      "suffix, or wav.",
+      "format");
+  parser.addOption(formatOption);
+  QCommandLineOption lengthOption(
+      QStringList() << "length",
+      "Render this many seconds, not counting the fade out. Defaults to the "
+      "song's length.",
+      "secs");
+  parser.addOption(lengthOption);
+  QCommandLineOption loopsOption(
+      QStringList() << "loops",
+      "Without --length, play the repeating part this many times.", "n", "1");
+  parser.addOption(loopsOption);
+  QCommandLineOption fadeoutOption(
+      QStringList() << "fadeout", "Fade out over this many seconds at the end.",
+      "secs", "0");
+  parser.addOption(fadeoutOption);
+  QCommandLineOption stemsOption(
+      QStringList() << "stems",
+      "Also write a file per 'unit' or per 'group' next to each output.",
+      "kind");
+  parser.addOption(stemsOption);
+  QCommandLineOption sampleRateOption(QStringList() << "sample-rate",
+                                      "Output sample rate.", "hz", "44100");
+  parser.addOption(sampleRateOption);
+  QCommandLineOption floatOption(
+      QStringList() << "float",
+      "Mix to unclipped 32-bit float rather than 16-bit. Formats without float "
+      "samples are still written as 16-bit.");
+  parser.addOption(floatOption);
+  QCommandLineOption profileOption(
+      QStringList() << "profile",
+      "Print how much time each file's render took per stage.");
+  parser.addOption(profileOption);
+  QCommandLineOption jobsOption(
+      QStringList() << "j"
+                    << "jobs",
+      "Render this many files at once. Defaults to the number of cores.", "n");
+  parser.addOption(jobsOption);
+
+  parser.process(a);
+
+  auto toNumber = [&](const QCommandLineOption &option) {
+    bool ok;
+    double v = parser.value(option).toDouble(&ok);
+    if (!ok || v < 0)
+      qFatal("Invalid value for --%s",
+             qPrintable(option.names().constLast()));
+    return v;
+  };
+
+  Options opts;
+  if (parser.isSet(lengthOption)) opts.length = toNumber(lengthOption);
+  opts.loops = std::max(1, int(toNumber(loopsOption)));
+  opts.fadeout = toNumber(fadeoutOption);
+  opts.sample_rate = int(toNumber(sampleRateOption));
+  opts.profile = parser.isSet(profileOption);
+  opts.sample_format = (parser.isSet(floatOption) ? pxtnSAMPLEFORMAT_f32
+                                                  : pxtnSAMPLEFORMAT_s16);
+  int num_jobs = QThread::idealThreadCount();
+  if (parser.isSet(jobsOption))
+    num_jobs = std::max(1, int(toNumber(jobsOption)));
+
+  opts.stems = pxtnSTEM_none;
+  if (parser.isSet(stemsOption)) {
+    QString stems = parser.value(stemsOption);
+    if (stems == "unit")
+      opts.stems = pxtnSTEM_unit;
+    else if (stems == "group")
+      opts.stems = pxtnSTEM_group;
+    else
+      qFatal("--stems should be 'unit' or 'group'");
+  }
+
+  std::vector<Input> inputs;
+  for (const QString &arg : parser.positionalArguments()) {
+    if (QFileInfo(arg).isDir()) {
+      QDirIterator it(arg, QDir::Files, QDirIterator::Subdirectories);
+      while (it.hasNext()) {
+        QString path = it.next();
+        if (isProject(path)) inputs.push_back({path, arg});
+      }
+    } else
+      inputs.push_back({arg, QString()});
+  }
+  if (inputs.empty()) parser.showHelp(1);
+
+  QString output = parser.value(outputOption);
+  bool output_is_file =
+      !output.isEmpty() && inputs.size() == 1 && !QFileInfo(output).isDir() &&
+      !QFileInfo(parser.positionalArguments().first()).isDir();
+
+  QString format_suffix = parser.value(formatOption);
+  if (format_suffix.isEmpty())
+    format_suffix = (output_is_file ? QFileInfo(output).suffix() : "wav");
+  const AudioFileFormatInfo *format = audioFileFormatOfSuffix(format_suffix);
+  if (!format) qFatal("Unsupported format: %s", qPrintable(format_suffix));
+  opts.format = format->format;
+
+  if (!output.isEmpty() && !output_is_file) QDir().mkpath(output);
+  std::vector<Job> jobs;
+  for (const Input &input : inputs) {
+    QFileInfo info(input.path);
+    QString name = info.completeBaseName() + "." + format->suffix;
+    if (output_is_file)
+      jobs.push_back({input.path, output});
+    else if (!output.isEmpty()) {
+      // Files from a directory keep their place under it, so that songs
+      // named the same in different subdirectories don't collide.
+      QDir out_dir(output);
+      if (!input.root.isEmpty()) {
+        QString sub = QDir(input.root).relativeFilePath(info.path());
+        if (!sub.isEmpty() && sub != ".") {
+          out_dir.mkpath(sub);
+          out_dir.setPath(out_dir.filePath(sub));
+        }
+      }
+      jobs.push_back({input.path, out_dir.filePath(name)});
+    } else
+      jobs.push_back({input.path, info.dir().filePath(name)});
+  }
+
+  // e.g. song.ptcop and song.pttune side by side. Rendering both at once
+  // would interleave their writes.
+  QHash<QString, QString> input_of_output;
+  for (const Job &job : jobs) {
+    QString key = QFileInfo(job.output).absoluteFilePath();
+    auto it = input_of_output.constFind(key);
+    if (it != input_of_output.constEnd())
+      qFatal("%s and %s would both render to %s", qPrintable(it.value()),
+             qPrintable(job.input), qPrintable(job.output));
+    input_of_output.insert(key, job.input);
+  }
+
+  // Each file gets its own pxtnService, so files render independently.
+  std::atomic<size_t> next_job(0);
+  std::atomic<int> num_failed(0);
+  auto work = [&]() {
+    for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+      const Job &job = jobs[i];
+      QElapsedTimer timer;
+      timer.start();
+      try {
+        pxtnMooProfile profile;
+        double secs = renderJob(job, opts, opts.profile ? &profile : nullptr);
+        double elapsed = timer.elapsed() / 1000.0;
+        QString s = QString("%1 -> %2: %3s in %4s (%5x realtime)")
+                        .arg(job.input, job.output)
+                        .arg(secs, 0, 'f', 1)
+                        .arg(elapsed, 0, 'f', 2)
+                        .arg(secs / std::max(elapsed, 0.001), 0, 'f', 1);
+        if (opts.profile)
+          s += "\n" + describeProfile(profile, opts.sample_rate);
+        report(s);
+      } catch (const QString &e) {
+        ++num_failed;
+        report(QString("%1: %2").arg(job.input, e), true);
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int i = 1; i < std::min<int>(num_jobs, jobs.size()); ++i)
+    threads.emplace_back(work);
+  work();
+  for (std::thread &t : threads) t.join();
+
+  if (num_failed > 0) {
+    report(QString("%1 of %2 renders failed").arg(num_failed).arg(jobs.size()),
+           true);
+    return 1;
+  }
+  return 0;
+}
@@ -20,7 +20,6 @@ CONFIG += c++17
 # depend on your compiler). Please consult the documentation of the
 # deprecated API in order to know how to port your code away from it.
 DEFINES += QT_DEPRECATED_WARNINGS
-DEFINES += pxINCLUDE_OGGVORBIS
 # You can make your code fail to compile if you use deprecated APIs.
 # In order to do so, uncomment the following line.
 # Please consult the documentation of the deprecated API in order to know
@@ -44,23 +43,26 @@ HEADERS += \
            editor/sidemenu/WoiceListModel.h \
            editor/views/Animation.h \
            editor/audio/AudioFormat.h \
+           editor/audio/AudioRing.h \
            editor/Clipboard.h \
            editor/ComboOptions.h \
            editor/DummySyncServer.h \
            editor/EditState.h \
            editor/EditorScrollArea.h \
            editor/EditorWindow.h \
+           editor/EngineProfileDock.h \
            editor/Interval.h \
            editor/views/KeyboardView.h \
            editor/audio/NotePreview.h \
            editor/views/MeasureView.h \
            editor/views/MooClock.h \
+           editor/audio/MooRenderThread.h \
            editor/views/ParamView.h \
+           editor/audio/PreviewMixer.h \
            editor/PxtoneClient.h \
            editor/PxtoneController.h \
            editor/audio/PxtoneIODevice.h \
            editor/sidemenu/PxtoneSideMenu.h \
-           editor/audio/PxtoneUnitIODevice.h \
            editor/sidemenu/SelectWoiceDialog.h \
            editor/sidemenu/SideMenu.h \
            editor/sidemenu/UnitListModel.h \
@@ -71,28 +73,14 @@ HEADERS += \
            protocol/PxtoneEditAction.h \
            protocol/RemoteAction.h \
            protocol/SerializeVariant.h \
-           pxtone/pxtn.h \
-           pxtone/pxtnDelay.h \
-           pxtone/pxtnDescriptor.h \
-           pxtone/pxtnError.h \
-           pxtone/pxtnEvelist.h \
-           pxtone/pxtnMaster.h \
-           pxtone/pxtnMax.h \
-           pxtone/pxtnMem.h \
-           pxtone/pxtnOverDrive.h \
-           pxtone/pxtnPulse_Frequency.h \
-           pxtone/pxtnPulse_Noise.h \
-           pxtone/pxtnPulse_NoiseBuilder.h \
-           pxtone/pxtnPulse_Oggv.h \
-           pxtone/pxtnPulse_Oscillator.h \
-           pxtone/pxtnPulse_PCM.h \
-           pxtone/pxtnService.h \
-           pxtone/pxtnText.h \
-           pxtone/pxtnUnit.h \
-           pxtone/pxtnWoice.h \
-           pxtone/pxtoneNoise.h \
+           protocol/WireCodec.h \
+           protocol/WoiceHistory.h \
+           network/BlobCache.h \
            network/BroadcastServer.h \
            network/Client.h \
+           network/Journal.h \
+           network/Recording.h \
+           network/Room.h \
            network/ServerSession.h
 FORMS += \
     editor/ConnectDialog.ui \
@@ -122,17 +110,19 @@ SOURCES += main.cpp \
            editor/EditState.cpp \
            editor/EditorScrollArea.cpp \
            editor/EditorWindow.cpp \
+           editor/EngineProfileDock.cpp \
            editor/Interval.cpp \
            editor/views/KeyboardView.cpp \
            editor/audio/NotePreview.cpp \
            editor/views/MeasureView.cpp \
            editor/views/MooClock.cpp \
+           editor/audio/MooRenderThread.cpp \
            editor/views/ParamView.cpp \
+           editor/audio/PreviewMixer.cpp \
            editor/PxtoneClient.cpp \
            editor/PxtoneController.cpp \
            editor/audio/PxtoneIODevice.cpp \
            editor/sidemenu/PxtoneSideMenu.cpp \
-           editor/audio/PxtoneUnitIODevice.cpp \
            editor/sidemenu/SelectWoiceDialog.cpp \
            editor/sidemenu/SideMenu.cpp \
            editor/sidemenu/UnitListModel.cpp \
@@ -142,34 +132,17 @@ SOURCES += main.cpp \
            protocol/NoIdMap.cpp \
            protocol/PxtoneEditAction.cpp \
            protocol/RemoteAction.cpp \
-           pxtone/pxtnDelay.cpp \
-           pxtone/pxtnDescriptor.cpp \
-           pxtone/pxtnError.cpp \
-           pxtone/pxtnEvelist.cpp \
-           pxtone/pxtnMaster.cpp \
-           pxtone/pxtnMem.cpp \
-           pxtone/pxtnOverDrive.cpp \
-           pxtone/pxtnPulse_Frequency.cpp \
-           pxtone/pxtnPulse_Noise.cpp \
-           pxtone/pxtnPulse_NoiseBuilder.cpp \
-           pxtone/pxtnPulse_Oggv.cpp \
-           pxtone/pxtnPulse_Oscillator.cpp \
-           pxtone/pxtnPulse_PCM.cpp \
-           pxtone/pxtnService.cpp \
-           pxtone/pxtnService_moo.cpp \
-           pxtone/pxtnText.cpp \
-           pxtone/pxtnUnit.cpp \
-           pxtone/pxtnWoice.cpp \
-           pxtone/pxtnWoice_io.cpp \
-           pxtone/pxtnWoicePTV.cpp \
-           pxtone/pxtoneNoise.cpp \
+           protocol/WireCodec.cpp \
+           protocol/WoiceHistory.cpp \
+           network/BlobCache.cpp \
            network/BroadcastServer.cpp \
            network/Client.cpp \
+           network/Journal.cpp \
+           network/Recording.cpp \
+           network/Room.cpp \
            network/ServerSession.cpp
 
-!win32:LIBS += -logg -lvorbisfile
-win32:LIBS += -L"$$PWD/../deps/lib" -L"$$PWD/deps/lib" -llibogg_static -llibvorbisfile
-macx:LIBS += -L/usr/local/lib
+include(engine.pri)
 
 # Rules for deployment.
 isEmpty(PREFIX) {
@@ -5,6 +5,7 @@
 #include <QGuiApplication>
 #include <QMimeData>
 #include <algorithm>
+#include <map>
 
 #include "ComboOptions.h"
 
@@ -17,7 +18,7 @@ struct CopyState {
   CopyState(){};
   CopyState(const std::set<int> &copy_unit_nos, const Interval &range,
             const pxtnService *pxtn, const std::set<EVENTKIND> &kinds_to_copy);
-  std::list<Action::Primitive> makePaste(
+  std::vector<Action::Primitive> makePaste(
       const std::set<int> &paste_unit_nos,
       const std::set<EVENTKIND> &kinds_to_paste, qint32 start_clock,
       const NoIdMap &map);
@@ -122,12 +123,12 @@ void Clipboard::copy(const std::set<int> &unit_nos, const Interval &range,
   QGuiApplication::clipboard()->setMimeData(mime);
 }
 
-std::list<Action::Primitive> CopyState::makePaste(
+std::vector<Action::Primitive> CopyState::makePaste(
     const std::set<int> &paste_unit_nos,
     const std::set<EVENTKIND> &kinds_to_paste, qint32 start_clock,
     const NoIdMap &map) {
   using namespace Action;
-  std::list<Primitive> actions;
+  std::vector<Primitive> actions;
   auto min = std::min_element(paste_unit_nos.begin(), paste_unit_nos.end());
   if (min == paste_unit_nos.end()) return actions;
   uint8_t first_unit_no = *min;
@@ -144,16 +145,28 @@ std::list<Action::Primitive> CopyState::makePaste(
     }
   }
 
+  // Each unit and kind's events go in one batch.
+  std::map<std::pair<qint32, EVENTKIND>, AddBatch> batches;
   for (const Item &item : m_items) {
     uint8_t unit_no = item.unit_no + first_unit_no;
     if (paste_unit_nos.find(unit_no) != paste_unit_nos.end() &&
         kinds_to_paste.find(item.kind) != kinds_to_paste.end()) {
       if (map.numUnits() <= unit_no) continue;
       qint32 unit_id = map.noToId(unit_no);
-      actions.emplace_back(Primitive{
-          item.kind, unit_id, start_clock + item.clock, Add{item.value}});
+      batches[{unit_id, item.kind}].events.emplace_back(item.clock,
+                                                        item.value);
     }
   }
+  for (auto &[key, batch] : batches) {
+    // Only a clipboard from somewhere else could be out of order.
+    auto byClock = [](const auto &a, const auto &b) {
+      return a.first < b.first;
+    };
+    if (!std::is_sorted(batch.events.begin(), batch.events.end(), byClock))
+      std::stable_sort(batch.events.begin(), batch.events.end(), byClock);
+    actions.emplace_back(
+        Primitive{key.second, key.first, start_clock, std::move(batch)});
+  }
   return actions;
 }
 
@@ -162,7 +175,7 @@ PasteResult Clipboard::makePaste(const std::set<int> &paste_unit_nos,
   using namespace Action;
 
   const QMimeData *mime = QGuiApplication::clipboard()->mimeData();
-  if (!mime->hasFormat(CLIPBOARD_MIME)) return {std::list<Primitive>{}, 0};
+  if (!mime->hasFormat(CLIPBOARD_MIME)) return {std::vector<Primitive>{}, 0};
   QDataStream s(mime->data(CLIPBOARD_MIME));
   CopyState c;
   s >> c;
@@ -172,11 +185,10 @@ PasteResult Clipboard::makePaste(const std::set<int> &paste_unit_nos,
 }
 
 // TODO: Maybe shouldn't be here? Doesn't actually use clipboard state ATM
-std::list<Action::Primitive> Clipboard::makeClear(const std::set<int> &unit_nos,
-                                                  const Interval &range,
-                                                  const NoIdMap &map) {
+std::vector<Action::Primitive> Clipboard::makeClear(
+    const std::set<int> &unit_nos, const Interval &range, const NoIdMap &map) {
   using namespace Action;
-  std::list<Primitive> actions;
+  std::vector<Primitive> actions;
   // TODO: Dedup with makePaste
   for (const int &unit_no : unit_nos) {
     if (map.numUnits() <= size_t(unit_no)) continue;
@@ -16,7 +16,7 @@ struct Item {
 };
 
 struct PasteResult {
-  std::list<Action::Primitive> actions;
+  std::vector<Action::Primitive> actions;
   qint32 length;
 };
 
@@ -32,9 +32,9 @@ class Clipboard : public QObject {
             const pxtnService *pxtn);
   PasteResult makePaste(const std::set<int> &unit_nos, qint32 start_clock,
                         const NoIdMap &map);
-  std::list<Action::Primitive> makeClear(const std::set<int> &unit_nos,
-                                         const Interval &range,
-                                         const NoIdMap &map);
+  std::vector<Action::Primitive> makeClear(const std::set<int> &unit_nos,
+                                           const Interval &range,
+                                           const NoIdMap &map);
   void setKindIsCopied(EVENTKIND kind, bool set);
   bool kindIsCopied(EVENTKIND kind);
  signals:
@@ -10,7 +10,7 @@ DummySyncServer::DummySyncServer(PxtoneController *sync,
       m_mirror_lag_s(mirror_lag_s) {}
 
 void DummySyncServer::receiveAction(
-    const std::list<Action::Primitive> &action) {
+    const std::vector<Action::Primitive> &action) {
   EditAction remote_action = m_sync->applyLocalAction(action);
   m_pending_commit.emplace_back(remote_action);
   m_pending_mirror.emplace_back(remote_action);
@@ -14,7 +14,7 @@ class DummySyncServer {
   DummySyncServer(PxtoneController *sync, float commit_lag_s,
                   float mirror_lag_s);
 
-  void receiveAction(const std::list<Action::Primitive> &action);
+  void receiveAction(const std::vector<Action::Primitive> &action);
   void receiveUndo();
   void receiveRedo();
 
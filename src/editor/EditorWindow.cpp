@@ -11,6 +11,7 @@
 #include <QScrollBar>
 #include <QSettings>
 #include <QSplitter>
+#include <QTime>
 #include <QVBoxLayout>
 #include <QtMultimedia/QAudioDeviceInfo>
 #include <QtMultimedia/QAudioFormat>
@@ -40,6 +41,7 @@ EditorWindow::EditorWindow(QWidget *parent)
       m_connect_dialog(new ConnectDialog(this)),
       m_shortcuts_dialog(new ShortcutsDialog(this)),
       m_render_dialog(new RenderDialog(this)),
+      m_render_job(nullptr),
       ui(new Ui::EditorWindow) {
   m_pxtn.init_collage(EVENT_MAX);
   int channel_num = 2;
@@ -61,6 +63,11 @@ EditorWindow::EditorWindow(QWidget *parent)
   statusBar()->addPermanentWidget(m_ping_status);
   statusBar()->addPermanentWidget(m_connection_status);
 
+  m_profile_dock = new EngineProfileDock(m_client, this);
+  addDockWidget(Qt::RightDockWidgetArea, m_profile_dock);
+  m_profile_dock->hide();
+  ui->menuView->addAction(m_profile_dock->toggleViewAction());
+
   m_side_menu = new PxtoneSideMenu(m_client, this);
   m_measure_splitter = new QFrame(m_splitter);
   QVBoxLayout *measure_layout = new QVBoxLayout(m_measure_splitter);
@@ -170,6 +177,10 @@ EditorWindow::EditorWindow(QWidget *parent)
           [this]() { Host(HostSetting::LoadFile); });
   connect(ui->actionSaveAs, &QAction::triggered, this, &EditorWindow::saveAs);
   connect(ui->actionRender, &QAction::triggered, this, &EditorWindow::render);
+  connect(ui->actionSeekRecording, &QAction::triggered, this,
+          &EditorWindow::seekRecording);
+  connect(ui->actionPlaybackSpeed, &QAction::triggered, this,
+          &EditorWindow::setPlaybackSpeed);
   connect(ui->actionConnect, &QAction::triggered, this,
           &EditorWindow::connectToHost);
   /*connect(ui->actionClearSettings, &QAction::triggered, [this]() {
@@ -207,7 +218,15 @@ EditorWindow::EditorWindow(QWidget *parent)
   });
 }
 
-EditorWindow::~EditorWindow() { delete ui; }
+EditorWindow::~EditorWindow() {
+  if (m_render_job) {
+    m_render_job->cancel();
+    m_render_job->wait();
+  }
+  // Stops playback while the song it's playing is still around.
+  delete m_client;
+  delete ui;
+}
 
 void EditorWindow::keyPressEvent(QKeyEvent *event) {
   int key = event->key();
@@ -446,9 +465,11 @@ void EditorWindow::Host(HostSetting host_setting) {
 void EditorWindow::hostDirectly(std::optional<QString> filename,
                                 QHostAddress host, int port,
                                 std::optional<QString> recording_save_file,
-                                QString username) {
+                                QString username,
+                                std::optional<QString> journal_dir) {
   try {
     m_server = new BroadcastServer(filename, host, port, recording_save_file,
+                                   journal_dir, UndoHorizon::get(),
                                    this);  // , 3000, 0.3);
   } catch (QString e) {
     QMessageBox::critical(this, "Server startup error", e);
@@ -461,10 +482,53 @@ void EditorWindow::hostDirectly(std::optional<QString> filename,
   m_filename = (m_server->isReadingHistory() ? std::nullopt : filename);
   m_modified = false;
   m_side_menu->setModified(false);
+  ui->actionSeekRecording->setEnabled(m_server->isReadingHistory());
+  ui->actionPlaybackSpeed->setEnabled(m_server->isReadingHistory());
 
+  m_host_username = username;
   m_client->connectToServer("localhost", m_server->port(), username);
 }
 
+static QString formatMsec(qint64 msec) {
+  return QTime(0, 0).addMSecs(msec).toString("h:mm:ss");
+}
+
+void EditorWindow::seekRecording() {
+  if (!m_server || !m_server->isReadingHistory()) return;
+  qint64 duration = m_server->playbackDuration();
+  QString label = (duration < 0 ? tr("Seek to (h:mm:ss)")
+                                : tr("Seek to (h:mm:ss, recording is %1)")
+                                      .arg(formatMsec(duration)));
+  bool ok;
+  QString text = QInputDialog::getText(
+      this, tr("Seek recording"), label, QLineEdit::Normal,
+      formatMsec(m_server->playbackPosition()), &ok);
+  if (!ok) return;
+  QTime time = QTime::fromString(text.trimmed(), "h:mm:ss");
+  if (!time.isValid()) {
+    QMessageBox::warning(this, tr("Invalid time"),
+                         tr("Time must look like h:mm:ss."));
+    return;
+  }
+
+  // Seeking back drops everyone connected to the server, us included.
+  qint64 position = QTime(0, 0).msecsTo(time);
+  bool rejoin = position < m_server->playbackPosition();
+  if (rejoin) m_client->disconnectFromServerSuppressSignal();
+  m_server->seekPlayback(position);
+  if (rejoin)
+    m_client->connectToServer("localhost", m_server->port(), m_host_username);
+}
+
+void EditorWindow::setPlaybackSpeed() {
+  if (!m_server || !m_server->isReadingHistory()) return;
+  bool ok;
+  double speed = QInputDialog::getDouble(
+      this, tr("Recording playback speed"), tr("Speed"),
+      m_server->playbackSpeed(), 0.1, 100, 2, &ok);
+  if (ok) m_server->setPlaybackSpeed(speed);
+}
+
 bool EditorWindow::saveToFile(QString filename) {
 #ifdef _WIN32
   FILE *f_raw;
@@ -506,7 +570,13 @@ bool EditorWindow::saveAs() {
 }
 
 bool EditorWindow::render() {
-  double length, fadeout;
+  if (m_render_job) {
+    QMessageBox::information(this, tr("Render in progress"),
+                             tr("Wait for the current render to finish or "
+                                "abort it before starting another."));
+    return false;
+  }
+
   double secs_per_meas =
       m_pxtn.master->get_beat_num() / m_pxtn.master->get_beat_tempo() * 60;
   const pxtnMaster *m = m_pxtn.master;
@@ -514,34 +584,51 @@ bool EditorWindow::render() {
   m_render_dialog->setSongLoopLength(
       (m->get_play_meas() - m->get_repeat_meas()) * secs_per_meas);
 
+  RenderSettings settings;
+  QString destination;
   try {
     if (!m_render_dialog->exec()) return false;
-    length = m_render_dialog->renderLength();
-    fadeout = m_render_dialog->renderFadeout();
+    settings.length = m_render_dialog->renderLength();
+    settings.fadeout = m_render_dialog->renderFadeout();
+    settings.format = m_render_dialog->renderFormat();
+    settings.stems = m_render_dialog->renderStems();
+    destination = m_render_dialog->renderDestination();
   } catch (QString &e) {
     QMessageBox::warning(this, tr("Render settings invalid"), e);
     return false;
   }
 
-  QSaveFile file(m_render_dialog->renderDestination());
-  if (!file.open(QIODevice::WriteOnly)) {
+  // The render runs off a snapshot so that editing can carry on meanwhile.
+  std::shared_ptr<const pxtnService> snapshot = m_client->snapshot();
+  if (!snapshot) {
     QMessageBox::warning(this, tr("Could not render"),
-                         tr("Could not open file for rendering"));
+                         tr("Could not copy the project for rendering"));
     return false;
   }
 
   constexpr int GRANULARITY = 1000;
-  QProgressDialog progress(tr("Rendering"), tr("Abort"), 0, GRANULARITY, this);
-  progress.setWindowModality(Qt::WindowModal);
-  bool result =
-      m_client->controller()->render(&file, length, fadeout, [&](double p) {
-        progress.setValue(p * GRANULARITY);
-        return !progress.wasCanceled();
-      });
-  progress.close();
-  if (!result) return false;
-  file.commit();
-  QMessageBox::information(this, tr("Rendering done"), tr("Rendering done"));
+  RenderJob *job = new RenderJob(snapshot, destination, settings, this);
+  QProgressDialog *progress =
+      new QProgressDialog(tr("Rendering"), tr("Abort"), 0, GRANULARITY, this);
+  progress->setWindowModality(Qt::NonModal);
+  progress->setMinimumDuration(0);
+  connect(job, &RenderJob::progressed, progress,
+          [progress](double p) { progress->setValue(p * GRANULARITY); });
+  connect(progress, &QProgressDialog::canceled, job,
+          [job]() { job->cancel(); });
+  connect(job, &QThread::finished, this, [this, job, progress]() {
+    progress->close();
+    progress->deleteLater();
+    if (job->succeeded())
+      QMessageBox::information(this, tr("Rendering done"),
+                               tr("Rendering done"));
+    else if (!job->error().isEmpty())
+      QMessageBox::warning(this, tr("Could not render"), job->error());
+    m_render_job = nullptr;
+    job->deleteLater();
+  });
+  m_render_job = job;
+  job->start(QThread::LowPriority);
   return true;
 }
 
@@ -561,10 +648,14 @@ void EditorWindow::connectToHost() {
 
   if (!m_connect_dialog->exec()) return;
   m_connect_dialog->persistSettings();
-  QStringList parsed_host_and_port = m_connect_dialog->address().split(":");
+  // An optional /ROOM picks one of the projects on a multi-room server.
+  QString address = m_connect_dialog->address();
+  QString room = address.section("/", 1);
+  QStringList parsed_host_and_port = address.section("/", 0, 0).split(":");
   if (parsed_host_and_port.length() != 2) {
     QMessageBox::warning(this, tr("Invalid address"),
-                         tr("Address must be of the form HOST:PORT."));
+                         tr("Address must be of the form HOST:PORT or "
+                            "HOST:PORT/ROOM."));
     return;
   }
   QString host = parsed_host_and_port[0];
@@ -587,7 +678,9 @@ void EditorWindow::connectToHost() {
     delete m_server;
     m_server = nullptr;
   }
-  m_client->connectToServer(host, port, m_connect_dialog->username());
+  ui->actionSeekRecording->setEnabled(false);
+  ui->actionPlaybackSpeed->setEnabled(false);
+  m_client->connectToServer(host, port, m_connect_dialog->username(), room);
 }
 
 void EditorWindow::dragEnterEvent(QDragEnterEvent *event) {
@@ -11,6 +11,7 @@
 #include "ConnectionStatusLabel.h"
 #include "EditState.h"
 #include "EditorScrollArea.h"
+#include "EngineProfileDock.h"
 #include "HostDialog.h"
 #include "RenderDialog.h"
 #include "ShortcutsDialog.h"
@@ -18,6 +19,7 @@
 #include "network/BroadcastServer.h"
 #include "network/Client.h"
 #include "pxtone/pxtnService.h"
+#include "render/RenderJob.h"
 #include "sidemenu/DelayEffectModel.h"
 #include "sidemenu/PxtoneSideMenu.h"
 #include "sidemenu/UnitListModel.h"
@@ -40,7 +42,8 @@ class EditorWindow : public QMainWindow {
 
   void hostDirectly(std::optional<QString> filename, QHostAddress host,
                     int port, std::optional<QString> recording_save_file,
-                    QString username);
+                    QString username,
+                    std::optional<QString> journal_dir = std::nullopt);
  private slots:
   void connectToHost();
 
@@ -60,6 +63,7 @@ class EditorWindow : public QMainWindow {
   PxtoneClient* m_client;
   MooClock* m_moo_clock;
   std::optional<QString> m_filename;
+  QString m_host_username;
   ConnectionStatusLabel* m_connection_status;
   QLabel *m_fps_status, *m_ping_status;
   bool m_modified;
@@ -67,12 +71,16 @@ class EditorWindow : public QMainWindow {
   ConnectDialog* m_connect_dialog;
   ShortcutsDialog* m_shortcuts_dialog;
   RenderDialog* m_render_dialog;
+  EngineProfileDock* m_profile_dock;
+  RenderJob* m_render_job;
 
   Ui::EditorWindow* ui;
   bool saveToFile(QString filename);
   bool save();
   bool saveAs();
   bool render();
+  void seekRecording();
+  void setPlaybackSpeed();
   bool maybeSave();
   void dragEnterEvent(QDragEnterEvent* event) override;
   void dropEvent(QDropEvent* event) override;
@@ -0,0 +1,94 @@
+#include "EngineProfileDock.h"
+
+#include <QFontDatabase>
+#include <algorithm>
+
+#include "audio/AudioFormat.h"
+
+constexpr int REFRESH_MSEC = 500;
+
+EngineProfileDock::EngineProfileDock(PxtoneClient *client, QWidget *parent)
+    : QDockWidget(tr("Engine profile"), parent),
+      m_client(client),
+      m_label(new QLabel(this)),
+      m_timer(new QTimer(this)),
+      m_total_underruns(0),
+      m_peak_load(0) {
+  setObjectName("EngineProfileDock");
+  m_label->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+  m_label->setAlignment(Qt::AlignTop | Qt::AlignLeft);
+  m_label->setTextInteractionFlags(Qt::TextSelectableByMouse);
+  m_label->setMargin(4);
+  setWidget(m_label);
+
+  connect(m_timer, &QTimer::timeout, this, &EngineProfileDock::refresh);
+  connect(this, &QDockWidget::visibilityChanged, [this](bool visible) {
+    if (!visible) {
+      m_timer->stop();
+      return;
+    }
+    // Drop what piled up while hidden, so the first numbers are current.
+    m_client->takePlaybackProfile();
+    m_total_underruns = 0;
+    m_peak_load = 0;
+    m_timer->start(REFRESH_MSEC);
+  });
+}
+
+void EngineProfileDock::refresh() {
+  std::optional<PlaybackProfile> profile = m_client->takePlaybackProfile();
+  if (!profile.has_value()) {
+    m_label->setText(tr("No audio output"));
+    return;
+  }
+  const pxtnMooProfile &moo = profile->moo;
+  int32_t sample_rate = 44100;
+  m_client->pxtn()->get_destination_quality(nullptr, &sample_rate);
+  m_total_underruns += profile->underruns;
+  m_peak_load = std::max(m_peak_load, moo.peak_load);
+
+  QStringList lines;
+  lines << tr("Load %1% of real time")
+               .arg(100 * moo.load(sample_rate), 0, 'f', 1);
+  lines << tr("Worst chunk %1% (%2% since shown)")
+               .arg(100 * moo.peak_load, 0, 'f', 1)
+               .arg(100 * m_peak_load, 0, 'f', 1);
+  lines << tr("Missed deadlines %1 (%2 since shown)")
+               .arg(profile->underruns)
+               .arg(m_total_underruns);
+  lines << tr("Rendering %1 ms ahead, %2 ms latency")
+               .arg(pxtoneAudioFormat().durationForBytes(profile->fill_target) /
+                    1000)
+               .arg(int(m_client->outputLatency() * 1000));
+  lines << "";
+
+  int64_t total = 0;
+  for (int64_t ns : moo.ns) total += ns;
+  for (int i = 0; i < pxtnMOOSTAGE_num; ++i) {
+    QString stage = pxtnMooProfile::stage_name(pxtnMOOSTAGE(i));
+    lines << QString("%1 %2%")
+                 .arg(stage, -16)
+                 .arg(total ? 100.0 * moo.ns[i] / total : 0.0, 5, 'f', 1);
+  }
+  lines << "";
+
+  // Busiest units first.
+  std::vector<int> units;
+  int voices = 0;
+  for (size_t u = 0; u < moo.unit_voices.size(); ++u) {
+    voices += moo.unit_voices[u];
+    if (moo.unit_voices[u] > 0) units.push_back(u);
+  }
+  std::stable_sort(units.begin(), units.end(), [&](int a, int b) {
+    return moo.unit_voices[a] > moo.unit_voices[b];
+  });
+  lines << tr("Voices %1").arg(voices);
+  const pxtnService *pxtn = m_client->pxtn();
+  for (int u : units) {
+    if (u >= pxtn->Unit_Num()) continue;
+    const char *name_jis = pxtn->Unit_Get(u)->get_name_buf_jis(nullptr);
+    QString name = shift_jis_codec->toUnicode(name_jis);
+    lines << QString("  %1 %2").arg(name, -14).arg(moo.unit_voices[u], 3);
+  }
+  m_label->setText(lines.join("\n"));
+}
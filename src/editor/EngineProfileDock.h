@@ -0,0 +1,27 @@
+#ifndef ENGINEPROFILEDOCK_H
+#define ENGINEPROFILEDOCK_H
+
+#include <QDockWidget>
+#include <QLabel>
+#include <QTimer>
+
+#include "PxtoneClient.h"
+
+// Shows where playback's time is going, refreshed while it's visible: how
+// much of real time the moo takes, missed deadlines, time per stage and the
+// voices sounding in each unit.
+class EngineProfileDock : public QDockWidget {
+  Q_OBJECT
+  PxtoneClient *m_client;
+  QLabel *m_label;
+  QTimer *m_timer;
+  int m_total_underruns;
+  double m_peak_load;
+
+  void refresh();
+
+ public:
+  EngineProfileDock(PxtoneClient *client, QWidget *parent = nullptr);
+};
+
+#endif  // ENGINEPROFILEDOCK_H
@@ -26,6 +26,8 @@ PxtoneClient::PxtoneClient(pxtnService *pxtn,
       m_controller(new PxtoneController(0, pxtn, &m_moo_state, this)),
       m_client(new Client(this)),
       m_following_user(std::nullopt),
+      m_audio(nullptr),
+      m_pxtn_device(nullptr),
       m_ping_timer(new QTimer(this)),
       m_last_seek(0),
       m_clipboard(new Clipboard(this)) {
@@ -35,7 +37,8 @@ PxtoneClient::PxtoneClient(pxtnService *pxtn,
         << "Raw audio format not supported by backend, cannot play audio.";
     return;
   }
-  m_pxtn_device = new PxtoneIODevice(this, m_controller->pxtn(), &m_moo_state);
+  m_pxtn_device = new PxtoneIODevice(this, m_controller->pxtn(), &m_moo_state,
+                                     m_controller->engineMutex());
   m_audio = new QAudioOutput(pxtoneAudioFormat(), this);
 
   // Apparently this reduces latency in pulseaudio, but also makes
@@ -44,6 +47,8 @@ PxtoneClient::PxtoneClient(pxtnService *pxtn,
   m_audio->setVolume(1.0);
   connect(m_pxtn_device, &PxtoneIODevice::playingChanged, this,
           &PxtoneClient::playStateChanged);
+  connect(m_controller, &PxtoneController::seeked, m_pxtn_device,
+          &PxtoneIODevice::flush);
 
   connect(m_ping_timer, &QTimer::timeout, [this]() {
     sendPlayState(false);
@@ -60,6 +65,7 @@ PxtoneClient::PxtoneClient(pxtnService *pxtn,
         loadDescriptor(desc);
         emit connected();
         m_controller->setUid(uid);
+        m_controller->setUndoHorizon(m_client->undoHorizon());
         for (ServerAction &a : history) processRemoteAction(a);
         sendAction(Ping{QDateTime::currentMSecsSinceEpoch(), m_last_ping});
         m_ping_timer->start(PING_INTERVAL);
@@ -84,6 +90,13 @@ PxtoneClient::PxtoneClient(pxtnService *pxtn,
           &PxtoneClient::processRemoteAction);
 }
 
+// The render thread has to stop before the moo state it's rendering with goes
+// away.
+PxtoneClient::~PxtoneClient() {
+  if (m_audio) m_audio->stop();
+  delete m_pxtn_device;
+}
+
 void PxtoneClient::loadDescriptor(pxtnDescriptor &desc) {
   // An empty desc is interpreted as an empty file so we don't error.
   m_controller->loadDescriptor(desc);
@@ -124,6 +137,7 @@ void PxtoneClient::setBufferSize(double secs) {
   if (secs > 10) secs = 10;
   qDebug() << "Setting buffer size: " << secs;
   m_audio->setBufferSize(fmt.bytesForDuration(secs * 1e6));
+  m_pxtn_device->setBufferSize(m_audio->bufferSize());
 
   if (started) m_audio->start(m_pxtn_device);
 }
@@ -138,14 +152,39 @@ void PxtoneClient::togglePlayState() {
   sendPlayState(true);
 }
 
+double PxtoneClient::outputLatency() const {
+  if (!m_audio) return 0;
+  qint64 bytes = m_audio->bufferSize() - m_audio->bytesFree() +
+                 m_pxtn_device->bytesBuffered();
+  return pxtoneAudioFormat().durationForBytes(qMax(qint32(bytes), 0)) / 1e6;
+}
+
+double PxtoneClient::seekLatency() const {
+  if (!m_audio) return 0;
+  qint64 bytes = m_audio->bufferSize() - m_audio->bytesFree() +
+                 m_pxtn_device->fillTarget();
+  return pxtoneAudioFormat().durationForBytes(qMax(qint32(bytes), 0)) / 1e6;
+}
+
+qint32 PxtoneClient::clocksOf(double secs) {
+  const pxtnMaster *master = pxtn()->master;
+  return secs * master->get_beat_tempo() * master->get_beat_clock() / 60;
+}
+
+// Heartbeats say what's being heard rather than what's being rendered, so
+// that followers can line up with it whatever their own latency. Actions
+// (seeks, starting) are heard after about the same delay everywhere, so they
+// say where the moo is.
 void PxtoneClient::sendPlayState(bool from_action) {
-  sendAction(PlayState{pxtn()->moo_get_now_clock(*moo()),
-                       m_pxtn_device->playing(), from_action});
+  qint32 clock = mooPosition().clock;
+  if (!from_action && m_pxtn_device->playing())
+    clock = std::max(0, clock - clocksOf(outputLatency()));
+  sendAction(PlayState{clock, m_pxtn_device->playing(), from_action});
 }
 
 void PxtoneClient::resetAndSuspendAudio() {
   m_pxtn_device->setPlaying(false);
-  if (pxtn()->moo_get_now_clock(*moo()) > m_last_seek)
+  if (mooPosition().clock > m_last_seek)
     seekMoo(m_last_seek);
   else
     seekMoo(0);
@@ -195,7 +234,7 @@ qint32 PxtoneClient::quantizePitch() {
 
 qint32 PxtoneClient::lastSeek() const { return m_last_seek; }
 
-void PxtoneClient::applyAction(const std::list<Action::Primitive> &as) {
+void PxtoneClient::applyAction(const std::vector<Action::Primitive> &as) {
   m_client->sendAction(m_controller->applyLocalAction(as));
 }
 
@@ -215,8 +254,8 @@ void PxtoneClient::seekMoo(int64_t clock) {
 }
 
 void PxtoneClient::connectToServer(QString hostname, quint16 port,
-                                   QString username) {
-  m_client->connectToServer(hostname, port, username);
+                                   QString username, QString room) {
+  m_client->connectToServer(hostname, port, username, room);
 }
 
 void PxtoneClient::disconnectFromServerSuppressSignal() {
@@ -280,9 +319,16 @@ void PxtoneClient::processRemoteAction(const ServerAction &a) {
                         // Since playstates come with heartbeats, we only reset
                         // the moo for non-heartbeat updates or if there's a
                         // drastic diff.
-                        if (m_pxtn_device->playing() != s.playing ||
-                            s.from_action)
+                        // Catching up to a heartbeat means being ahead by
+                        // what we'll buffer before it's heard.
+                        if (s.from_action)
                           m_controller->seekMoo(s.clock);
+                        else if (m_pxtn_device->playing() != s.playing) {
+                          qint32 clock = s.clock + clocksOf(seekLatency());
+                          if (clock >= pxtn()->moo_get_end_clock())
+                            clock = s.clock;
+                          m_controller->seekMoo(clock);
+                        }
                         m_pxtn_device->setPlaying(s.playing);
                       }
                     },
@@ -391,7 +437,8 @@ void PxtoneClient::processRemoteAction(const ServerAction &a) {
                             }
                           },
                           true);
-                    }},
+                    },
+                    [](const FetchBlobs &) {}},
                 s);
           },
           [this, uid](const NewSession &s) {
@@ -422,6 +469,8 @@ void PxtoneClient::processRemoteAction(const ServerAction &a) {
             if (following_uid() == uid) setFollowing(std::nullopt);
             emit endRemoveUser();
           },
+          // Handled by the network client.
+          [](const BlobData &) {},
       },
       a.action);
 }
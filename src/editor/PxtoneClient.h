@@ -59,11 +59,13 @@ class PxtoneClient : public QObject {
   PxtoneClient(pxtnService *pxtn, ConnectionStatusLabel *connection_status,
 
                QObject *parent = nullptr);
-  void applyAction(const std::list<Action::Primitive> &);
+  ~PxtoneClient();
+  void applyAction(const std::vector<Action::Primitive> &);
   void sendAction(const ClientAction &);
   void removeCurrentUnit();
   void seekMoo(int64_t clock);
-  void connectToServer(QString hostname, quint16 port, QString username);
+  void connectToServer(QString hostname, quint16 port, QString username,
+                       QString room = "");
   void disconnectFromServerSuppressSignal();
   void changeEditState(std::function<void(EditState &)>, bool preserveFollow);
   void togglePlayState();
@@ -71,9 +73,27 @@ class PxtoneClient : public QObject {
   void setFollowing(std::optional<qint64> following);
   bool isFollowing();
   const pxtnService *pxtn() { return m_controller->pxtn(); }
+  std::shared_ptr<const pxtnService> snapshot() {
+    return m_controller->snapshot();
+  }
   const EditState &editState() const { return m_edit_state; }
   const mooState *moo() { return m_controller->moo(); }
+  PxtoneController::MooPosition mooPosition() {
+    return m_controller->mooPosition();
+  }
   const QAudioOutput *audioState() { return m_audio; }
+  const PxtoneIODevice *audioDevice() { return m_pxtn_device; }
+  // Seconds between the moo rendering something and it being heard: what's
+  // queued in the output plus what's rendered ahead of it.
+  double outputLatency() const;
+  // Null if there's no audio.
+  std::shared_ptr<PreviewMixer> previewMixer() {
+    return m_pxtn_device ? m_pxtn_device->previewMixer() : nullptr;
+  }
+  std::optional<PlaybackProfile> takePlaybackProfile() {
+    if (!m_pxtn_device) return std::nullopt;
+    return m_pxtn_device->takeProfile();
+  }
 
   const NoIdMap &unitIdMap() { return m_controller->unitIdMap(); }
   const std::map<qint64, RemoteEditState> &remoteEditStates() {
@@ -106,6 +126,9 @@ class PxtoneClient : public QObject {
   void processRemoteAction(const ServerAction &a);
   void loadDescriptor(pxtnDescriptor &desc);
   void sendPlayState(bool from_action);
+  // Like outputLatency(), but once the ring's refilled after a seek.
+  double seekLatency() const;
+  qint32 clocksOf(double secs);
 };
 
 #endif  // PXTONECLIENT_H
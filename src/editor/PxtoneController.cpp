@@ -1,9 +1,10 @@
 #include "PxtoneController.h"
 
 #include <QDebug>
-#include <QDialog>
 #include <QTextCodec>
 
+#include "protocol/Hello.h"
+
 const QTextCodec *shift_jis_codec = QTextCodec::codecForName("Shift-JIS");
 
 PxtoneController::PxtoneController(int uid, pxtnService *pxtn,
@@ -12,29 +13,122 @@ PxtoneController::PxtoneController(int uid, pxtnService *pxtn,
       m_uid(uid),
       m_pxtn(pxtn),
       m_moo_state(moo_state),
+      m_version(0),
+      m_snapshot_version(-1),
       m_unit_id_map(pxtn->Unit_Num()),
       m_woice_id_map(pxtn->Woice_Num()),
+      m_undo_horizon(DEFAULT_UNDO_HORIZON),
       m_remote_index(0) {}
 
+std::unique_lock<std::recursive_mutex> PxtoneController::lockForEdit() {
+  std::unique_lock<std::recursive_mutex> lock(m_engine_mutex);
+  ++m_version;
+  return lock;
+}
+
+std::shared_ptr<const pxtnService> PxtoneController::snapshot() {
+  std::lock_guard<std::recursive_mutex> lock(m_engine_mutex);
+  if (!m_snapshots.empty() && m_snapshot_version == m_version)
+    if (auto snapshot = m_snapshots.back().lock()) return snapshot;
+
+  auto snapshot = std::make_shared<pxtnService>();
+  if (snapshot->init_snapshot(*m_pxtn) != pxtnOK) {
+    qWarning() << "Could not take a snapshot of the song";
+    return nullptr;
+  }
+  snapshotsAlive();
+  m_snapshots.push_back(snapshot);
+  m_snapshot_version = m_version;
+  return snapshot;
+}
+
+bool PxtoneController::snapshotsAlive() {
+  m_snapshots.remove_if(
+      [](const std::weak_ptr<const pxtnService> &s) { return s.expired(); });
+  return !m_snapshots.empty();
+}
+
+std::shared_ptr<pxtnWoice> PxtoneController::woiceForEdit(int32_t idx) {
+  std::shared_ptr<pxtnWoice> woice = m_pxtn->Woice_Get_variable(idx);
+  if (woice == nullptr || !snapshotsAlive()) return woice;
+  std::shared_ptr<pxtnWoice> copy = std::make_shared<pxtnWoice>();
+  if (!woice->Copy(copy.get()) || m_pxtn->Woice_ReadyTone(copy) != pxtnOK)
+    return nullptr;
+  replaceWoice(idx, copy);
+  return copy;
+}
+
+void PxtoneController::replaceWoice(int32_t idx,
+                                    std::shared_ptr<pxtnWoice> woice) {
+  std::shared_ptr<const pxtnWoice> old = m_pxtn->Woice_Get(idx);
+  m_pxtn->Woice_Set(idx, woice);
+  for (pxtnUnitTone &u : m_moo_state->units)
+    if (u.get_woice() == old) u.set_woice(woice, false);
+}
+
+static void addUnitIds(const std::vector<Action::Primitive> &action,
+                       std::set<qint32> &unit_ids) {
+  for (const Action::Primitive &p : action) unit_ids.insert(p.unit_id);
+}
+
 EditAction PxtoneController::applyLocalAction(
-    const std::list<Action::Primitive> &action) {
+    const std::vector<Action::Primitive> &action) {
+  auto lock = lockForEdit();
   bool widthChanged = false;
   m_uncommitted.push_back(Action::apply_and_get_undo(
       action, m_pxtn, &widthChanged, m_unit_id_map, m_woice_id_map));
   if (widthChanged) emit measureNumChanged();
   // qDebug() << "Remote" << m_remote_index << "Local" << m_local_index;
   // qDebug() << "New action";
+  std::set<qint32> unit_ids;
+  addUnitIds(action, unit_ids);
+  emit eventsEdited(unit_ids);
   emit edited();
   return EditAction{qint64(m_remote_index + m_uncommitted.size() - 1), action};
 }
 
+// Slipping an action in before [reverse] (the undo of a later action) means
+// rolling it back if it overlaps [footprint], which grows to include it since
+// anything after that overlaps it has to be rolled back too. Non-overlapping
+// actions commute with everything being moved and can stay applied.
+// [to_undo] ends up newest first.
+using ReverseList = std::vector<Action::Primitive>;
+static void collectOverlapping(ReverseList &reverse,
+                               Action::Footprint &footprint,
+                               std::list<ReverseList *> &to_undo) {
+  Action::Footprint f(reverse);
+  if (!f.intersects(footprint)) return;
+  footprint.add(f);
+  to_undo.push_front(&reverse);
+}
+
+void PxtoneController::applyInPlace(std::vector<Action::Primitive> &actions,
+                                    bool *widthChanged) {
+  Action::apply_and_get_undo(actions, m_pxtn, widthChanged, m_unit_id_map,
+                             m_woice_id_map, m_undo_buffer);
+  std::swap(actions, m_undo_buffer);
+}
+
 void PxtoneController::setUid(qint64 uid) { m_uid = uid; }
 qint64 PxtoneController::uid() { return m_uid; }
 
+void PxtoneController::setUndoHorizon(int horizon) {
+  m_undo_horizon = std::max(horizon, 1);
+  while (m_log.size() > size_t(m_undo_horizon)) m_log.pop_front();
+}
+
+void PxtoneController::logAction(qint64 uid, qint64 idx,
+                                 std::vector<Action::Primitive> reverse) {
+  m_log.emplace_back(uid, idx, std::move(reverse));
+  if (m_log.size() > size_t(m_undo_horizon)) m_log.pop_front();
+}
+
 void PxtoneController::applyRemoteAction(const EditAction &action, qint64 uid) {
+  auto lock = lockForEdit();
   // qDebug() << "Remote" << m_remote_index << "Local" << m_local_index;
   // qDebug() << "Received action" << action.idx << "from user" << uid;
   bool widthChanged = false;
+  std::set<qint32> unit_ids;
   // Try to be liberal in what I accept:
   // If the action index is what I expect, just increment the remote counter
   // (need to undo = false). If the action's index is too high, drop whatever
@@ -83,42 +177,46 @@ exit_loop:
     // The server told us that our local action was applied! Put it in the
     // log, but no need to apply any actions since that was already
     // presumptuously applied.
-    m_log.emplace_back(uid, action.idx, m_uncommitted.front());
+    logAction(uid, action.idx, std::move(m_uncommitted.front()));
     m_uncommitted.pop_front();
   } else {
-    // Undo each of the uncommitted actions
-    // TODO: This is probably where you could be smarter and avoid undoing
-    // things that don't intersect in bbox
-    for (auto uncommitted = m_uncommitted.rbegin();
-         uncommitted != m_uncommitted.rend(); ++uncommitted) {
-      // int start_size = uncommitted->size();
-      *uncommitted = Action::apply_and_get_undo(
-          *uncommitted, m_pxtn, &widthChanged, m_unit_id_map, m_woice_id_map);
-      // qDebug() << "undoing local size(" << start_size << uncommitted->size()
-      //         << ") index(" << i-- << ")";
+    // Undo the uncommitted actions that overlap this one. If some of ours
+    // are being dropped we can't reason about what they overlapped, so undo
+    // all of them.
+    Action::Footprint footprint(action.action);
+    std::list<ReverseList *> rolled_back;
+    for (ReverseList &uncommitted : m_uncommitted) {
+      if (local_actions_to_drop > 0)
+        rolled_back.push_front(&uncommitted);
+      else
+        collectOverlapping(uncommitted, footprint, rolled_back);
+    }
+    for (ReverseList *uncommitted : rolled_back) {
+      addUnitIds(*uncommitted, unit_ids);
+      applyInPlace(*uncommitted, &widthChanged);
     }
 
     // apply the committed action
-    std::list<Action::Primitive> reverse = Action::apply_and_get_undo(
+    addUnitIds(action.action, unit_ids);
+    std::vector<Action::Primitive> reverse = Action::apply_and_get_undo(
         action.action, m_pxtn, &widthChanged, m_unit_id_map, m_woice_id_map);
 
-    if (local_actions_to_drop >= m_uncommitted.size())
+    rolled_back.reverse();
+    if (local_actions_to_drop >= m_uncommitted.size()) {
+      rolled_back.clear();
       m_uncommitted.clear();
-    else {
+    } else {
+      for (size_t i = 0; i < local_actions_to_drop; ++i)
+        rolled_back.pop_front();
       auto it_end = m_uncommitted.begin();
       advance(it_end, local_actions_to_drop);
       m_uncommitted.erase(m_uncommitted.begin(), it_end);
     }
-    // redo each of the uncommitted actions forwards
-    for (std::list<Action::Primitive> &uncommitted : m_uncommitted) {
-      // int start_size = uncommitted.size();
-      uncommitted = Action::apply_and_get_undo(
-          uncommitted, m_pxtn, &widthChanged, m_unit_id_map, m_woice_id_map);
-      // qDebug() << "redoing local size(" << start_size << uncommitted.size()
-      //         << ") index(" << i++ << ")";
-    }
+    // redo the rolled back uncommitted actions forwards
+    for (ReverseList *uncommitted : rolled_back)
+      applyInPlace(*uncommitted, &widthChanged);
 
-    m_log.emplace_back(uid, action.idx, reverse);
+    logAction(uid, action.idx, std::move(reverse));
   }
 
   m_remote_index += int(local_actions_to_drop);
@@ -126,10 +224,12 @@ exit_loop:
   // qDebug() << "m_log size" << m_log.size();
 
   if (widthChanged) emit measureNumChanged();
+  if (!unit_ids.empty()) emit eventsEdited(unit_ids);
   emit edited();
 }
 
 void PxtoneController::applyUndoRedo(const UndoRedo &r, qint64 uid) {
+  auto lock = lockForEdit();
   qDebug() << "Applying undo / redo";
   if (m_log.size() == 0) {
     qDebug() << "No actions in the log. Doing nothing.";
@@ -161,43 +261,39 @@ void PxtoneController::applyUndoRedo(const UndoRedo &r, qint64 uid) {
   }
 
   bool widthChanged = false;
-  for (auto uncommitted = m_uncommitted.rbegin();
-       uncommitted != m_uncommitted.rend(); ++uncommitted) {
-    *uncommitted = Action::apply_and_get_undo(
-        *uncommitted, m_pxtn, &widthChanged, m_unit_id_map, m_woice_id_map);
-  }
-
-  // Go back to the target action by user, temporarily undoing
-  // done actions by other users. Flip. Then redo the done actions by
-  // other users.
+  std::set<qint32> unit_ids;
+
+  // Go back to the target action by user, temporarily undoing done actions by
+  // other users and our uncommitted actions. Flip. Then redo them.
+  //
+  // Only actions that touch what the target touches, directly or through
+  // another action being rolled back, need to be undone. The rest commute
+  // with it and can stay put.
   {
-    std::list<LoggedAction *> temporarily_undone;
-    auto it = m_log.rbegin();
-    while (it != target) {
-      if (it->state == LoggedAction::UndoState::DONE) {
-        qDebug() << "Temporarily undoing " << it->uid << it->idx;
-        it->reverse = Action::apply_and_get_undo(
-            it->reverse, m_pxtn, &widthChanged, m_unit_id_map, m_woice_id_map);
-        temporarily_undone.push_front(&(*it));
-      }
-      ++it;
+    Action::Footprint footprint(target->reverse);
+    std::list<ReverseList *> temporarily_undone;
+    for (auto it = target.base(); it != m_log.end(); ++it)
+      if (it->state == LoggedAction::UndoState::DONE)
+        collectOverlapping(it->reverse, footprint, temporarily_undone);
+    for (ReverseList &uncommitted : m_uncommitted)
+      collectOverlapping(uncommitted, footprint, temporarily_undone);
+    for (ReverseList *reverse : temporarily_undone) {
+      addUnitIds(*reverse, unit_ids);
+      applyInPlace(*reverse, &widthChanged);
     }
-    it->reverse = Action::apply_and_get_undo(it->reverse, m_pxtn, &widthChanged,
-                                             m_unit_id_map, m_woice_id_map);
+    temporarily_undone.reverse();
+    auto it = target;
+    addUnitIds(it->reverse, unit_ids);
+    applyInPlace(it->reverse, &widthChanged);
     it->state = (it->state == LoggedAction::UNDONE ? LoggedAction::DONE
                                                    : LoggedAction::UNDONE);
     ;
-    for (LoggedAction *it : temporarily_undone)
-      it->reverse = Action::apply_and_get_undo(
-          it->reverse, m_pxtn, &widthChanged, m_unit_id_map, m_woice_id_map);
-  }
-
-  for (std::list<Action::Primitive> &uncommitted : m_uncommitted) {
-    uncommitted = Action::apply_and_get_undo(uncommitted, m_pxtn, &widthChanged,
-                                             m_unit_id_map, m_woice_id_map);
+    for (ReverseList *reverse : temporarily_undone)
+      applyInPlace(*reverse, &widthChanged);
   }
 
   if (widthChanged) emit measureNumChanged();
+  emit eventsEdited(unit_ids);
   emit edited();
 }
 
@@ -212,6 +308,7 @@ bool auxSetUnitName(pxtnUnit *unit, QString name) {
 // thing is they'd have to be added to the log. And a record of a delete needs
 // to include the notes that were deleted with it.
 bool PxtoneController::applyAddUnit(const AddUnit &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   if (m_pxtn->Woice_Num() <= a.woice_id || a.woice_id < 0) {
     qWarning("Voice doesn't exist. (ID out of bounds)");
@@ -241,6 +338,7 @@ bool PxtoneController::applyAddUnit(const AddUnit &a, qint64 uid) {
 }
 
 void PxtoneController::applyRemoveUnit(const RemoveUnit &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   auto unit_no_maybe = m_unit_id_map.idToNo(a.unit_id);
   if (unit_no_maybe == std::nullopt) {
@@ -263,6 +361,7 @@ void PxtoneController::applyRemoveUnit(const RemoveUnit &a, qint64 uid) {
 }
 
 void PxtoneController::applySetUnitName(const SetUnitName &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   auto unit_no_maybe = m_unit_id_map.idToNo(a.unit_id);
   if (unit_no_maybe == std::nullopt) {
@@ -275,6 +374,7 @@ void PxtoneController::applySetUnitName(const SetUnitName &a, qint64 uid) {
 }
 
 void PxtoneController::applyMoveUnit(const MoveUnit &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   auto unit_no_maybe = m_unit_id_map.idToNo(a.unit_id);
   if (unit_no_maybe == std::nullopt) {
@@ -297,6 +397,7 @@ void PxtoneController::applyMoveUnit(const MoveUnit &a, qint64 uid) {
 }
 
 bool PxtoneController::applyTempoChange(const TempoChange &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   if (a.tempo < 20 || a.tempo > 600) return false;
   m_pxtn->adjustTempo(a.tempo, *m_moo_state);
@@ -308,6 +409,7 @@ bool PxtoneController::applyTempoChange(const TempoChange &a, qint64 uid) {
 }
 
 bool PxtoneController::applyBeatChange(const BeatChange &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   if (a.beat < 1 || a.beat > 16) return false;
   m_pxtn->adjustBeatNum(a.beat, *m_moo_state);
@@ -319,6 +421,7 @@ bool PxtoneController::applyBeatChange(const BeatChange &a, qint64 uid) {
 }
 
 void PxtoneController::applySetRepeatMeas(const SetRepeatMeas &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   int m = a.meas.value_or(0);
   if (m >= m_pxtn->master->get_play_meas())
@@ -328,6 +431,7 @@ void PxtoneController::applySetRepeatMeas(const SetRepeatMeas &a, qint64 uid) {
 }
 
 void PxtoneController::applySetLastMeas(const SetLastMeas &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   int m = a.meas.value_or(0);
   if (m != 0 && m <= m_pxtn->master->get_repeat_meas())
@@ -337,6 +441,7 @@ void PxtoneController::applySetLastMeas(const SetLastMeas &a, qint64 uid) {
 }
 
 void PxtoneController::applyAddOverdrive(const Overdrive::Add &, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   if (m_pxtn->OverDrive_Num() >= m_pxtn->OverDrive_Max()) return;
   emit beginAddOverdrive();
@@ -345,6 +450,7 @@ void PxtoneController::applyAddOverdrive(const Overdrive::Add &, qint64 uid) {
 }
 
 void PxtoneController::applySetOverdrive(const Overdrive::Set &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   if (!m_pxtn->OverDrive_Set(a.ovdrv_no, a.cut, a.amp, a.group)) return;
   emit overdriveChanged(a.ovdrv_no);
@@ -353,6 +459,7 @@ void PxtoneController::applySetOverdrive(const Overdrive::Set &a, qint64 uid) {
 
 void PxtoneController::applyRemoveOverdrive(const Overdrive::Remove &a,
                                             qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   if (m_pxtn->OverDrive_Num() <= a.ovdrv_no) return;
   emit beginRemoveOverdrive(a.ovdrv_no);
@@ -361,6 +468,7 @@ void PxtoneController::applyRemoveOverdrive(const Overdrive::Remove &a,
 }
 
 void PxtoneController::applySetDelay(const Delay::Set &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   if (!m_pxtn->Delay_Set(a.delay_no, a.unit, a.freq, a.rate, a.group)) return;
   m_pxtn->Delay_ReadyTone(a.delay_no, *m_moo_state);
@@ -369,6 +477,7 @@ void PxtoneController::applySetDelay(const Delay::Set &a, qint64 uid) {
 }
 
 void PxtoneController::seekMoo(int64_t clock) {
+  std::lock_guard<std::recursive_mutex> lock(m_engine_mutex);
   pxtnVOMITPREPARATION prep{};
   prep.flags |= pxtnVOMITPREPFLAG_loop | pxtnVOMITPREPFLAG_unit_mute;
   prep.start_pos_sample = clock * 60 * 44100 /
@@ -382,10 +491,17 @@ void PxtoneController::seekMoo(int64_t clock) {
 }
 
 void PxtoneController::refreshMoo() {
+  std::lock_guard<std::recursive_mutex> lock(m_engine_mutex);
   seekMoo(m_pxtn->moo_get_now_clock(*m_moo_state));
 }
 
+PxtoneController::MooPosition PxtoneController::mooPosition() {
+  std::lock_guard<std::recursive_mutex> lock(m_engine_mutex);
+  return {m_pxtn->moo_get_now_clock(*m_moo_state), m_moo_state->num_loop};
+}
+
 void PxtoneController::setVolume(int volume) {
+  std::lock_guard<std::recursive_mutex> lock(m_engine_mutex);
   double v = volume / 100.0;
   double ampl = pow(25, v - 1);
   if (v < 0.1) ampl *= v / 0.1;
@@ -393,6 +509,7 @@ void PxtoneController::setVolume(int volume) {
 }
 
 bool PxtoneController::loadDescriptor(pxtnDescriptor &desc) {
+  auto lock = lockForEdit();
   emit beginRefresh();
   if (desc.get_size_bytes() > 0) {
     if (m_pxtn->read(&desc) != pxtnOK) {
@@ -408,6 +525,11 @@ bool PxtoneController::loadDescriptor(pxtnDescriptor &desc) {
   }
   m_unit_id_map = NoIdMap(m_pxtn->Unit_Num());
   m_woice_id_map = NoIdMap(m_pxtn->Woice_Num());
+  // The log refers to the old song, and the session's history gets replayed
+  // on top of this.
+  m_log.clear();
+  m_uncommitted.clear();
+  m_remote_index = 0;
   if (m_pxtn->tones_ready(*m_moo_state) != pxtnOK) {
     qWarning() << "Error getting tones ready";
     return false;
@@ -426,6 +548,7 @@ bool PxtoneController::loadDescriptor(pxtnDescriptor &desc) {
 }
 
 bool PxtoneController::applyAddWoice(const AddWoice &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   pxtnDescriptor d;
   d.set_memory_r(a.data.constData(), a.data.size());
@@ -473,6 +596,7 @@ bool validateRemoveName(const RemoveWoice &a, const pxtnService *pxtn) {
 // TODO: Once you add the ability for units to change instruments,
 // you'll need a map for voices.
 bool PxtoneController::applyRemoveWoice(const RemoveWoice &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
   if (m_pxtn->Woice_Num() == 1) {
     qWarning() << "Cannot remove last woice.";
@@ -494,6 +618,7 @@ bool PxtoneController::applyRemoveWoice(const RemoveWoice &a, qint64 uid) {
 }
 
 bool PxtoneController::applyChangeWoice(const ChangeWoice &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
 
   if (!validateRemoveName(a.remove, m_pxtn)) return false;
@@ -501,7 +626,8 @@ bool PxtoneController::applyChangeWoice(const ChangeWoice &a, qint64 uid) {
   // TODO: Remove duplication with add woice
   pxtnDescriptor d;
   d.set_memory_r(a.add.data.constData(), a.add.data.size());
-  std::shared_ptr<pxtnWoice> woice = m_pxtn->Woice_Get_variable(a.remove.id);
+  // Read into a new woice so that any snapshot keeps the old one.
+  std::shared_ptr<pxtnWoice> woice = std::make_shared<pxtnWoice>();
   pxtnERR result = woice->read(&d, a.add.type);
   if (result != pxtnOK) {
     qDebug() << "Woice_read error" << result << a.remove.name;
@@ -513,14 +639,16 @@ bool PxtoneController::applyChangeWoice(const ChangeWoice &a, qint64 uid) {
       name_str.data(),
       std::min(pxtnMAX_TUNEWOICENAME, int32_t(name_str.length())));
   m_pxtn->Woice_ReadyTone(woice);
+  replaceWoice(a.remove.id, woice);
   emit woiceEdited(a.remove.id);
   emit edited();
   return true;
 }
 
 bool PxtoneController::applyWoiceSet(const Woice::Set &a, qint64 uid) {
+  auto lock = lockForEdit();
   (void)uid;
-  std::shared_ptr<pxtnWoice> woice = m_pxtn->Woice_Get_variable(a.id);
+  std::shared_ptr<pxtnWoice> woice = woiceForEdit(a.id);
   if (woice == nullptr) return false;
   for (int i = 0; i < woice->get_voice_num(); ++i) {
     pxtnVOICEUNIT *voice = woice->get_voice_variable(i);
@@ -563,17 +691,20 @@ bool PxtoneController::applyWoiceSet(const Woice::Set &a, qint64 uid) {
 }
 
 void PxtoneController::setUnitPlayed(int unit_no, bool played) {
+  auto lock = lockForEdit();
   pxtnUnit *u = m_pxtn->Unit_Get_variable(unit_no);
   if (!u) return;
   u->set_played(played);
   emit playedToggled(unit_no);
 }
 void PxtoneController::setUnitVisible(int unit_no, bool visible) {
+  auto lock = lockForEdit();
   pxtnUnit *u = m_pxtn->Unit_Get_variable(unit_no);
   if (!u) return;
   u->set_visible(visible);
 }
 void PxtoneController::setUnitOperated(int unit_no, bool operated) {
+  auto lock = lockForEdit();
   pxtnUnit *u = m_pxtn->Unit_Get_variable(unit_no);
   if (!u) return;
   u->set_operated(operated);
@@ -582,6 +713,7 @@ void PxtoneController::setUnitOperated(int unit_no, bool operated) {
 // If currently this unit is soloing, unmute everything. Else mute everything
 // but this unit.
 void PxtoneController::toggleSolo(int solo_unit_no) {
+  auto lock = lockForEdit();
   pxtnUnit *solo_u = m_pxtn->Unit_Get_variable(solo_unit_no);
   if (!solo_u) return;
 
@@ -600,104 +732,3 @@ void PxtoneController::toggleSolo(int solo_unit_no) {
   solo_u->set_played(true);
   emit soloToggled();
 }
-
-// from
-// https://stackoverflow.com/questions/40238343/qfile-write-a-wav-header-writes-only-4-byte-data
-struct WavHdr {
-  constexpr static quint32 k_riff_id = 0x46464952;
-  constexpr static quint32 k_wave_format = 0x45564157;
-  constexpr static quint32 k_fmt_id = 0x20746d66;
-  constexpr static quint32 k_data_id = 0x61746164;
-  // RIFF
-  quint32 chunk_id = k_riff_id;
-  quint32 chunk_size;
-  quint32 chunk_format = k_wave_format;
-  // fmt
-  quint32 fmt_id = k_fmt_id;
-  quint32 fmt_size;
-  quint16 audio_format;
-  quint16 num_channels;
-  quint32 sample_rate;
-  quint32 byte_rate;
-  quint16 block_align;
-  quint16 bits_per_sample;
-  // data
-  quint32 data_id = k_data_id;
-  quint32 data_size;
-};
-
-bool write(QIODevice *dev, const WavHdr &h) {
-  QDataStream s{dev};
-  s.setByteOrder(QDataStream::LittleEndian);  // for RIFF
-  s << h.chunk_id << h.chunk_size << h.chunk_format;
-  s << h.fmt_id << h.fmt_size << h.audio_format << h.num_channels
-    << h.sample_rate << h.byte_rate << h.block_align << h.bits_per_sample;
-  s << h.data_id << h.data_size;
-  return s.status() == QDataStream::Ok;
-}
-
-// TODO: This kind of file-writing is duplicated a bunch.
-bool PxtoneController::render(
-    QIODevice *dev, double secs, double fadeout,
-    std::function<bool(double progress)> should_continue) const {
-  qDebug() << "Rendering" << secs << fadeout;
-  WavHdr h;
-  h.fmt_size = h.bits_per_sample = 16;
-  h.audio_format = 1;
-  int num_channels, sample_rate;
-  m_pxtn->get_destination_quality(&num_channels, &sample_rate);
-  h.num_channels = num_channels;
-  h.sample_rate = sample_rate;
-  h.block_align = h.num_channels * h.bits_per_sample / 8;
-  h.byte_rate = h.sample_rate * h.num_channels * h.bits_per_sample / 8;
-
-  int num_samples = int(h.sample_rate * secs);
-  if (fadeout > 0) num_samples += int(h.sample_rate * fadeout) + 10;
-  h.data_size = num_samples * h.num_channels * h.bits_per_sample / 8;
-
-  mooState moo_state;
-  if (m_pxtn->tones_ready(moo_state) != pxtnOK) {
-    qWarning() << "Error getting tones ready";
-    return false;
-  }
-  pxtnVOMITPREPARATION prep{};
-  prep.flags |= pxtnVOMITPREPFLAG_loop | pxtnVOMITPREPFLAG_unit_mute;
-  prep.start_pos_sample = 0;
-  prep.master_volume = moo_state.params.master_vol;
-  bool success = m_pxtn->moo_preparation(&prep, moo_state);
-  if (!success) {
-    qWarning() << "Moo preparation error";
-    return false;
-  }
-
-  write(dev, h);
-  int written = 0;
-  auto render = [&](int len) {
-    constexpr int SIZE = 4096;
-    char buf[SIZE];
-    while (written < len) {
-      int filled_len;
-      if (!m_pxtn->Moo(moo_state, buf, int32_t(std::min(len - written, SIZE)),
-                       &filled_len)) {
-        qWarning() << "Moo error during rendering";
-        return false;
-      }
-      if (dev->write(buf, filled_len) < filled_len) {
-        qWarning() << "Unable to fill file buffer";
-        return false;
-      }
-      if (!should_continue((0.0 + written) / h.data_size)) return false;
-
-      written += filled_len;
-    }
-    return true;
-  };
-
-  if (!render(int(h.sample_rate * secs) * h.num_channels * h.bits_per_sample /
-              8))
-    return false;
-  m_pxtn->moo_set_fade(-1, fadeout, moo_state);
-  if (!render(h.data_size)) return false;
-
-  return true;
-}
@@ -2,7 +2,10 @@
 #define PXTONECONTROLLER_H
 #include <QObject>
 #include <QTextCodec>
+#include <deque>
 #include <list>
+#include <mutex>
+#include <set>
 
 #include "audio/PxtoneIODevice.h"
 #include "protocol/PxtoneEditAction.h"
@@ -17,10 +20,9 @@ struct LoggedAction {
   qint64 uid;
   qint64 idx;
   // TODO: Figure out where to call sth undo vs. reverse
-  std::list<Action::Primitive> reverse;
-  LoggedAction(qint64 uid, qint64 idx,
-               const std::list<Action::Primitive> &reverse)
-      : state(DONE), uid(uid), idx(idx), reverse(reverse) {}
+  std::vector<Action::Primitive> reverse;
+  LoggedAction(qint64 uid, qint64 idx, std::vector<Action::Primitive> reverse)
+      : state(DONE), uid(uid), idx(idx), reverse(std::move(reverse)) {}
 };
 
 class PxtoneController : public QObject {
@@ -30,9 +32,12 @@ class PxtoneController : public QObject {
                    QObject *parent);
 
   // rename to applyAndGetEditAction and applyEditAction
-  EditAction applyLocalAction(const std::list<Action::Primitive> &action);
+  EditAction applyLocalAction(const std::vector<Action::Primitive> &action);
   void setUid(qint64 uid);
   qint64 uid();
+  // How many actions back anyone can undo. Every client in a session has to
+  // use the same value, so it comes from the server.
+  void setUndoHorizon(int horizon);
   const NoIdMap &unitIdMap() const { return m_unit_id_map; }
   const NoIdMap &woiceIdMap() const { return m_woice_id_map; }
   bool loadDescriptor(pxtnDescriptor &desc);
@@ -46,18 +51,28 @@ class PxtoneController : public QObject {
   void seekMoo(int64_t clock);
   void refreshMoo();
   const mooState *moo() { return m_moo_state; }
+  struct MooPosition {
+    int32_t clock;
+    int num_loop;
+  };
+  // Where playback's rendered up to. Takes the engine mutex, since the render
+  // thread moves it, so read the rest of moo() under the lock too.
+  MooPosition mooPosition();
   const pxtnService *pxtn() { return m_pxtn; };
+  // Held while the song or moo state changes, since playback renders them on
+  // another thread.
+  std::recursive_mutex *engineMutex() { return &m_engine_mutex; }
+  // A read-only copy of the song as it is now, for reading off the main
+  // thread without the engine mutex. A new copy is only made if the song has
+  // changed since the last one. Only rendering to file uses these so far;
+  // playback and the views still read [pxtn] under the engine mutex.
+  std::shared_ptr<const pxtnService> snapshot();
   void setVolume(int volume);
 
   void setUnitPlayed(int unit_no, bool played);
   void setUnitVisible(int unit_no, bool visible);
   void setUnitOperated(int unit_no, bool operated);
   void toggleSolo(int unit_no);
-  bool render(
-      QIODevice *file, double secs, double fadeout,
-      std::function<bool(double progress)> should_continue = [](double) {
-        return true;
-      }) const;
 
  public slots:
   // Maybe these types could be grouped.
@@ -80,6 +95,8 @@ class PxtoneController : public QObject {
   void soloToggled();
   void newSong();
   void edited();
+  // Events of these units (by ID) may have changed.
+  void eventsEdited(const std::set<qint32> &unit_ids);
 
   void seeked(qint32 clock);
 
@@ -114,11 +131,31 @@ class PxtoneController : public QObject {
   pxtnService *m_pxtn;
   mooState *m_moo_state;
   PxtoneIODevice *m_moo_io_device;
-
-  std::vector<LoggedAction> m_log;
-  std::list<std::list<Action::Primitive>> m_uncommitted;
+  std::recursive_mutex m_engine_mutex;
+  // Bumped whenever the engine mutex is taken to edit the song.
+  qint64 m_version;
+  qint64 m_snapshot_version;
+  // Snapshots share woices with the song, so woices are replaced rather than
+  // changed in place while any of these are alive. The newest is last.
+  std::list<std::weak_ptr<const pxtnService>> m_snapshots;
+
+  std::deque<LoggedAction> m_log;
+  int m_undo_horizon;
+  std::list<std::vector<Action::Primitive>> m_uncommitted;
   NoIdMap m_unit_id_map, m_woice_id_map;
   int m_remote_index;
+  // Scratch space for undos computed in place, so that rolling actions back
+  // and forth swaps buffers instead of allocating new ones.
+  std::vector<Action::Primitive> m_undo_buffer;
+  void applyInPlace(std::vector<Action::Primitive> &actions,
+                    bool *widthChanged);
+  void logAction(qint64 uid, qint64 idx,
+                 std::vector<Action::Primitive> reverse);
+  std::unique_lock<std::recursive_mutex> lockForEdit();
+  bool snapshotsAlive();
+  // Woice [idx], copied first if a snapshot is using it.
+  std::shared_ptr<pxtnWoice> woiceForEdit(int32_t idx);
+  void replaceWoice(int32_t idx, std::shared_ptr<pxtnWoice> woice);
 };
 
 const extern QTextCodec *shift_jis_codec;
@@ -1,5 +1,6 @@
 #include "RenderDialog.h"
 
+#include <QDir>
 #include <QDoubleValidator>
 #include <QFileDialog>
 
@@ -13,17 +14,41 @@ RenderDialog::RenderDialog(QWidget *parent)
   ui->setupUi(this);
   ui->lengthEdit->setValidator(&lengthValidator);
   ui->fadeOutEdit->setValidator(&lengthValidator);
-  ui->saveToEdit->setText(RenderFileDestination::get());
+  for (const AudioFileFormatInfo &f : audioFileFormats())
+    ui->formatCombo->addItem(f.name, int(f.format));
+  ui->stemsCombo->addItem(tr("None"), pxtnSTEM_none);
+  ui->stemsCombo->addItem(tr("One file per unit"), pxtnSTEM_unit);
+  ui->stemsCombo->addItem(tr("One file per group"), pxtnSTEM_group);
+
+  QString destination = RenderFileDestination::get();
+  ui->saveToEdit->setText(destination);
+  if (const AudioFileFormatInfo *f =
+          audioFileFormatOfSuffix(QFileInfo(destination).suffix()))
+    ui->formatCombo->setCurrentText(f->name);
 
   connect(ui->saveToBtn, &QPushButton::pressed, [this]() {
+    const AudioFileFormatInfo &f =
+        audioFileFormats()[ui->formatCombo->currentIndex()];
     QString filename = QFileDialog::getSaveFileName(
         this, "Render to file", RenderFileDestination::get(),
-        tr("WAV file (*.wav)"));
-    if (QFileInfo(filename).suffix() != "wav") filename += ".wav";
+        tr("%1 file (*.%2)").arg(f.name, f.suffix));
+    if (filename.isEmpty()) return;
+    if (QFileInfo(filename).suffix() != f.suffix) filename += "." + f.suffix;
     filename = QFileInfo(filename).absoluteFilePath();
     ui->saveToEdit->setText(filename);
   });
 
+  connect(ui->formatCombo, qOverload<int>(&QComboBox::currentIndexChanged),
+          [this](int index) {
+            if (index < 0) return;
+            QString filename = ui->saveToEdit->text();
+            if (filename.isEmpty()) return;
+            QFileInfo info(filename);
+            ui->saveToEdit->setText(info.dir().filePath(
+                info.completeBaseName() + "." +
+                audioFileFormats()[index].suffix));
+          });
+
   connect(ui->saveToEdit, &QLineEdit::textChanged, &RenderFileDestination::set);
 }
 
@@ -57,3 +82,11 @@ double RenderDialog::renderFadeout() {
 }
 
 QString RenderDialog::renderDestination() { return ui->saveToEdit->text(); }
+
+AudioFileFormat RenderDialog::renderFormat() {
+  return AudioFileFormat(ui->formatCombo->currentData().toInt());
+}
+
+pxtnSTEMKIND RenderDialog::renderStems() {
+  return pxtnSTEMKIND(ui->stemsCombo->currentData().toInt());
+}
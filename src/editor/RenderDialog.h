@@ -3,6 +3,9 @@
 
 #include <QDialog>
 
+#include "pxtone/pxtnService.h"
+#include "render/AudioEncoder.h"
+
 namespace Ui {
 class RenderDialog;
 }
@@ -19,6 +22,8 @@ class RenderDialog : public QDialog {
   double renderLength();
   double renderFadeout();
   QString renderDestination();
+  AudioFileFormat renderFormat();
+  pxtnSTEMKIND renderStems();
 
  private:
   Ui::RenderDialog *ui;
@@ -1,5 +1,9 @@
 #include "Settings.h"
 
+#include <algorithm>
+
+#include "protocol/Hello.h"
+
 const QString WOICE_DIR_KEY("woice_dir");
 const QString BUFFER_LENGTH_KEY("buffer_length");
 const double DEFAULT_BUFFER_LENGTH = 0.5;
@@ -56,3 +60,14 @@ const QString KEY("render_file_destination");
 QString get() { return QSettings().value(KEY, "").toString(); }
 void set(QString value) { QSettings().setValue(KEY, value); }
 }  // namespace RenderFileDestination
+
+namespace UndoHorizon {
+const QString KEY("undo_horizon");
+int get() {
+  bool ok;
+  int value = QSettings().value(KEY, DEFAULT_UNDO_HORIZON).toInt(&ok);
+  if (!ok) return DEFAULT_UNDO_HORIZON;
+  return std::max(value, 1);
+}
+void set(int value) { QSettings().setValue(KEY, value); }
+}  // namespace UndoHorizon
@@ -40,5 +40,9 @@ namespace RenderFileDestination {
 QString get();
 void set(QString);
 }  // namespace RenderFileDestination
+namespace UndoHorizon {
+int get();
+void set(int);
+}  // namespace UndoHorizon
 
 #endif  // SETTINGS_H
@@ -0,0 +1,72 @@
+#ifndef AUDIORING_H
+#define AUDIORING_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+// A byte ring buffer for one thread writing and one other thread reading,
+// without locks. Positions only ever increase and are taken modulo the
+// capacity when indexing.
+class AudioRing {
+ public:
+  AudioRing(size_t capacity = 0) : m_buf(capacity), m_read(0), m_write(0) {}
+
+  // Not safe while either side is running.
+  void resize(size_t capacity) {
+    m_buf.assign(capacity, 0);
+    m_read = 0;
+    m_write = 0;
+  }
+  size_t capacity() const { return m_buf.size(); }
+
+  // Reader side.
+  size_t readable() const {
+    return m_write.load(std::memory_order_acquire) -
+           m_read.load(std::memory_order_relaxed);
+  }
+  size_t read(char *data, size_t len) {
+    size_t read = m_read.load(std::memory_order_relaxed);
+    len = std::min(len, m_write.load(std::memory_order_acquire) - read);
+    copy(data, read, len, false);
+    m_read.store(read + len, std::memory_order_release);
+    return len;
+  }
+  // Drops everything written so far.
+  void clear() {
+    m_read.store(m_write.load(std::memory_order_acquire),
+                 std::memory_order_release);
+  }
+
+  // Writer side.
+  size_t writable() const {
+    return m_buf.size() - (m_write.load(std::memory_order_relaxed) -
+                           m_read.load(std::memory_order_acquire));
+  }
+  size_t write(const char *data, size_t len) {
+    size_t write = m_write.load(std::memory_order_relaxed);
+    len = std::min(len, writable());
+    copy(const_cast<char *>(data), write, len, true);
+    m_write.store(write + len, std::memory_order_release);
+    return len;
+  }
+
+ private:
+  void copy(char *data, size_t pos, size_t len, bool into_ring) {
+    if (len == 0) return;
+    size_t start = pos % m_buf.size();
+    size_t first = std::min(len, m_buf.size() - start);
+    if (into_ring) {
+      memcpy(&m_buf[start], data, first);
+      memcpy(&m_buf[0], data + first, len - first);
+    } else {
+      memcpy(data, &m_buf[start], first);
+      memcpy(data + first, &m_buf[0], len - first);
+    }
+  }
+  std::vector<char> m_buf;
+  std::atomic<size_t> m_read, m_write;
+};
+
+#endif  // AUDIORING_H
@@ -0,0 +1,90 @@
+#include "MooRenderThread.h"
+
+#include <chrono>
+#include <vector>
+
+// Small enough that edits and seeks don't wait long on the engine mutex.
+constexpr size_t CHUNK_BYTES = 4096;
+// How long to sleep when paused or the ring is full, if nothing wakes us.
+constexpr auto IDLE_WAIT = std::chrono::milliseconds(20);
+// Time the stages of one sample in this many.
+constexpr int32_t PROFILE_STRIDE = 64;
+
+MooRenderThread::MooRenderThread(const pxtnService *pxtn, mooState *moo_state,
+                                 std::recursive_mutex *engine_mutex,
+                                 AudioRing *ring, QObject *parent)
+    : QThread(parent),
+      m_pxtn(pxtn),
+      m_moo_state(moo_state),
+      m_profile(PROFILE_STRIDE),
+      m_engine_mutex(engine_mutex),
+      m_ring(ring),
+      m_fill_target(ring->capacity()),
+      m_playing(false),
+      m_woken(false) {
+  m_moo_state->profile = &m_profile;
+}
+
+MooRenderThread::~MooRenderThread() {
+  requestInterruption();
+  wake();
+  wait();
+  std::lock_guard<std::recursive_mutex> lock(*m_engine_mutex);
+  m_moo_state->profile = nullptr;
+}
+
+void MooRenderThread::setPlaying(bool playing) {
+  m_playing = playing;
+  wake();
+}
+
+void MooRenderThread::setFillTarget(size_t bytes) {
+  m_fill_target = bytes;
+  wake();
+}
+
+void MooRenderThread::wake() {
+  {
+    std::lock_guard<std::mutex> lock(m_wake_mutex);
+    m_woken = true;
+  }
+  m_wake.notify_one();
+}
+
+pxtnMooProfile MooRenderThread::takeProfile() {
+  std::lock_guard<std::recursive_mutex> lock(*m_engine_mutex);
+  pxtnMooProfile profile = m_profile;
+  m_profile.reset();
+  return profile;
+}
+
+void MooRenderThread::run() {
+  std::vector<char> chunk(CHUNK_BYTES);
+  bool failed = false;
+  while (!isInterruptionRequested()) {
+    if (m_playing && !failed) {
+      // The ring's resized under the engine mutex, so only look at it here.
+      std::lock_guard<std::recursive_mutex> lock(*m_engine_mutex);
+      size_t buffered = m_ring->capacity() - m_ring->writable();
+      size_t target = m_fill_target;
+      size_t len =
+          std::min(target > buffered ? target - buffered : 0, CHUNK_BYTES);
+      int32_t byte_per_smp = 4;
+      m_pxtn->get_byte_per_smp(&byte_per_smp);
+      len -= len % byte_per_smp;
+      if (len > 0) {
+        int32_t filled = 0;
+        failed = !m_pxtn->Moo(*m_moo_state, chunk.data(), len, &filled);
+        m_ring->write(chunk.data(), filled);
+        if (!failed) continue;
+        emit mooError();
+      }
+    }
+
+    std::unique_lock<std::mutex> lock(m_wake_mutex);
+    m_wake.wait_for(lock, IDLE_WAIT, [this]() { return m_woken; });
+    m_woken = false;
+    // A seek or new song may have made the moo work again.
+    failed = false;
+  }
+}
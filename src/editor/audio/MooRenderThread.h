@@ -0,0 +1,50 @@
+#ifndef MOORENDERTHREAD_H
+#define MOORENDERTHREAD_H
+
+#include <QThread>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include "AudioRing.h"
+#include "pxtone/pxtnService.h"
+
+// Runs the moo for playback on its own thread, keeping [ring] topped up so
+// that the audio device only has to copy out of it. The engine mutex is held
+// while rendering each chunk, so anything that changes the song or [moo_state]
+// has to hold it too. Playback is always profiled, at a stride that keeps it
+// cheap.
+class MooRenderThread : public QThread {
+  Q_OBJECT
+  const pxtnService *m_pxtn;
+  mooState *m_moo_state;
+  pxtnMooProfile m_profile;
+  std::recursive_mutex *m_engine_mutex;
+  AudioRing *m_ring;
+  std::atomic<size_t> m_fill_target;
+  std::atomic<bool> m_playing;
+  std::mutex m_wake_mutex;
+  std::condition_variable m_wake;
+  bool m_woken;
+
+ protected:
+  void run() override;
+
+ public:
+  MooRenderThread(const pxtnService *pxtn, mooState *moo_state,
+                  std::recursive_mutex *engine_mutex, AudioRing *ring,
+                  QObject *parent = nullptr);
+  ~MooRenderThread();
+  void setPlaying(bool playing);
+  // Keep this many bytes rendered ahead, up to the ring's capacity.
+  void setFillTarget(size_t bytes);
+  // Called by the reader once there's space in the ring.
+  void wake();
+  // The profile since it was last taken.
+  pxtnMooProfile takeProfile();
+
+ signals:
+  void mooError();
+};
+
+#endif  // MOORENDERTHREAD_H
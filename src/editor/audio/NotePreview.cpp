@@ -1,35 +1,33 @@
 #include "NotePreview.h"
 
-#include <QAudioFormat>
-#include <QAudioOutput>
 #include <QDebug>
 #include <QSettings>
 
-#include "AudioFormat.h"
 #include "NotePreview.h"
-#include "PxtoneUnitIODevice.h"
 #include "editor/Settings.h"
 
-// TODO: m_unit should probably be not a member variable but an r-value passed
-// to the child.
 constexpr int32_t LONG_ON_VALUE = 100000000;
 
-static PxtoneUnitIODevice *device = nullptr;
-static QAudioOutput *audio = nullptr;
-
 NotePreview::NotePreview(const pxtnService *pxtn, const mooParams *moo_params,
                          int unit_no, int clock,
                          std::list<EVERECORD> additional_events, int duration,
                          std::shared_ptr<const pxtnWoice> starting_woice,
-                         int bufferSize, QObject *parent)
+                         std::shared_ptr<PreviewMixer> mixer, QObject *parent)
     : QObject(parent),
       m_pxtn(pxtn),
-      m_unit(nullptr),
+      m_mixer(mixer),
+      m_this_unit(nullptr),
       m_moo_state(nullptr),
       m_moo_params(moo_params) {
+  // Without an audio device there's nowhere to play.
+  if (m_mixer == nullptr) return;
+  // Everything's set up before taking the mixer's lock, since the audio
+  // device waits on it.
+  std::optional<pxtnUnitTone> voice;
   if (!ChordPreview::get() || unit_no == -1) {
-    m_unit = std::make_unique<pxtnUnitTone>(starting_woice);
-    m_this_unit = m_unit.get();
+    voice.emplace(starting_woice);
+    voice->Tone_Clear();
+    m_this_unit = &voice.value();
     moo_params->resetVoiceOn(m_this_unit);
     if (unit_no != -1)
       for (const EVERECORD *e = m_pxtn->evels->get_Records();
@@ -39,7 +37,7 @@ NotePreview::NotePreview(const pxtnService *pxtn, const mooParams *moo_params,
         }
       }
   } else {
-    m_moo_state = std::make_unique<mooState>();
+    m_moo_state = m_mixer->takeMooState();
     pxtnVOMITPREPARATION prep{};
     prep.flags |= pxtnVOMITPREPFLAG_loop | pxtnVOMITPREPFLAG_unit_mute;
     prep.start_pos_sample = clock * 60 * 44100 /
@@ -62,7 +60,7 @@ NotePreview::NotePreview(const pxtnService *pxtn, const mooParams *moo_params,
 
   // We don't constantly reset because sometimes the audio engine forces
   // [life_count = 0] (say at the end of the sample)
-  if (m_unit != nullptr) {
+  if (voice.has_value()) {
     std::shared_ptr<const pxtnWoice> woice = m_this_unit->get_woice();
     for (int i = 0; i < woice->get_voice_num(); ++i) {
       // TODO: calculating the life count should be more automatic.
@@ -70,6 +68,11 @@ NotePreview::NotePreview(const pxtnService *pxtn, const mooParams *moo_params,
       tone->on_count = duration;
       tone->life_count = duration + woice->get_instance(i)->env_release;
     }
+    // Whatever played in the slot before is swapped into [voice], and freed
+    // once the lock's released.
+    std::lock_guard<std::mutex> lock(m_mixer->mutex());
+    m_voice = m_mixer->startVoice(voice.value());
+    m_this_unit = m_mixer->voice(m_voice.value());
   }
   if (m_moo_state != nullptr) {
     for (auto &unit : m_moo_state->units) {
@@ -83,29 +86,19 @@ NotePreview::NotePreview(const pxtnService *pxtn, const mooParams *moo_params,
         }
       }
     }
-  }
-
-  if (device == nullptr) {
-    device = new PxtoneUnitIODevice(nullptr, m_pxtn, moo_params);
-    device->open(QIODevice::ReadOnly);
-  }
-
-  if (m_unit != nullptr) m_unit_ids.push_back(device->addUnit(m_unit.get()));
-  if (m_moo_state != nullptr) {
+    std::lock_guard<std::mutex> lock(m_mixer->mutex());
     for (auto &unit : m_moo_state->units)
-      m_unit_ids.push_back(device->addUnit(&unit));
-  }
-
-  if (audio == nullptr) {
-    audio = new QAudioOutput(pxtoneAudioFormat(), device);
-    audio->setVolume(1.0);
-    audio->setBufferSize(bufferSize);
-    audio->start(device);
+      m_unit_ids.push_back(m_mixer->addUnit(&unit));
   }
 }
 
 void NotePreview::processEvent(EVENTKIND kind, int32_t value) {
-  m_moo_params->processNonOnEvent(m_this_unit, kind, value, m_pxtn);
+  if (m_mixer == nullptr) return;
+  std::lock_guard<std::mutex> lock(m_mixer->mutex());
+  // A pooled voice may have been stolen by a newer note.
+  pxtnUnitTone *unit =
+      m_voice.has_value() ? m_mixer->voice(m_voice.value()) : m_this_unit;
+  if (unit) m_moo_params->processNonOnEvent(unit, kind, value, m_pxtn);
 }
 
 static EVERECORD ev(int32_t clock, EVENTKIND kind, int32_t value) {
@@ -118,35 +111,41 @@ static EVERECORD ev(int32_t clock, EVENTKIND kind, int32_t value) {
 
 NotePreview::NotePreview(const pxtnService *pxtn, const mooParams *moo_params,
                          int unit_no, int clock, int pitch, int vel,
-                         int bufferSize, QObject *parent)
+                         std::shared_ptr<PreviewMixer> mixer, QObject *parent)
     : NotePreview(
           pxtn, moo_params, unit_no, clock,
           {ev(clock, EVENTKIND_KEY, pitch), ev(clock, EVENTKIND_VELOCITY, vel)},
-          LONG_ON_VALUE, pxtn->Woice_Get(EVENTDEFAULT_VOICENO), bufferSize,
+          LONG_ON_VALUE, pxtn->Woice_Get(EVENTDEFAULT_VOICENO), mixer,
           parent) {}
 
 NotePreview::NotePreview(const pxtnService *pxtn, const mooParams *moo_params,
                          int unit_no, int clock, int duration,
-                         std::list<EVERECORD> additional_events, int bufferSize,
-                         QObject *parent)
+                         std::list<EVERECORD> additional_events,
+                         std::shared_ptr<PreviewMixer> mixer, QObject *parent)
     : NotePreview(pxtn, moo_params, unit_no, clock, additional_events, duration,
-                  pxtn->Woice_Get(EVENTDEFAULT_VOICENO), bufferSize, parent){};
+                  pxtn->Woice_Get(EVENTDEFAULT_VOICENO), mixer, parent){};
 
 NotePreview::NotePreview(const pxtnService *pxtn, const mooParams *moo_params,
                          int unit_no, int clock,
-                         std::list<EVERECORD> additional_events, int bufferSize,
-                         QObject *parent)
+                         std::list<EVERECORD> additional_events,
+                         std::shared_ptr<PreviewMixer> mixer, QObject *parent)
     : NotePreview(pxtn, moo_params, unit_no, clock, LONG_ON_VALUE,
-                  additional_events, bufferSize, parent){};
+                  additional_events, mixer, parent){};
 
 NotePreview::NotePreview(const pxtnService *pxtn, const mooParams *moo_params,
                          int pitch, int vel, int duration,
-                         std::shared_ptr<const pxtnWoice> woice, int bufferSize,
-                         QObject *parent)
+                         std::shared_ptr<const pxtnWoice> woice,
+                         std::shared_ptr<PreviewMixer> mixer, QObject *parent)
     : NotePreview(pxtn, moo_params, -1, 0,
                   {ev(0, EVENTKIND_KEY, pitch), ev(0, EVENTKIND_VELOCITY, vel)},
-                  duration, woice, bufferSize, parent) {}
+                  duration, woice, mixer, parent) {}
 
 NotePreview::~NotePreview() {
-  for (const auto &id : m_unit_ids) device->removeUnit(id);
+  if (m_mixer == nullptr) return;
+  {
+    std::lock_guard<std::mutex> lock(m_mixer->mutex());
+    if (m_voice.has_value()) m_mixer->stopVoice(m_voice.value());
+    for (const auto &id : m_unit_ids) m_mixer->removeUnit(id);
+  }
+  if (m_moo_state) m_mixer->returnMooState(std::move(m_moo_state));
 }
@@ -0,0 +1,103 @@
+#include "PreviewMixer.h"
+
+PreviewMixer::PreviewMixer(const pxtnService *pxtn, const mooParams *moo_params)
+    : m_next_generation(0),
+      m_pxtn(pxtn),
+      m_moo_params(moo_params),
+      m_next_unit_id(0),
+      m_time_pan_index(0) {
+  for (Slot &s : m_slots) s.generation = m_next_generation++;
+  m_mixing.reserve(MAX_VOICES);
+}
+
+static bool isQuiet(const pxtnUnitTone &unit) {
+  for (int i = 0; i < unit.get_woice()->get_voice_num(); ++i)
+    if (unit.get_tone(i)->life_count > 0) return false;
+  return true;
+}
+
+PreviewMixer::Voice PreviewMixer::startVoice(pxtnUnitTone &unit) {
+  // Generations only go up, so the lowest is the oldest.
+  int free = -1, quiet = -1, oldest = 0;
+  for (int i = 0; i < MAX_VOICES; ++i) {
+    Slot &s = m_slots[i];
+    if (!s.unit.has_value()) {
+      if (free == -1 || s.generation < m_slots[free].generation) free = i;
+      continue;
+    }
+    if (isQuiet(s.unit.value()) &&
+        (quiet == -1 || s.generation < m_slots[quiet].generation))
+      quiet = i;
+    if (s.generation < m_slots[oldest].generation) oldest = i;
+  }
+  int slot = (free != -1 ? free : quiet != -1 ? quiet : oldest);
+
+  Slot &s = m_slots[slot];
+  if (s.unit.has_value())
+    std::swap(s.unit.value(), unit);
+  else
+    s.unit.emplace(std::move(unit));
+  s.generation = m_next_generation++;
+  updateMixing();
+  return Voice{slot, s.generation};
+}
+
+void PreviewMixer::stopVoice(const Voice &voice) {
+  if (!this->voice(voice)) return;
+  m_slots[voice.slot].unit.reset();
+  updateMixing();
+}
+
+pxtnUnitTone *PreviewMixer::voice(const Voice &voice) {
+  Slot &s = m_slots[voice.slot];
+  if (s.generation != voice.generation || !s.unit.has_value()) return nullptr;
+  return &s.unit.value();
+}
+
+int PreviewMixer::addUnit(pxtnUnitTone *unit) {
+  int unit_id = m_next_unit_id++;
+  m_unit_ids.push_back(unit_id);
+  m_units.push_back(unit);
+  updateMixing();
+  return unit_id;
+}
+
+void PreviewMixer::removeUnit(int unit_id) {
+  for (size_t i = 0; i < m_unit_ids.size(); ++i) {
+    if (m_unit_ids[i] != unit_id) continue;
+    m_unit_ids.erase(m_unit_ids.begin() + i);
+    m_units.erase(m_units.begin() + i);
+    updateMixing();
+    return;
+  }
+}
+
+std::unique_ptr<mooState> PreviewMixer::takeMooState() {
+  std::lock_guard<std::mutex> lock(m_pool_mutex);
+  if (m_moo_state_pool.empty()) return std::make_unique<mooState>();
+  std::unique_ptr<mooState> state = std::move(m_moo_state_pool.back());
+  m_moo_state_pool.pop_back();
+  return state;
+}
+
+void PreviewMixer::returnMooState(std::unique_ptr<mooState> state) {
+  // Keeps the units' capacity but lets go of their woices.
+  state->units.clear();
+  std::lock_guard<std::mutex> lock(m_pool_mutex);
+  m_moo_state_pool.push_back(std::move(state));
+}
+
+// Doesn't allocate unless there are more added units than ever before.
+void PreviewMixer::updateMixing() {
+  m_mixing.clear();
+  for (Slot &s : m_slots)
+    if (s.unit.has_value()) m_mixing.push_back(&s.unit.value());
+  m_mixing.insert(m_mixing.end(), m_units.begin(), m_units.end());
+}
+
+void PreviewMixer::mix(char *data, qint64 len) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_mixing.empty()) return;
+  m_pxtn->moo_tone_sample_multi(m_mixing, *m_moo_params, data, len,
+                                &m_time_pan_index);
+}
@@ -0,0 +1,73 @@
+#ifndef PREVIEWMIXER_H
+#define PREVIEWMIXER_H
+#include <QtGlobal>
+#include <array>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "pxtone/pxtnService.h"
+#include "pxtone/pxtnWoice.h"
+
+/* Mixes note previews into the song's output as it's handed to the audio
+ * device, so previews share its stream and are sample-aligned with playback.
+ * They're added after the render-ahead ring, so they only wait on the
+ * device's own buffer.
+ *
+ * Single notes play on a fixed pool of voices, so that auditioning notes
+ * quickly doesn't allocate. Previews are set up before taking mutex(), so
+ * the audio device only ever waits on them being swapped in. Everything but
+ * mix() and the moo state pool has to be called with mutex() held.
+ */
+class PreviewMixer {
+ public:
+  static constexpr int MAX_VOICES = 16;
+  // A voice from the pool. The generation tells it apart from later notes
+  // that steal its slot.
+  struct Voice {
+    int slot;
+    quint64 generation;
+  };
+
+  PreviewMixer(const pxtnService *pxtn, const mooParams *moo_params);
+  std::mutex &mutex() { return m_mutex; }
+  // Starts a voice playing [unit], already set up, by swapping it into a
+  // slot. If they're all in use, steals the oldest, preferring ones that have
+  // gone quiet. [unit] is left with whatever was in the slot.
+  Voice startVoice(pxtnUnitTone &unit);
+  void stopVoice(const Voice &voice);
+  // Null once [voice] has been stopped or stolen.
+  pxtnUnitTone *voice(const Voice &voice);
+  // Units owned by someone else, e.g. a chord preview's moo state.
+  int addUnit(pxtnUnitTone *unit);
+  void removeUnit(int unit_id);
+  // A moo state for a chord preview, reused from earlier ones when there is
+  // one. Doesn't need mutex().
+  std::unique_ptr<mooState> takeMooState();
+  void returnMooState(std::unique_ptr<mooState> state);
+  // Adds the previews into [len] bytes of output at [data].
+  void mix(char *data, qint64 len);
+
+ private:
+  struct Slot {
+    std::optional<pxtnUnitTone> unit;
+    quint64 generation;
+  };
+  void updateMixing();
+  std::mutex m_mutex;
+  std::array<Slot, MAX_VOICES> m_slots;
+  quint64 m_next_generation;
+  std::vector<int> m_unit_ids;
+  std::vector<pxtnUnitTone *> m_units;
+  // What mix() plays: the voices in use, then the added units.
+  std::vector<pxtnUnitTone *> m_mixing;
+  const pxtnService *m_pxtn;
+  const mooParams *m_moo_params;
+  int m_next_unit_id;
+  int32_t m_time_pan_index;
+  std::mutex m_pool_mutex;
+  std::vector<std::unique_ptr<mooState>> m_moo_state_pool;
+};
+
+#endif  // PREVIEWMIXER_H
@@ -1,29 +1,115 @@
 #include "PxtoneIODevice.h"
 
-#include <QDebug>
+// Enough that a render chunk or two always fits, even with a tiny buffer.
+constexpr qint64 MIN_RING_BYTES = 16384;
+// How many times its starting size the fill can grow to.
+constexpr qint64 MAX_FILL_GROWTH = 4;
+// How much playback has to go by without running low before the fill
+// shrinks. About 10s.
+constexpr qint64 SHRINK_AFTER_BYTES = 10 * 44100 * 4;
 
 PxtoneIODevice::PxtoneIODevice(QObject *parent, const pxtnService *pxtn,
-                               mooState *moo_state)
-    : QIODevice(parent), pxtn(pxtn), moo_state(moo_state), m_playing(false) {}
+                               mooState *moo_state,
+                               std::recursive_mutex *engine_mutex)
+    : QIODevice(parent),
+      m_engine_mutex(engine_mutex),
+      m_playing(false),
+      m_flush(false),
+      m_primed(false),
+      m_underruns(0),
+      m_fill_target(MIN_RING_BYTES),
+      m_low_water(MIN_RING_BYTES),
+      m_healthy_bytes(0),
+      m_ring(MIN_RING_BYTES),
+      m_render_thread(
+          new MooRenderThread(pxtn, moo_state, engine_mutex, &m_ring, this)),
+      m_previews(std::make_shared<PreviewMixer>(pxtn, &moo_state->params)) {
+  connect(m_render_thread, &MooRenderThread::mooError, this,
+          &PxtoneIODevice::MooError);
+  m_render_thread->start(QThread::TimeCriticalPriority);
+}
+
+// Stop rendering before the ring goes away.
+PxtoneIODevice::~PxtoneIODevice() { delete m_render_thread; }
 
 void PxtoneIODevice::setPlaying(bool playing) {
   bool changed = playing != m_playing;
+  if (changed) m_primed = false;
   m_playing = playing;
+  m_render_thread->setPlaying(playing);
   if (changed) emit playingChanged(playing);
 }
 
 bool PxtoneIODevice::playing() { return m_playing; }
 
+// The output pulls up to about half its buffer at a time, so the fill starts
+// out at that much. Any more would just add latency. The ring leaves room for
+// it to grow without reallocating.
+void PxtoneIODevice::setBufferSize(qint64 bytes) {
+  std::lock_guard<std::recursive_mutex> lock(*m_engine_mutex);
+  qint64 fill = std::max(bytes / 2, MIN_RING_BYTES);
+  m_ring.resize(fill * MAX_FILL_GROWTH);
+  setFillTarget(fill);
+  m_flush = false;
+}
+
+void PxtoneIODevice::setFillTarget(qint64 bytes) {
+  bytes -= bytes % 4;
+  m_fill_target = bytes;
+  m_low_water = bytes;
+  m_healthy_bytes = 0;
+  m_render_thread->setFillTarget(bytes);
+}
+
+// Grows the fill quickly when the output runs dry, and shrinks it slowly once
+// it's had plenty to spare for a while, so latency stays low.
+void PxtoneIODevice::adaptFill(bool underrun, qint64 read) {
+  qint64 fill = m_fill_target;
+  if (underrun) {
+    ++m_underruns;
+    setFillTarget(std::min(fill * 2, qint64(m_ring.capacity())));
+    return;
+  }
+  m_low_water = std::min(m_low_water, qint64(m_ring.readable()));
+  m_healthy_bytes += read;
+  if (m_healthy_bytes < SHRINK_AFTER_BYTES) return;
+  // The ring never got close to empty, so some of the fill was only latency.
+  if (m_low_water > fill / 2)
+    setFillTarget(std::max(fill * 3 / 4, MIN_RING_BYTES));
+  else
+    setFillTarget(fill);
+}
+
+void PxtoneIODevice::flush() { m_flush = true; }
+
+qint64 PxtoneIODevice::bytesBuffered() const { return m_ring.readable(); }
+
+PlaybackProfile PxtoneIODevice::takeProfile() {
+  return PlaybackProfile{m_render_thread->takeProfile(),
+                         m_underruns.exchange(0), m_fill_target};
+}
+
 qint64 PxtoneIODevice::readData(char *data, qint64 maxlen) {
+  // Keep to whole frames so the stream stays aligned.
+  maxlen -= maxlen % 4;
+  if (m_flush.exchange(false)) {
+    m_ring.clear();
+    m_primed = false;
+  }
+  qint64 len = 0;
   if (m_playing) {
-    int32_t filled_len = 0;
-    if (!pxtn->Moo(*moo_state, data, int32_t(maxlen), &filled_len))
-      emit MooError();
-    return filled_len;
-  } else {
+    len = m_ring.read(data, maxlen);
+    m_render_thread->wake();
+    adaptFill(len < maxlen && m_primed, len);
+    if (len > 0) m_primed = true;
+  }
+  // Play silence on an underrun rather than let the output go idle.
+  if (len == 0) {
     memset(data, 0, maxlen);
-    return maxlen;
+    len = maxlen;
   }
+  m_previews->mix(data, len);
+  return len;
 }
 qint64 PxtoneIODevice::writeData(const char *data, qint64 len) {
   (void)data;
@@ -2,28 +2,74 @@
 #define PXTONEIODEVICE_H
 
 #include <QIODevice>
+#include <atomic>
+#include <memory>
+#include <mutex>
 
+#include "AudioRing.h"
+#include "MooRenderThread.h"
+#include "PreviewMixer.h"
 #include "pxtone/pxtnService.h"
 
+// What playback has cost since it was last taken.
+struct PlaybackProfile {
+  pxtnMooProfile moo;
+  // Times the output read faster than the moo could keep up.
+  int underruns;
+  qint64 fill_target;
+};
+
 /**
  * @brief A pxtnService wrapper for QTAudioOutput.
+ *
+ * The moo runs ahead on a render thread, so reads only copy what it's left in
+ * a ring buffer and never wait on the engine. Note previews are mixed in on
+ * top as the output reads.
  */
 class PxtoneIODevice : public QIODevice {
   Q_OBJECT
  public:
-  PxtoneIODevice(QObject *parent, const pxtnService *pxtn, mooState *moo_state);
-  virtual ~PxtoneIODevice(){};
+  PxtoneIODevice(QObject *parent, const pxtnService *pxtn, mooState *moo_state,
+                 std::recursive_mutex *engine_mutex);
+  virtual ~PxtoneIODevice();
   void setPlaying(bool playing);
   bool playing();
+  // Sizes the ring to suit an output buffer of [bytes]. Don't call while the
+  // output's reading.
+  void setBufferSize(qint64 bytes);
+  // Drops what's been rendered but not read yet, e.g. after a seek.
+  void flush();
+  // How far the moo is ahead of what's been read.
+  qint64 bytesBuffered() const;
+  // How far the moo's kept ahead of the output at the moment. It grows when
+  // the output runs dry and shrinks back when there's a lot to spare.
+  qint64 fillTarget() const { return m_fill_target; }
+  // Shared, since previews can outlive the device when the window closes.
+  std::shared_ptr<PreviewMixer> previewMixer() { return m_previews; }
+  PlaybackProfile takeProfile();
 
  signals:
   void MooError();
   void playingChanged(bool);
 
  private:
-  const pxtnService *pxtn;
-  mooState *moo_state;
+  std::recursive_mutex *m_engine_mutex;
   bool m_playing;
+  std::atomic<bool> m_flush;
+  // Whether the ring's had anything since playing or flushing. Running dry
+  // before then is just the moo getting started.
+  std::atomic<bool> m_primed;
+  std::atomic<int> m_underruns;
+  std::atomic<qint64> m_fill_target;
+  // The reader's record of how low the ring got since the fill last changed,
+  // and over how much playback.
+  qint64 m_low_water;
+  qint64 m_healthy_bytes;
+  AudioRing m_ring;
+  MooRenderThread *m_render_thread;
+  std::shared_ptr<PreviewMixer> m_previews;
+  void setFillTarget(qint64 bytes);
+  void adaptFill(bool underrun, qint64 read);
   qint64 readData(char *data, qint64 maxlen);
   qint64 writeData(const char *data, qint64 len);
 };
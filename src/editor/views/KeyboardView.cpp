@@ -11,7 +11,6 @@
 #include "ViewHelper.h"
 #include "editor/ComboOptions.h"
 #include "editor/Settings.h"
-#include "editor/audio/PxtoneUnitIODevice.h"
 
 void LocalEditState::update(const pxtnService *pxtn, const EditState &s) {
   // TODO: dedup from pxtoneClient. maybe
@@ -653,7 +652,7 @@ void KeyboardView::mousePressEvent(QMouseEvent *event) {
 
             m_audio_note_preview = std::make_unique<NotePreview>(
                 m_pxtn, &m_client->moo()->params, unit_no, clock, pitch, vel,
-                m_client->audioState()->bufferSize(), this);
+                m_client->previewMixer(), this);
           }
         }
       },
@@ -753,7 +752,7 @@ void KeyboardView::transposeSelection(Direction dir, bool wide, bool shift) {
     Interval interval(m_client->editState().mouse_edit_state.selection.value());
 
     using namespace Action;
-    std::list<Primitive> as;
+    std::vector<Primitive> as;
     for (qint32 unitNo : selectedUnitNos()) {
       qint32 unit = m_client->unitIdMap().noToId(unitNo);
       if (kind != EVENTKIND_VELOCITY) {
@@ -798,7 +797,7 @@ void KeyboardView::mouseReleaseEvent(QMouseEvent *event) {
       [&](auto &s) {
         if (m_pxtn->Unit_Num() > 0) {
           using namespace Action;
-          std::list<Primitive> actions;
+          std::vector<Primitive> actions;
           switch (s.mouse_edit_state.type) {
             case MouseEditState::SetOn:
             case MouseEditState::DeleteOn:
@@ -881,7 +880,7 @@ void KeyboardView::copySelection() {
 
 void KeyboardView::clearSelection() {
   if (!m_client->editState().mouse_edit_state.selection.has_value()) return;
-  std::list<Action::Primitive> actions = m_client->clipboard()->makeClear(
+  std::vector<Action::Primitive> actions = m_client->clipboard()->makeClear(
       selectedUnitNos(),
       m_client->editState().mouse_edit_state.selection.value(),
       m_client->unitIdMap());
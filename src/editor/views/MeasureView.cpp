@@ -358,8 +358,8 @@ void MeasureView::mousePressEvent(QMouseEvent *event) {
             if (unit_no.has_value()) {
               m_audio_note_preview = std::make_unique<NotePreview>(
                   m_client->pxtn(), &m_client->moo()->params, unit_no.value(),
-                  clock, std::list<EVERECORD>(),
-                  m_client->audioState()->bufferSize(), this);
+                  clock, std::list<EVERECORD>(), m_client->previewMixer(),
+                  this);
               s.mouse_edit_state.base_velocity =
                   m_client->pxtn()->evels->get_Value(clock, unit_no.value(),
                                                      EVENTKIND_VELOCITY);
@@ -385,7 +385,7 @@ void MeasureView::mouseReleaseEvent(QMouseEvent *event) {
       [&](EditState &s) {
         if (m_client->pxtn()->Unit_Num() > 0) {
           using namespace Action;
-          std::list<Primitive> actions;
+          std::vector<Primitive> actions;
           Interval clock_int(m_client->editState().mouse_edit_state.clock_int(
               m_client->quantizeClock()));
           switch (s.mouse_edit_state.type) {
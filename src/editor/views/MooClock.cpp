@@ -25,7 +25,8 @@ int MooClock::repeat_clock() const {
 }
 
 int MooClock::now() {
-  int clock = m_client->pxtn()->moo_get_now_clock(*m_client->moo());
+  PxtoneController::MooPosition position = m_client->mooPosition();
+  int clock = position.clock;
 
   // Some really hacky magic to get the playhead smoother given that
   // there's a ton of buffering that makes it hard to actually tell where the
@@ -41,22 +42,19 @@ int MooClock::now() {
   // 5. The tracking if we've looped or not is also necessary to tell if we've
   // actually caught up to a seek.
 
-  int bytes_per_second = 4 * 44100;  // bytes in sample * bytes per second
   if (m_prev_clock != clock) {
     m_prev_clock = clock;
     timeSinceLastClock.restart();
   }
 
-  int64_t offset_from_buffer =
-      m_client->audioState()->bufferSize();  // - m_audio_output->bytesFree()
-
-  double estimated_buffer_offset =
-      -offset_from_buffer / double(bytes_per_second);
+  // The moo runs ahead of the output by what's queued in the device and
+  // what's rendered ahead of it, which changes as the buffering adapts.
+  double estimated_buffer_offset = -m_client->outputLatency();
   if (!m_client->isPlaying())
     timeSinceLastClock.restart();
   else
     estimated_buffer_offset += timeSinceLastClock.elapsed() / 1000.0;
-  clock += (last_clock() - repeat_clock()) * m_client->moo()->num_loop;
+  clock += (last_clock() - repeat_clock()) * position.num_loop;
 
   const pxtnMaster *master = m_client->pxtn()->master;
   clock += std::min(estimated_buffer_offset, 0.0) * master->get_beat_tempo() *
@@ -70,7 +68,7 @@ int MooClock::now() {
             repeat_clock();
   // Because of offsetting it might seem like even though we've repeated the
   // clock is before [repeat_clock]. So fix it here.
-  if (m_client->moo()->num_loop > 0 && clock < repeat_clock())
+  if (position.num_loop > 0 && clock < repeat_clock())
     clock += last_clock() - repeat_clock();
 
   return clock;
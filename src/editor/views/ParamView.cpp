@@ -15,7 +15,8 @@ ParamView::ParamView(PxtoneClient *client, MooClock *moo_clock, QWidget *parent)
       m_moo_clock(moo_clock),
       m_audio_note_preview(nullptr),
       m_woice_menu(new QMenu(this)),
-      m_last_woice_menu_preview_id(-1) {
+      m_last_woice_menu_preview_id(-1),
+      m_cached_kind(EVENTKIND_NULL) {
   setFocusPolicy(Qt::StrongFocus);
   setSizePolicy(QSizePolicy::MinimumExpanding, QSizePolicy::MinimumExpanding);
   updateGeometry();
@@ -28,6 +29,16 @@ ParamView::ParamView(PxtoneClient *client, MooClock *moo_clock, QWidget *parent)
           });
   connect(m_client->controller(), &PxtoneController::measureNumChanged, this,
           &QWidget::updateGeometry);
+  connect(m_client->controller(), &PxtoneController::eventsEdited,
+          [this](const std::set<qint32> &unit_ids) {
+            m_dirty_units.insert(unit_ids.begin(), unit_ids.end());
+          });
+  // These change events outside of edit actions, or change which units exist.
+  for (auto signal :
+       {&PxtoneController::endRefresh, &PxtoneController::endAddUnit,
+        &PxtoneController::endRemoveUnit, &PxtoneController::endRemoveWoice})
+    connect(m_client->controller(), signal,
+            [this]() { m_event_cache.clear(); });
   connect(m_woice_menu, &QMenu::hovered, [this](QAction *action) {
     bool ok = true;
     int id = action->data().toInt(&ok);
@@ -54,8 +65,7 @@ ParamView::ParamView(PxtoneClient *client, MooClock *moo_clock, QWidget *parent)
       m_audio_note_preview = std::make_unique<NotePreview>(
           m_client->pxtn(), &m_client->moo()->params, maybe_unit_no.value(),
           m_client->editState().mouse_edit_state.start_clock, 48000,
-          std::list<EVERECORD>({e}), m_client->audioState()->bufferSize(),
-          this);
+          std::list<EVERECORD>({e}), m_client->previewMixer(), this);
     }
   });
 }
@@ -165,15 +175,12 @@ constexpr int NUM_BACKGROUND_GAPS =
     sizeof(BACKGROUND_GAPS) / sizeof(BACKGROUND_GAPS[0]);
 constexpr int arbitrarily_tall = 1000;
 
-struct Event {
-  int clock, value;
-};
-
 constexpr int32_t lineHeight = 4;
 constexpr int32_t lineWidth = 2;
 constexpr int32_t tailRowHeight = 8;
 static void drawLastVoiceNoEvent(QPainter &painter, int height,
-                                 const Event &last, const Event &curr,
+                                 const ParamEvent &last,
+                                 const ParamEvent &curr,
                                  qreal clockPerPx, const QColor &onColor,
                                  const pxtnService *pxtn) {
   int32_t lastX = last.clock / clockPerPx;
@@ -195,8 +202,44 @@ static void drawLastVoiceNoEvent(QPainter &painter, int height,
         shift_jis_codec->toUnicode(woice->get_name_buf_jis(nullptr)));
   }
 }
-static void drawLastEvent(QPainter &painter, EVENTKIND current_kind, int height,
-                          const Event &last, const Event &curr,
+// The lines making up one unit's param curve, collected so that they can be
+// drawn with a few drawLines calls rather than a fillRect per event.
+struct ParamCurve {
+  QVector<QLine> horizontal, vertical, highlight;
+
+  void add(int lastX, int lastY, int thisX, int thisY) {
+    // Horizontal line to thisX
+    if (thisX > lastX + lineWidth)
+      horizontal.append(QLine(lastX + lineWidth, lastY, thisX, lastY));
+    // Vertical line to thisY
+    vertical.append(QLine(thisX + lineWidth / 2,
+                          std::min(lastY, thisY) - lineHeight / 2,
+                          thisX + lineWidth / 2,
+                          std::max(lastY, thisY) + lineHeight / 2));
+    // Highlight at lastX
+    highlight.append(QLine(lastX + lineWidth / 2, lastY - lineHeight / 2,
+                           lastX + lineWidth / 2, lastY + lineHeight / 2));
+  }
+
+  void draw(QPainter &painter, const QColor &onColor, bool withHighlight) {
+    painter.setPen(QPen(onColor, lineHeight, Qt::SolidLine, Qt::FlatCap));
+    painter.drawLines(horizontal);
+    painter.setPen(QPen(onColor, lineWidth, Qt::SolidLine, Qt::FlatCap));
+    painter.drawLines(vertical);
+    if (withHighlight) {
+      QColor fadedWhite = QColor::fromRgb(255, 255, 255, onColor.alpha());
+      painter.setPen(QPen(fadedWhite, lineWidth, Qt::SolidLine, Qt::FlatCap));
+      painter.drawLines(highlight);
+    }
+    horizontal.clear();
+    vertical.clear();
+    highlight.clear();
+  }
+};
+
+static void drawLastEvent(QPainter &painter, ParamCurve &curve,
+                          EVENTKIND current_kind, int height,
+                          const ParamEvent &last, const ParamEvent &curr,
                           qreal clockPerPx, const QColor &onColor,
                           int unitOffset, int numUnits) {
   if (onColor.alpha() == 0) return;
@@ -206,19 +249,10 @@ static void drawLastEvent(QPainter &painter, EVENTKIND current_kind, int height,
     int32_t thisY = paramToY(curr.value, current_kind, height);
     int32_t lastX = last.clock / clockPerPx;
     int32_t lastY = paramToY(last.value, current_kind, height);
-    // Horizontal line to thisX
-    painter.fillRect(lastX + lineWidth, lastY - lineHeight / 2,
-                     thisX - lastX - lineWidth, lineHeight, onColor);
-    // Vertical line to thisY
-    painter.fillRect(
-        thisX, std::min(lastY, thisY) - lineHeight / 2, lineWidth,
-        std::max(lastY, thisY) - std::min(lastY, thisY) + lineHeight, onColor);
+    curve.add(lastX, lastY, thisX, thisY);
     if (unitOffset == 0) {
-      // Highlight at lastX
-      QColor fadedWhite = QColor::fromRgb(255, 255, 255, onColor.alpha());
-      painter.fillRect(lastX, lastY - lineHeight / 2, lineWidth, lineHeight,
-                       fadedWhite);
       if (current_kind == EVENTKIND_GROUPNO) {
+        QColor fadedWhite = QColor::fromRgb(255, 255, 255, onColor.alpha());
         painter.setPen(fadedWhite);
         painter.setFont(QFont("Sans serif", TextSize::get()));
         painter.drawText(lastX + lineWidth + 1, lastY, arbitrarily_tall,
@@ -282,6 +316,41 @@ static void drawOngoingEdit(QPainter &painter, const MouseEditState &state,
     } break;
   }
 }
+void ParamView::refreshEventCache(EVENTKIND kind) {
+  const pxtnService *pxtn = m_client->pxtn();
+  if (kind != m_cached_kind) {
+    m_event_cache.clear();
+    m_cached_kind = kind;
+  }
+
+  int unit_num = pxtn->Unit_Num();
+  std::vector<UnitEvents *> to_rebuild(unit_num, nullptr);
+  bool need_rebuild = false;
+  for (int i = 0; i < unit_num; ++i) {
+    int unit_id = m_client->unitIdMap().noToId(i);
+    auto it = m_event_cache.find(unit_id);
+    if (it != m_event_cache.end() && m_dirty_units.count(unit_id) == 0)
+      continue;
+    UnitEvents &unit_events = m_event_cache[unit_id];
+    unit_events.events.clear();
+    unit_events.max_tail = 0;
+    to_rebuild[i] = &unit_events;
+    need_rebuild = true;
+  }
+  m_dirty_units.clear();
+  if (!need_rebuild) return;
+
+  for (const EVERECORD *e = pxtn->evels->get_Records(); e != nullptr;
+       e = e->next) {
+    if (e->kind != kind || e->unit_no >= unit_num) continue;
+    UnitEvents *unit_events = to_rebuild[e->unit_no];
+    if (unit_events == nullptr) continue;
+    unit_events->events.push_back({e->clock, e->value});
+    if (Evelist_Kind_IsTail(kind))
+      unit_events->max_tail = std::max(unit_events->max_tail, e->value);
+  }
+}
+
 void ParamView::paintEvent(QPaintEvent *event) {
   const pxtnService *pxtn = m_client->pxtn();
   Interval clockBounds = {
@@ -325,13 +394,10 @@ void ParamView::paintEvent(QPaintEvent *event) {
   {
     thisUnitPainter.translate(-event->rect().topLeft());
     std::vector<QColor> colors;
-    std::vector<Event> lastEvents;
     std::vector<QPainter *> painters;
     colors.reserve(m_client->pxtn()->Unit_Num());
     painters.reserve(m_client->pxtn()->Unit_Num());
-    lastEvents.reserve(m_client->pxtn()->Unit_Num());
     for (int i = 0; i < m_client->pxtn()->Unit_Num(); ++i) {
-      lastEvents.emplace_back(Event{-1000, DefaultKindValue(current_kind)});
       int unit_id = m_client->unitIdMap().noToId(i);
       colors.push_back(
           brushes[nonnegative_modulo(unit_id, NUM_BRUSHES)].toQColor(108, false,
@@ -351,34 +417,46 @@ void ParamView::paintEvent(QPaintEvent *event) {
       colors.rbegin()->setHsl(h, s, l * 3 / 4, a);
     }
 
-    for (const EVERECORD *e = pxtn->evels->get_Records(); e != nullptr;
-         e = e->next) {
-      if (e->clock > clockBounds.end) break;
-      if (e->kind != current_kind) continue;
-      int unit_no = e->unit_no;
-
-      Event curr{e->clock, e->value};
-      if (current_kind != EVENTKIND_VOICENO)
-        drawLastEvent(*painters[unit_no], current_kind, height(),
-                      lastEvents[unit_no], curr, clockPerPx, colors[unit_no],
-                      unit_no - current_unit_no, m_client->pxtn()->Unit_Num());
-      else if (unit_no == current_unit_no)
-        drawLastVoiceNoEvent(*painters[unit_no], height(), lastEvents[unit_no],
-                             curr, clockPerPx, colors[unit_no],
-                             m_client->pxtn());
-      lastEvents[unit_no] = curr;
-    }
-    for (int unit_no = 0; unit_no < m_client->pxtn()->Unit_Num(); ++unit_no) {
-      Event curr = lastEvents[unit_no];
+    refreshEventCache(current_kind);
+    ParamCurve curve;
+    int unit_num = m_client->pxtn()->Unit_Num();
+    for (int unit_no = 0; unit_no < unit_num; ++unit_no) {
+      if (current_kind == EVENTKIND_VOICENO ? unit_no != current_unit_no
+                                            : colors[unit_no].alpha() == 0)
+        continue;
+      const UnitEvents &unit_events =
+          m_event_cache[m_client->unitIdMap().noToId(unit_no)];
+      const std::vector<ParamEvent> &events = unit_events.events;
+
+      // Only walk the events that could show up on screen. A param line
+      // extends from the event before the window, and a tail from as far
+      // back as the longest tail.
+      qint32 start_clock = clockBounds.start - unit_events.max_tail;
+      auto it = std::lower_bound(events.begin(), events.end(), start_clock,
+                                 [](const ParamEvent &e, qint32 clock) {
+                                   return e.clock < clock;
+                                 });
+      ParamEvent last = (it == events.begin()
+                             ? ParamEvent{-1000, DefaultKindValue(current_kind)}
+                             : *(it - 1));
+      auto drawEvent = [&](const ParamEvent &curr) {
+        if (current_kind != EVENTKIND_VOICENO)
+          drawLastEvent(*painters[unit_no], curve, current_kind, height(),
+                        last, curr, clockPerPx, colors[unit_no],
+                        unit_no - current_unit_no, unit_num);
+        else
+          drawLastVoiceNoEvent(*painters[unit_no], height(), last, curr,
+                               clockPerPx, colors[unit_no], m_client->pxtn());
+      };
+      for (; it != events.end() && it->clock <= clockBounds.end; ++it) {
+        drawEvent(*it);
+        last = *it;
+      }
+      ParamEvent curr = last;
       curr.clock = (width() + 50) * clockPerPx;
-      if (current_kind != EVENTKIND_VOICENO)
-        drawLastEvent(*painters[unit_no], current_kind, height(),
-                      lastEvents[unit_no], curr, clockPerPx, colors[unit_no],
-                      unit_no - current_unit_no, m_client->pxtn()->Unit_Num());
-      else if (unit_no == current_unit_no)
-        drawLastVoiceNoEvent(*painters[unit_no], height(), lastEvents[unit_no],
-                             curr, clockPerPx, colors[unit_no],
-                             m_client->pxtn());
+      drawEvent(curr);
+      curve.draw(*painters[unit_no], colors[unit_no],
+                 unit_no == current_unit_no);
     }
   }
 
@@ -517,8 +595,7 @@ void ParamView::mousePressEvent(QMouseEvent *event) {
                                     m_client->quantizeClock());
             m_audio_note_preview = std::make_unique<NotePreview>(
                 m_client->pxtn(), &m_client->moo()->params, unit_no, clock,
-                std::list<EVERECORD>({e}), m_client->audioState()->bufferSize(),
-                this);
+                std::list<EVERECORD>({e}), m_client->previewMixer(), this);
           }
         }
       },
@@ -527,7 +604,7 @@ void ParamView::mousePressEvent(QMouseEvent *event) {
 
 static void setVelInRange(const EVERECORD *&p, int32_t unit_no, qint32 unit_id,
                           const ParamEditInterval &interval,
-                          std::list<Action::Primitive> &actions) {
+                          std::vector<Action::Primitive> &actions) {
   using namespace Action;
   while (p && p->prev && p->prev->clock >= interval.clock.start) p = p->prev;
   while (p && p->clock < interval.clock.start) p = p->next;
@@ -559,7 +636,7 @@ void ParamView::mouseReleaseEvent(QMouseEvent *event) {
       [&](EditState &s) {
         if (m_client->pxtn()->Unit_Num() > 0) {
           using namespace Action;
-          std::list<Primitive> actions;
+          std::vector<Primitive> actions;
           switch (s.mouse_edit_state.type) {
             case MouseEditState::SetOn:
             case MouseEditState::DeleteOn:
@@ -3,15 +3,31 @@
 
 #include <QMenu>
 #include <QWidget>
+#include <map>
+#include <set>
 
 #include "Animation.h"
 #include "MooClock.h"
 #include "editor/PxtoneClient.h"
 #include "editor/audio/NotePreview.h"
 
+struct ParamEvent {
+  int clock, value;
+};
+
 class ParamView : public QWidget {
   Q_OBJECT
 
+  // Events of the displayed param kind for each unit, keyed by unit ID, so
+  // that painting doesn't have to walk the whole event list every frame. Only
+  // units touched by an edit are rebuilt.
+  struct UnitEvents {
+    std::vector<ParamEvent> events;
+    // Longest tail, so that tail kinds know how far back a visible event can
+    // start.
+    int max_tail;
+  };
+
   PxtoneClient *m_client;
   Animation *m_anim;
   Scale m_last_scale;
@@ -20,6 +36,11 @@ class ParamView : public QWidget {
   QMenu *m_woice_menu;
   int m_last_woice_menu_preview_id;
   QElapsedTimer m_last_woice_menu_preview_time;
+  EVENTKIND m_cached_kind;
+  std::map<int, UnitEvents> m_event_cache;
+  std::set<int> m_dirty_units;
+
+  void refreshEventCache(EVENTKIND kind);
 
   void paintEvent(QPaintEvent *event) override;
   void mousePressEvent(QMouseEvent *event) override;
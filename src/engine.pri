@@ -0,0 +1,68 @@
+# The pxtone engine and offline rendering, shared by the editor and
+# ptcollab-render.
+INCLUDEPATH += $$PWD
+
+DEFINES += pxINCLUDE_OGGVORBIS
+
+HEADERS += \
+           $$PWD/pxtone/pxtn.h \
+           $$PWD/pxtone/pxtnDelay.h \
+           $$PWD/pxtone/pxtnDescriptor.h \
+           $$PWD/pxtone/pxtnError.h \
+           $$PWD/pxtone/pxtnEvelist.h \
+           $$PWD/pxtone/pxtnMaster.h \
+           $$PWD/pxtone/pxtnMax.h \
+           $$PWD/pxtone/pxtnMem.h \
+           $$PWD/pxtone/pxtnOverDrive.h \
+           $$PWD/pxtone/pxtnPulse_Frequency.h \
+           $$PWD/pxtone/pxtnPulse_Noise.h \
+           $$PWD/pxtone/pxtnPulse_NoiseBuilder.h \
+           $$PWD/pxtone/pxtnPulse_Oggv.h \
+           $$PWD/pxtone/pxtnPulse_Oscillator.h \
+           $$PWD/pxtone/pxtnPulse_PCM.h \
+           $$PWD/pxtone/pxtnService.h \
+           $$PWD/pxtone/pxtnText.h \
+           $$PWD/pxtone/pxtnUnit.h \
+           $$PWD/pxtone/pxtnWoice.h \
+           $$PWD/pxtone/pxtoneNoise.h \
+           $$PWD/render/AudioEncoder.h \
+           $$PWD/render/FlacEncoder.h \
+           $$PWD/render/RenderJob.h \
+           $$PWD/render/Renderer.h \
+           $$PWD/render/VorbisEncoder.h \
+           $$PWD/render/WavEncoder.h
+
+SOURCES += \
+           $$PWD/pxtone/pxtnDelay.cpp \
+           $$PWD/pxtone/pxtnDescriptor.cpp \
+           $$PWD/pxtone/pxtnError.cpp \
+           $$PWD/pxtone/pxtnEvelist.cpp \
+           $$PWD/pxtone/pxtnMaster.cpp \
+           $$PWD/pxtone/pxtnMem.cpp \
+           $$PWD/pxtone/pxtnOverDrive.cpp \
+           $$PWD/pxtone/pxtnPulse_Frequency.cpp \
+           $$PWD/pxtone/pxtnPulse_Noise.cpp \
+           $$PWD/pxtone/pxtnPulse_NoiseBuilder.cpp \
+           $$PWD/pxtone/pxtnPulse_Oggv.cpp \
+           $$PWD/pxtone/pxtnPulse_Oscillator.cpp \
+           $$PWD/pxtone/pxtnPulse_PCM.cpp \
+           $$PWD/pxtone/pxtnService.cpp \
+           $$PWD/pxtone/pxtnService_moo.cpp \
+           $$PWD/pxtone/pxtnText.cpp \
+           $$PWD/pxtone/pxtnUnit.cpp \
+           $$PWD/pxtone/pxtnWoice.cpp \
+           $$PWD/pxtone/pxtnWoice_io.cpp \
+           $$PWD/pxtone/pxtnWoicePTV.cpp \
+           $$PWD/pxtone/pxtoneNoise.cpp \
+           $$PWD/render/AudioEncoder.cpp \
+           $$PWD/render/FlacEncoder.cpp \
+           $$PWD/render/RenderJob.cpp \
+           $$PWD/render/Renderer.cpp \
+           $$PWD/render/VorbisEncoder.cpp \
+           $$PWD/render/WavEncoder.cpp
+
+# Ogg Vorbis rendering needs libvorbisenc, which deps/ doesn't have for Windows.
+!win32:DEFINES += pxINCLUDE_VORBISENC
+!win32:LIBS += -logg -lvorbisfile -lvorbisenc -lvorbis
+win32:LIBS += -L"$$PWD/../deps/lib" -L"$$PWD/deps/lib" -llibogg_static -llibvorbisfile
+macx:LIBS += -L/usr/local/lib
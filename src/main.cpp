@@ -77,6 +77,44 @@ int main(int argc, char *argv[]) {
       QCoreApplication::translate("main", "record"));
   parser.addOption(serverRecordOption);
 
+  QCommandLineOption journalOption(
+      QStringList() << "journal",
+      QCoreApplication::translate(
+          "main",
+          "Keep the session in <dir> and resume it from there on restart."),
+      QCoreApplication::translate("main", "dir"));
+  parser.addOption(journalOption);
+
+  QCommandLineOption roomsOption(
+      QStringList() << "rooms",
+      QCoreApplication::translate(
+          "main",
+          "Let a headless server host other projects, kept in <dir>, that "
+          "clients pick by name."),
+      QCoreApplication::translate("main", "dir"));
+  parser.addOption(roomsOption);
+
+  QCommandLineOption undoHorizonOption(
+      QStringList() << "undo-horizon",
+      QCoreApplication::translate(
+          "main", "Keep undo history for the last <actions> edits."),
+      QCoreApplication::translate("main", "actions"));
+  parser.addOption(undoHorizonOption);
+
+  QCommandLineOption playbackSpeedOption(
+      QStringList() << "playback-speed",
+      QCoreApplication::translate(
+          "main", "Play a headless server's recording at this speed."),
+      QCoreApplication::translate("main", "speed"));
+  parser.addOption(playbackSpeedOption);
+
+  QCommandLineOption playbackStartOption(
+      QStringList() << "playback-start",
+      QCoreApplication::translate(
+          "main", "Start a headless server's recording this far in."),
+      QCoreApplication::translate("main", "seconds"));
+  parser.addOption(playbackStartOption);
+
   QCommandLineOption headlessOption(
       QStringList() << "headless",
       QCoreApplication::translate("main", "Just run a server with no editor."));
@@ -129,19 +167,57 @@ int main(int argc, char *argv[]) {
   else
     recording_file = std::nullopt;
 
+  std::optional<QString> journal_dir = parser.value(journalOption);
+  if (journal_dir != "")
+    startServerImmediately = true;
+  else
+    journal_dir = std::nullopt;
+
+  int undo_horizon = UndoHorizon::get();
+  QString undoHorizonStr = parser.value(undoHorizonOption);
+  if (undoHorizonStr != "") {
+    bool ok;
+    undo_horizon = undoHorizonStr.toInt(&ok);
+    if (!ok || undo_horizon < 1) qFatal("Could not parse undo horizon");
+  }
+
+  double playback_speed = 1;
+  QString playbackSpeedStr = parser.value(playbackSpeedOption);
+  if (playbackSpeedStr != "") {
+    bool ok;
+    playback_speed = playbackSpeedStr.toDouble(&ok);
+    if (!ok || playback_speed <= 0) qFatal("Could not parse playback speed");
+  }
+
+  qint64 playback_start = 0;
+  QString playbackStartStr = parser.value(playbackStartOption);
+  if (playbackStartStr != "") {
+    bool ok;
+    playback_start = playbackStartStr.toDouble(&ok) * 1000;
+    if (!ok || playback_start < 0) qFatal("Could not parse playback start");
+  }
+
   QString username = parser.value(usernameOption);
   if (parser.value(usernameOption) != "")
     QSettings().setValue(DISPLAY_NAME_KEY, username);
   username = QSettings().value(DISPLAY_NAME_KEY).toString();
 
   if (parser.isSet(headlessOption)) {
-    BroadcastServer s(filename, host, port, recording_file);
+    BroadcastServer s(filename, host, port, recording_file, journal_dir,
+                      undo_horizon);
+    if (parser.value(roomsOption) != "")
+      s.setRoomsDirectory(parser.value(roomsOption));
+    if (s.isReadingHistory()) {
+      s.setPlaybackSpeed(playback_speed);
+      if (playback_start > 0) s.seekPlayback(playback_start);
+    }
     return a.exec();
   } else {
     EditorWindow w;
     w.show();
     if (startServerImmediately)
-      w.hostDirectly(filename, host, port, recording_file, username);
+      w.hostDirectly(filename, host, port, recording_file, username,
+                     journal_dir);
     return a.exec();
   }
 }
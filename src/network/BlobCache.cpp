@@ -0,0 +1,82 @@
+#include "BlobCache.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include "protocol/RemoteAction.h"
+
+BlobCache::BlobCache(const QString &dir, qint64 max_disk_bytes)
+    : m_dir(dir), m_max_disk_bytes(max_disk_bytes) {
+  if (!m_dir.isEmpty() && !QDir().mkpath(m_dir)) {
+    qWarning() << "Could not create blob cache" << m_dir;
+    m_dir.clear();
+  }
+}
+
+QString BlobCache::defaultDir() {
+  QString base =
+      QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  if (base.isEmpty()) return "";
+  return QDir(base).filePath("blobs");
+}
+
+QString BlobCache::path(const QByteArray &hash) const {
+  return QDir(m_dir).filePath(QString::fromLatin1(hash.toHex()));
+}
+
+std::optional<QByteArray> BlobCache::get(const QByteArray &hash) {
+  auto it = m_memory.find(hash);
+  if (it != m_memory.end()) return it.value();
+  if (m_dir.isEmpty()) return std::nullopt;
+
+  QFile file(path(hash));
+  if (!file.open(QIODevice::ReadOnly)) return std::nullopt;
+  QByteArray data = file.readAll();
+  if (blobHash(data) != hash) {
+    qWarning() << "Discarding corrupt cached blob" << file.fileName();
+    file.remove();
+    return std::nullopt;
+  }
+  // The modification time doubles as the last use, for eviction.
+  file.setFileTime(QDateTime::currentDateTime(),
+                   QFileDevice::FileModificationTime);
+  m_memory.insert(hash, data);
+  return data;
+}
+
+void BlobCache::insert(const QByteArray &hash, const QByteArray &data) {
+  if (m_memory.contains(hash)) return;
+  m_memory.insert(hash, data);
+  if (m_dir.isEmpty() || data.size() > m_max_disk_bytes) return;
+
+  QFile existing(path(hash));
+  if (existing.open(QIODevice::ReadOnly)) {
+    existing.setFileTime(QDateTime::currentDateTime(),
+                         QFileDevice::FileModificationTime);
+    return;
+  }
+  QSaveFile file(path(hash));
+  if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() ||
+      !file.commit()) {
+    qWarning() << "Could not cache blob" << file.fileName();
+    return;
+  }
+  evict();
+}
+
+// Removes the least recently used blobs until the disk cache fits.
+void BlobCache::evict() {
+  QFileInfoList files =
+      QDir(m_dir).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+  qint64 total = 0;
+  for (const QFileInfo &info : files) total += info.size();
+  for (const QFileInfo &info : files) {
+    if (total <= m_max_disk_bytes) break;
+    if (!QFile::remove(info.filePath())) continue;
+    total -= info.size();
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef BLOBCACHE_H
+#define BLOBCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <optional>
+
+// Woice data the client has seen, keyed by content hash. It's kept in memory
+// for the session and on disk across sessions, so that rejoining a session or
+// swapping back to an old sample doesn't mean downloading it again.
+class BlobCache {
+ public:
+  static constexpr qint64 DEFAULT_MAX_DISK_BYTES = 256 * 1024 * 1024;
+  // [dir] defaults to the user's cache location. An empty [dir] keeps
+  // everything in memory. On disk, the least recently used blobs are evicted
+  // to keep it under [max_disk_bytes].
+  BlobCache(const QString &dir = defaultDir(),
+            qint64 max_disk_bytes = DEFAULT_MAX_DISK_BYTES);
+  static QString defaultDir();
+
+  std::optional<QByteArray> get(const QByteArray &hash);
+  void insert(const QByteArray &hash, const QByteArray &data);
+
+ private:
+  QString path(const QByteArray &hash) const;
+  void evict();
+  QString m_dir;
+  qint64 m_max_disk_bytes;
+  QHash<QByteArray, QByteArray> m_memory;
+};
+
+#endif  // BLOBCACHE_H
@@ -1,50 +1,51 @@
 #ifndef SEQUENCINGSERVER_H
 #define SEQUENCINGSERVER_H
 
-#include <QElapsedTimer>
-#include <QFile>
-#include <QSettings>
+#include <QHash>
 #include <QTcpServer>
 #include <QTimer>
 
+#include "Room.h"
 #include "ServerSession.h"
-#include "protocol/Data.h"
-#include "protocol/RemoteAction.h"
+
+// Accepts connections and hands each session to the room its hello names.
+// The unnamed room is the project the server was started with. Other rooms
+// are only available with a rooms directory, where each is loaded on demand
+// from <dir>/<name>.ptcop or journalled in <dir>/<name>, and unloaded after
+// it's been empty for a while.
 class BroadcastServer : public QObject {
   Q_OBJECT
  public:
   BroadcastServer(std::optional<QString> filename, QHostAddress host, int port,
                   std::optional<QString> save_history,
+                  std::optional<QString> journal_dir, int undo_horizon,
                   QObject *parent = nullptr, int delay_msec = 0,
                   double drop_rate = 0);
   ~BroadcastServer();
   int port();
 
   QHostAddress address();
+  void setRoomsDirectory(const QString &dir);
+  // These are all for the unnamed room.
   bool isReadingHistory();
+  qint64 playbackPosition() const;
+  qint64 playbackDuration() const;
+  double playbackSpeed() const;
+  void setPlaybackSpeed(double speed);
+  void seekPlayback(qint64 position);
   const std::list<ServerSession *> &sessions() const;
  private slots:
   void newClient();
+  void unloadIdleRooms();
 
  private:
-  void broadcastAction(const ClientAction &m, qint64 uid);
-  void broadcastNewSession(const QString &username, qint64 uid);
-  void broadcastDeleteSession(qint64 uid);
+  Room *findRoom(const QString &name);
   QTcpServer *m_server;
-  QList<ServerAction> m_history;
-  std::list<ServerSession *> m_sessions;
-  QByteArray m_data;
-  int m_next_uid;
-  int m_delay_msec;
-  double m_drop_rate;
-  std::unique_ptr<QDataStream> m_load_history;
-  QString m_save_history_filename;
-  std::unique_ptr<QDataStream> m_save_history;
-  QElapsedTimer m_history_elapsed;
-  QTimer *m_timer;
-  void broadcastServerAction(const ServerAction &a);
-  void broadcastUnreliable(const ServerAction &a);
-  void finalizeSaveHistory();
+  Room *m_default_room;
+  QHash<QString, Room *> m_rooms;
+  std::optional<QString> m_rooms_dir;
+  int m_undo_horizon;
+  QTimer *m_unload_timer;
 };
 
 #endif  // SEQUENCINGSERVER_H
@@ -6,6 +6,7 @@
 #include <QMessageBox>
 
 #include "protocol/Hello.h"
+#include "protocol/WireCodec.h"
 
 QString HostAndPort::toString() { return QString("%1:%2").arg(host).arg(port); }
 
@@ -14,10 +15,13 @@ Client::Client(QObject *parent)
       m_socket(new QTcpSocket(this)),
       m_write_stream((QIODevice *)m_socket),
       m_read_stream((QIODevice *)m_socket),
-      m_received_hello(false) {
+      m_received_hello(false),
+      m_codec(WIRE_DATASTREAM),
+      m_undo_horizon(DEFAULT_UNDO_HORIZON) {
   connect(m_socket, &QTcpSocket::readyRead, this, &Client::tryToRead);
   connect(m_socket, &QTcpSocket::disconnected, [this]() {
     m_received_hello = false;
+    resetBlobState();
     emit disconnected(m_suppress_disconnect);
     m_suppress_disconnect = false;
   });
@@ -35,19 +39,23 @@ HostAndPort Client::currentlyConnectedTo() {
   return HostAndPort{m_socket->peerAddress().toString(), m_socket->peerPort()};
 }
 
-void Client::connectToServer(QString hostname, quint16 port, QString username) {
+void Client::connectToServer(QString hostname, quint16 port, QString username,
+                             QString room) {
   m_socket->abort();
+  resetBlobState();
   m_socket->connectToHost(hostname, port);
 
   // Guarded on connection in case the connection fails. In the past not having
   // this has caused me problems
   QMetaObject::Connection *const conn = new QMetaObject::Connection;
-  *conn = connect(m_socket, &QTcpSocket::connected, [this, conn, username]() {
-    qDebug() << "Sending hello to server";
-    m_write_stream << ClientHello(username);
-    disconnect(*conn);
-    delete conn;
-  });
+  *conn = connect(m_socket, &QTcpSocket::connected,
+                  [this, conn, username, room]() {
+                    qDebug() << "Sending hello to server";
+                    m_write_stream << ClientHello(
+                        username, Wire::supportedCodecs(), room);
+                    disconnect(*conn);
+                    delete conn;
+                  });
 }
 
 void Client::disconnectFromServerSuppressSignal() {
@@ -63,8 +71,22 @@ void Client::sendAction(const ClientAction &m) {
              << "Sending" << m;
   // Sometimes if I try to write data to a socket that's not ready it
   // invalidates the socket forever. I think these two guards should prevent it.
-  if (m_socket->isValid() && m_socket->state() == QTcpSocket::ConnectedState) {
-    m_write_stream << m;
+  // We also hold off until the server's hello since that's what says which
+  // codec to use.
+  if (m_received_hello && m_socket->isValid() &&
+      m_socket->state() == QTcpSocket::ConnectedState) {
+    if (woiceData(m)) {
+      ClientAction a = m;
+      AddWoice &w = *woiceData(a);
+      w.hash = blobHash(w.data);
+      m_blob_cache.insert(w.hash, w.data);
+      if (m_server_blobs.contains(w.hash))
+        w.data.clear();
+      else
+        m_server_blobs.insert(w.hash);
+      Wire::write(m_write_stream, m_codec, a);
+    } else
+      Wire::write(m_write_stream, m_codec, m);
     if (m_socket->bytesToWrite() == 0) {
       qWarning() << "Client::sendAction didn't seem to fill write." << m;
       qWarning() << "Socket state: open(" << m_socket->isOpen() << "), valid ("
@@ -82,6 +104,8 @@ void Client::sendAction(const ClientAction &m) {
 
 qint64 Client::uid() { return m_uid; }
 
+qint32 Client::undoHorizon() { return m_undo_horizon; }
+
 void Client::tryToRead() {
   // qDebug() << "Client has bytes available" << m_socket->bytesAvailable();
   // I got tripped up. tryToStart cannot be in the loop b/c that will cause it
@@ -93,7 +117,7 @@ void Client::tryToRead() {
 
       ServerAction action;
       try {
-        m_read_stream >> action;
+        Wire::read(m_read_stream, m_codec, action);
       } catch (const std::runtime_error &e) {
         qWarning("Discarding unreadable server action. Error: %s. ", e.what());
         m_read_stream.rollbackTransaction();
@@ -104,13 +128,102 @@ void Client::tryToRead() {
         return;
       }
 
-      if (action.shouldBeRecorded())
-        qDebug() << QDateTime::currentDateTime().toString(
-                        "yyyy.MM.dd hh:mm:ss.zzz")
-                 << "Received" << action;
+      if (const BlobData *b = std::get_if<BlobData>(&action.action))
+        receivedBlob(*b);
+      else {
+        m_pending_actions.push_back(action);
+        processPending();
+      }
+    }
+}
+
+void Client::resetBlobState() {
+  m_server_blobs.clear();
+  m_fetching_blobs.clear();
+  m_unavailable_blobs.clear();
+  m_pending_join.reset();
+  m_pending_actions.clear();
+}
+
+// Fills in the woice's data from the cache if it was sent by hash. Returns
+// false if we have to fetch it first.
+bool Client::resolveBlob(AddWoice &w) {
+  if (!w.data.isEmpty()) {
+    if (w.hash.isEmpty()) w.hash = blobHash(w.data);
+    m_blob_cache.insert(w.hash, w.data);
+    m_server_blobs.insert(w.hash);
+    return true;
+  }
+  if (w.hash.isEmpty()) return true;
+
+  m_server_blobs.insert(w.hash);
+  std::optional<QByteArray> data = m_blob_cache.get(w.hash);
+  if (data.has_value()) {
+    w.data = data.value();
+    return true;
+  }
+  // Let adding the woice fail rather than waiting forever.
+  return m_unavailable_blobs.contains(w.hash);
+}
+
+void Client::fetchBlobs(const QList<QByteArray> &hashes) {
+  FetchBlobs f;
+  for (const QByteArray &hash : hashes)
+    if (!m_fetching_blobs.contains(hash)) {
+      m_fetching_blobs.insert(hash);
+      f.hashes.push_back(hash);
+    }
+  if (f.hashes.empty()) return;
+  qDebug() << "Fetching" << f.hashes.size() << "woice blobs";
+  Wire::write(m_write_stream, m_codec, ClientAction(f));
+}
+
+void Client::receivedBlob(const BlobData &b) {
+  m_fetching_blobs.remove(b.hash);
+  if (!b.data.isEmpty() && blobHash(b.data) == b.hash) {
+    m_blob_cache.insert(b.hash, b.data);
+    m_server_blobs.insert(b.hash);
+  } else {
+    qWarning() << "Server could not provide woice blob" << hashData(b.hash);
+    m_unavailable_blobs.insert(b.hash);
+  }
+  processPending();
+}
+
+void Client::processPending() {
+  if (m_pending_join.has_value()) {
+    QList<QByteArray> missing;
+    for (ServerAction &a : m_pending_join->history)
+      if (AddWoice *w = woiceData(a))
+        if (!resolveBlob(*w)) missing.push_back(w->hash);
+    if (!missing.empty()) {
+      fetchBlobs(missing);
+      return;
+    }
+
+    PendingJoin join = std::move(m_pending_join.value());
+    m_pending_join.reset();
+    pxtnDescriptor d;
+    d.set_memory_r(join.data.constData(), join.data.size());
+    emit connected(d, join.history, m_uid);
+  }
 
-      emit receivedAction(action);
+  while (!m_pending_actions.empty()) {
+    AddWoice *w = woiceData(m_pending_actions.front());
+    if (w && !resolveBlob(*w)) {
+      fetchBlobs({w->hash});
+      return;
     }
+    ServerAction action = std::move(m_pending_actions.front());
+    m_pending_actions.pop_front();
+
+    if (action.shouldBeRecorded())
+      qDebug() << QDateTime::currentDateTime().toString(
+                      "yyyy.MM.dd hh:mm:ss.zzz")
+               << "Received" << action;
+
+    emit receivedAction(action);
+  }
 }
 
 void Client::tryToStart() {
@@ -124,7 +237,19 @@ void Client::tryToStart() {
   QMap<qint64, QString> sessions;
 
   m_read_stream.startTransaction();
-  m_read_stream >> hello >> data >> history >> sessions;
+  m_read_stream >> hello;
+  try {
+    Wire::readFile(m_read_stream, hello.codec(), data);
+    Wire::read(m_read_stream, hello.codec(), history);
+  } catch (const std::runtime_error &e) {
+    qWarning("Unreadable initial data from server. Error: %s.", e.what());
+    m_read_stream.rollbackTransaction();
+    emit errorOccurred(
+        tr("Unreadable initial data from server. Disconnecting."));
+    m_socket->disconnectFromHost();
+    return;
+  }
+  m_read_stream >> sessions;
   if (!m_read_stream.commitTransaction()) return;
 
   if (!hello.isValid()) {
@@ -135,13 +260,14 @@ void Client::tryToStart() {
     return;
   }
   m_uid = hello.uid();
+  m_codec = hello.codec();
+  m_undo_horizon = hello.undoHorizon();
 
   qDebug() << "Received history of size" << history.size();
 
   m_received_hello = true;
-  pxtnDescriptor d;
-  d.set_memory_r(data.constData(), data.size());
-  emit connected(d, history, m_uid);
+  m_pending_join = PendingJoin{data, history};
+  processPending();
   // for (auto it = sessions.begin(); it != sessions.end(); ++it)
   //  emit receivedNewSession(it.value(), it.key());
 }
@@ -1,8 +1,11 @@
 #ifndef ACTIONCLIENT_H
 #define ACTIONCLIENT_H
 #include <QObject>
+#include <QSet>
 #include <QTcpSocket>
 
+#include "BlobCache.h"
+#include "protocol/Hello.h"
 #include "protocol/RemoteAction.h"
 #include "pxtone/pxtnDescriptor.h"
 struct HostAndPort {
@@ -16,10 +19,12 @@ class Client : public QObject {
   Client(QObject *parent);
 
   HostAndPort currentlyConnectedTo();
-  void connectToServer(QString hostname, quint16 port, QString username);
+  void connectToServer(QString hostname, quint16 port, QString username,
+                       QString room = "");
   void disconnectFromServerSuppressSignal();
   void sendAction(const ClientAction &m);
   qint64 uid();
+  qint32 undoHorizon();
  signals:
   void connected(pxtnDescriptor &desc, QList<ServerAction> &history,
                  qint64 uid);
@@ -35,8 +40,31 @@ class Client : public QObject {
   bool m_received_hello;
   bool m_suppress_disconnect;
   qint64 m_uid;
+  WireCodec m_codec;
+  qint32 m_undo_horizon;
+
+  // Woice data is fetched by hash when we don't have it cached. Until it
+  // arrives, the join and any actions after it wait here so they're still
+  // delivered in order.
+  struct PendingJoin {
+    QByteArray data;
+    QList<ServerAction> history;
+  };
+  BlobCache m_blob_cache;
+  // Blobs the server has, so we can send just the hash.
+  QSet<QByteArray> m_server_blobs;
+  QSet<QByteArray> m_fetching_blobs;
+  QSet<QByteArray> m_unavailable_blobs;
+  std::optional<PendingJoin> m_pending_join;
+  std::list<ServerAction> m_pending_actions;
+
   void tryToRead();
   void tryToStart();
+  void resetBlobState();
+  bool resolveBlob(AddWoice &w);
+  void fetchBlobs(const QList<QByteArray> &hashes);
+  void receivedBlob(const BlobData &b);
+  void processPending();
 };
 
 #endif  // ACTIONCLIENT_H
@@ -0,0 +1,192 @@
+#include "Journal.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QSaveFile>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+constexpr quint32 JOURNAL_MAGIC = 0x50544a4c;  // PTJL
+constexpr qint32 JOURNAL_VERSION = 1;
+// How long appended actions can wait before being synced to disk.
+constexpr int SYNC_INTERVAL_MSEC = 200;
+constexpr qint64 COMPACT_SEGMENT_BYTES = 16 * 1024 * 1024;
+constexpr qint64 COMPACT_SEGMENT_ACTIONS = 20000;
+
+static void flushToDisk(QFile &file) {
+  if (!file.isOpen()) return;
+  file.flush();
+#ifdef _WIN32
+  _commit(file.handle());
+#else
+  fsync(file.handle());
+#endif
+}
+
+// Moves any woice data in [a] into [blobs].
+static void stripBlob(ServerAction &a, QHash<QByteArray, QByteArray> &blobs) {
+  AddWoice *w = woiceData(a);
+  if (!w || w->data.isEmpty()) return;
+  if (w->hash.isEmpty()) w->hash = blobHash(w->data);
+  blobs.insert(w->hash, w->data);
+  w->data.clear();
+}
+
+Journal::Journal(const QString &dir, QObject *parent)
+    : QObject(parent),
+      m_dir(dir),
+      m_segment_number(0),
+      m_segment_actions(0),
+      m_sync_timer(new QTimer(this)) {
+  if (!m_dir.mkpath("."))
+    throw QString("Could not create journal directory %1").arg(dir);
+  m_sync_timer->setSingleShot(true);
+  connect(m_sync_timer, &QTimer::timeout, this, &Journal::sync);
+}
+
+Journal::~Journal() { sync(); }
+
+QString Journal::segmentPath(qint64 segment) const {
+  QString name = QString("segment-%1.ptj").arg(segment, 8, 10, QChar('0'));
+  return m_dir.filePath(name);
+}
+
+QString Journal::snapshotPath() const { return m_dir.filePath("snapshot"); }
+
+std::optional<Journal::State> Journal::recover() {
+  QFile file(snapshotPath());
+  if (!file.open(QIODevice::ReadOnly)) return std::nullopt;
+
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_5_5);
+  quint32 magic;
+  qint32 version;
+  qint64 first_segment;
+  State state;
+  in >> magic >> version;
+  if (magic != JOURNAL_MAGIC || version != JOURNAL_VERSION) {
+    qWarning() << "Ignoring journal of unknown version" << version << "in"
+               << m_dir.path();
+    return std::nullopt;
+  }
+  try {
+    in >> first_segment >> state.next_uid >> state.data >> state.history >>
+        state.blobs;
+  } catch (const std::runtime_error &e) {
+    qWarning() << "Malformed journal snapshot" << e.what();
+    return std::nullopt;
+  }
+  if (in.status() != QDataStream::Ok) {
+    qWarning() << "Truncated journal snapshot in" << m_dir.path();
+    return std::nullopt;
+  }
+
+  qint64 segment = first_segment;
+  for (; QFile::exists(segmentPath(segment)); ++segment)
+    readSegment(segment, state);
+  m_segment_number = segment - 1;
+  qInfo() << "Recovered" << state.history.size() << "actions from journal"
+          << m_dir.path();
+  return state;
+}
+
+void Journal::readSegment(qint64 segment, State &state) {
+  QFile file(segmentPath(segment));
+  if (!file.open(QIODevice::ReadOnly)) {
+    qWarning() << "Could not read journal segment" << file.fileName();
+    return;
+  }
+  QDataStream in(&file);
+  in.setVersion(QDataStream::Qt_5_5);
+  while (!in.atEnd()) {
+    quint32 size;
+    quint16 checksum;
+    in >> size >> checksum;
+    if (in.status() != QDataStream::Ok || size > file.bytesAvailable()) break;
+    QByteArray payload = file.read(size);
+    if (qChecksum(payload.constData(), payload.size()) != checksum) break;
+
+    ServerAction a;
+    QDataStream action_in(payload);
+    action_in.setVersion(QDataStream::Qt_5_5);
+    try {
+      action_in >> a;
+    } catch (const std::runtime_error &e) {
+      qWarning() << "Malformed action in journal" << e.what();
+      break;
+    }
+    state.next_uid = std::max(state.next_uid, qint32(a.uid + 1));
+    if (!a.shouldBeRecorded()) continue;
+    stripBlob(a, state.blobs);
+    state.history.push_back(a);
+  }
+  if (!in.atEnd())
+    qWarning() << "Dropping torn end of journal segment" << file.fileName();
+}
+
+bool Journal::openSegment(qint64 segment) {
+  m_segment.setFileName(segmentPath(segment));
+  if (!m_segment.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+    qWarning() << "Could not open journal segment" << m_segment.fileName();
+    return false;
+  }
+  m_segment_number = segment;
+  m_segment_actions = 0;
+  return true;
+}
+
+void Journal::compact(const State &state) {
+  sync();
+  qint64 next_segment = m_segment_number + 1;
+
+  QSaveFile file(snapshotPath());
+  if (file.open(QIODevice::WriteOnly)) {
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_5);
+    out << JOURNAL_MAGIC << JOURNAL_VERSION << next_segment << state.next_uid
+        << state.data << state.history << state.blobs;
+  }
+  // On failure, keep appending to the old segments so nothing's lost.
+  if (!file.commit()) {
+    qWarning() << "Could not write journal snapshot" << file.fileName();
+    return;
+  }
+
+  m_segment.close();
+  openSegment(next_segment);
+  for (const QString &name :
+       m_dir.entryList({"segment-*.ptj"}, QDir::Files, QDir::Name)) {
+    if (m_dir.filePath(name) >= segmentPath(next_segment)) break;
+    m_dir.remove(name);
+  }
+}
+
+void Journal::append(const ServerAction &a) {
+  if (!m_segment.isOpen()) return;
+  QByteArray payload;
+  QDataStream out(&payload, QIODevice::WriteOnly);
+  out.setVersion(QDataStream::Qt_5_5);
+  out << a;
+
+  QDataStream segment(&m_segment);
+  segment.setVersion(QDataStream::Qt_5_5);
+  segment << quint32(payload.size())
+          << qChecksum(payload.constData(), payload.size());
+  segment.writeRawData(payload.constData(), payload.size());
+  ++m_segment_actions;
+  if (!m_sync_timer->isActive()) m_sync_timer->start(SYNC_INTERVAL_MSEC);
+}
+
+bool Journal::needsCompaction() const {
+  return m_segment_actions >= COMPACT_SEGMENT_ACTIONS ||
+         m_segment.size() >= COMPACT_SEGMENT_BYTES;
+}
+
+void Journal::sync() {
+  m_sync_timer->stop();
+  flushToDisk(m_segment);
+}
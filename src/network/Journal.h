@@ -0,0 +1,60 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+#include <optional>
+
+#include "protocol/RemoteAction.h"
+
+// An on-disk copy of the server's state, so that a server that crashes can be
+// restarted and pick up where it left off without anyone uploading the
+// project again.
+//
+// The journal directory holds a snapshot of the whole state and numbered
+// segments that the actions since then get appended to. Segments are synced to
+// disk in batches a short time after writing, and once a segment gets big a
+// new snapshot is written and the old segments are deleted. A torn write at
+// the end of a segment is detected by its length and checksum and dropped.
+class Journal : public QObject {
+  Q_OBJECT
+ public:
+  struct State {
+    qint32 next_uid;
+    QByteArray data;
+    // History actions don't carry woice data. It's in [blobs] instead.
+    QList<ServerAction> history;
+    QHash<QByteArray, QByteArray> blobs;
+  };
+
+  // Throws a QString if [dir] can't be created.
+  Journal(const QString &dir, QObject *parent = nullptr);
+  ~Journal();
+
+  // The state left in the directory by an earlier server, if any.
+  std::optional<State> recover();
+  // Replaces whatever's in the journal with [state] and starts appending
+  // after it.
+  void compact(const State &state);
+  void append(const ServerAction &a);
+  bool needsCompaction() const;
+
+ public slots:
+  void sync();
+
+ private:
+  QString segmentPath(qint64 segment) const;
+  QString snapshotPath() const;
+  bool openSegment(qint64 segment);
+  void readSegment(qint64 segment, State &state);
+  QDir m_dir;
+  QFile m_segment;
+  qint64 m_segment_number;
+  qint64 m_segment_actions;
+  QTimer *m_sync_timer;
+};
+
+#endif  // JOURNAL_H
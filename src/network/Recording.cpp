@@ -0,0 +1,179 @@
+#include "Recording.h"
+
+#include <QDebug>
+#include <algorithm>
+
+#include "protocol/Hello.h"
+
+// 2: Woices carry their hash.
+// 3: Index of recorded actions and checkpoints.
+const qint64 RECORDING_VERSION = 3;
+constexpr qint64 CHECKPOINT_INTERVAL_MSEC = 10000;
+
+RecordingWriter::RecordingWriter(const QString &filename)
+    : m_filename(filename),
+      m_tmp(filename + ".tmp"),
+      m_next_checkpoint(CHECKPOINT_INTERVAL_MSEC),
+      m_duration(0) {
+  if (!m_tmp.open(QIODevice::ReadWrite | QIODevice::Truncate))
+    throw QString("Unable to open %1 for writing").arg(m_tmp.fileName());
+  m_stream.setDevice(&m_tmp);
+}
+
+RecordingWriter::~RecordingWriter() {
+  if (m_tmp.isOpen()) m_tmp.close();
+}
+
+void RecordingWriter::write(qint64 elapsed, const ServerAction &a) {
+  qint64 offset = m_tmp.pos();
+  if (elapsed >= m_next_checkpoint) {
+    m_checkpoints.push_back({elapsed, offset, qint32(m_recorded.size())});
+    m_next_checkpoint = elapsed + CHECKPOINT_INTERVAL_MSEC;
+  }
+  if (a.shouldBeRecorded()) m_recorded.push_back(offset);
+  m_duration = elapsed;
+  m_stream << elapsed << a;
+}
+
+bool RecordingWriter::finalize(qint32 next_uid, const QByteArray &data) {
+  if (!m_tmp.isOpen()) return false;
+  QFile final_file(m_filename);
+  if (!final_file.open(QIODevice::WriteOnly)) {
+    qWarning() << "Cannot open" << m_filename << "for saving recording";
+    return false;
+  }
+
+  QDataStream stream(&final_file);
+  stream << PROTOCOL_VERSION << RECORDING_VERSION << next_uid << data;
+  qint64 body_start = final_file.pos();
+
+  constexpr int SIZE = 4096;
+  char buf[SIZE];
+  m_tmp.seek(0);
+  while (!m_tmp.atEnd()) {
+    qint64 read_size = m_tmp.read(buf, SIZE);
+    if (read_size <= 0) break;
+    stream.writeRawData(buf, read_size);
+  }
+
+  qint64 index_offset = final_file.pos();
+  QList<qint64> recorded;
+  recorded.reserve(m_recorded.size());
+  for (qint64 offset : m_recorded) recorded.push_back(body_start + offset);
+  stream << m_duration << recorded << qint32(m_checkpoints.size());
+  for (const RecordingCheckpoint &c : m_checkpoints)
+    stream << c.elapsed << body_start + c.offset << c.recorded;
+  stream << index_offset;
+
+  bool ok = (stream.status() == QDataStream::Ok);
+  final_file.close();
+  m_tmp.close();
+  m_tmp.remove();
+  return ok;
+}
+
+RecordingReader::RecordingReader(const QString &filename)
+    : m_file(filename), m_duration(-1) {
+  if (!m_file.open(QIODevice::ReadOnly | QIODevice::ExistingOnly))
+    throw QString("Could not read file %1").arg(filename);
+  m_stream.setDevice(&m_file);
+
+  qint64 protocol_version, recording_version;
+  m_stream >> protocol_version >> recording_version;
+  // Recordings always hold the QDataStream encoding of actions, which
+  // changes only with the recording version.
+  if (protocol_version < 1 || protocol_version > PROTOCOL_VERSION ||
+      recording_version < 2 || recording_version > RECORDING_VERSION)
+    throw QString("Incompatible recording version. %1.%2 (%3.%4)")
+        .arg(protocol_version)
+        .arg(recording_version)
+        .arg(PROTOCOL_VERSION)
+        .arg(RECORDING_VERSION);
+  m_stream >> m_next_uid >> m_data;
+  m_body_start = m_file.pos();
+  m_body_end = m_file.size();
+
+  if (recording_version >= 3) {
+    qint64 index_offset;
+    m_file.seek(m_file.size() - qint64(sizeof(qint64)));
+    m_stream >> index_offset;
+    if (m_stream.status() != QDataStream::Ok || index_offset < m_body_start ||
+        index_offset > m_file.size())
+      throw QString("Recording index is corrupt");
+    m_file.seek(index_offset);
+    qint32 num_checkpoints;
+    m_stream >> m_duration >> m_recorded >> num_checkpoints;
+    for (qint32 i = 0; i < num_checkpoints; ++i) {
+      RecordingCheckpoint c;
+      m_stream >> c.elapsed >> c.offset >> c.recorded;
+      m_checkpoints.push_back(c);
+    }
+    if (m_stream.status() != QDataStream::Ok)
+      throw QString("Recording index is corrupt");
+    m_body_end = index_offset;
+  }
+  if (m_stream.status() != QDataStream::Ok)
+    throw QString("Could not read recording header");
+
+  m_file.seek(m_body_start);
+  readNext();
+}
+
+qint32 RecordingReader::nextUid() const { return m_next_uid; }
+const QByteArray &RecordingReader::data() const { return m_data; }
+qint64 RecordingReader::duration() const { return m_duration; }
+
+bool RecordingReader::atEnd() const { return !m_next.has_value(); }
+const RecordingReader::Entry &RecordingReader::peek() const {
+  return m_next.value();
+}
+void RecordingReader::advance() { readNext(); }
+
+void RecordingReader::readNext() {
+  m_next.reset();
+  if (m_file.pos() >= m_body_end) return;
+  Entry entry;
+  if (!readAt(m_file.pos(), entry)) {
+    qWarning() << "Unexpected end of recording";
+    return;
+  }
+  m_next = std::move(entry);
+}
+
+bool RecordingReader::readAt(qint64 offset, Entry &entry) {
+  if (offset < m_body_start || offset >= m_body_end || !m_file.seek(offset))
+    return false;
+  m_stream.resetStatus();
+  try {
+    m_stream >> entry.elapsed >> entry.action;
+  } catch (const std::runtime_error &e) {
+    qWarning() << "Malformed action in recording" << e.what();
+    return false;
+  }
+  return m_stream.status() == QDataStream::Ok;
+}
+
+QList<ServerAction> RecordingReader::seek(qint64 elapsed) {
+  auto it = std::upper_bound(
+      m_checkpoints.begin(), m_checkpoints.end(), elapsed,
+      [](qint64 t, const RecordingCheckpoint &c) { return t < c.elapsed; });
+
+  QList<ServerAction> history;
+  qint64 resume = m_body_start;
+  if (it != m_checkpoints.begin()) {
+    const RecordingCheckpoint &c = *(it - 1);
+    for (qint32 i = 0; i < c.recorded && i < m_recorded.size(); ++i) {
+      Entry entry;
+      if (!readAt(m_recorded[i], entry)) {
+        qWarning() << "Recording index points at a bad action; rewinding";
+        history.clear();
+        break;
+      }
+      history.push_back(std::move(entry.action));
+    }
+    if (history.size() == c.recorded) resume = c.offset;
+  }
+  m_file.seek(resume);
+  readNext();
+  return history;
+}
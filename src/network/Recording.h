@@ -0,0 +1,86 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <QDataStream>
+#include <QFile>
+#include <QList>
+#include <optional>
+
+#include "protocol/RemoteAction.h"
+
+// A .ptrec file is a header (protocol version, recording version, next uid,
+// initial project) followed by every action the server broadcast, each with
+// the msec since the server started. Since version 3 an index follows: the
+// offsets of the actions that go into the history, and checkpoints every few
+// seconds. Seeking to a time then only reads the history up to the nearest
+// checkpoint instead of every cursor movement before it.
+extern const qint64 RECORDING_VERSION;
+
+struct RecordingCheckpoint {
+  qint64 elapsed;
+  // Where the first action at or after [elapsed] starts.
+  qint64 offset;
+  // How many of the recorded actions come before [offset].
+  qint32 recorded;
+};
+
+class RecordingWriter {
+ public:
+  // The body is written to [filename].tmp until [finalize] is called. Throws
+  // a QString if that can't be opened.
+  RecordingWriter(const QString &filename);
+  ~RecordingWriter();
+  void write(qint64 elapsed, const ServerAction &a);
+  bool finalize(qint32 next_uid, const QByteArray &data);
+
+ private:
+  QString m_filename;
+  QFile m_tmp;
+  QDataStream m_stream;
+  // Offsets here are from the start of the body.
+  QList<qint64> m_recorded;
+  QList<RecordingCheckpoint> m_checkpoints;
+  qint64 m_next_checkpoint;
+  qint64 m_duration;
+};
+
+class RecordingReader {
+ public:
+  struct Entry {
+    qint64 elapsed;
+    ServerAction action;
+  };
+
+  // Throws a QString if the file can't be read or is of a version we don't
+  // know.
+  RecordingReader(const QString &filename);
+  qint32 nextUid() const;
+  const QByteArray &data() const;
+  // -1 for recordings from before there was an index.
+  qint64 duration() const;
+
+  bool atEnd() const;
+  const Entry &peek() const;
+  void advance();
+
+  // Positions the reader at the latest checkpoint at or before [elapsed],
+  // returning the recorded actions before it. Recordings without an index are
+  // just rewound.
+  QList<ServerAction> seek(qint64 elapsed);
+
+ private:
+  bool readAt(qint64 offset, Entry &entry);
+  void readNext();
+  QFile m_file;
+  QDataStream m_stream;
+  qint32 m_next_uid;
+  QByteArray m_data;
+  qint64 m_body_start;
+  qint64 m_body_end;
+  qint64 m_duration;
+  QList<qint64> m_recorded;
+  QList<RecordingCheckpoint> m_checkpoints;
+  std::optional<Entry> m_next;
+};
+
+#endif  // RECORDING_H
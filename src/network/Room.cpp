@@ -0,0 +1,380 @@
+#include "Room.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QTimer>
+#include <cmath>
+
+#include "protocol/Hello.h"
+#include "protocol/WoiceHistory.h"
+
+// When catching up on a recording, transient actions older than this are
+// skipped instead of being sent.
+constexpr qint64 PLAYBACK_CATCH_UP_MSEC = 1000;
+
+Room::Room(const QString &name, std::optional<QString> filename,
+           std::optional<QString> save_history,
+           std::optional<QString> journal_dir, int undo_horizon,
+           QObject *parent, int delay_msec, double drop_rate)
+    : QObject(parent),
+      m_name(name),
+      m_sessions(),
+      m_next_uid(0),
+      m_undo_horizon(undo_horizon),
+      m_delay_msec(delay_msec),
+      m_drop_rate(drop_rate),
+      m_recording(nullptr),
+      m_playback_speed(1),
+      m_playback_origin(0),
+      m_recorder(nullptr),
+      m_journal(nullptr),
+      m_timer(new QTimer(this)) {
+  m_timer->setSingleShot(true);
+  m_history_elapsed.start();
+  m_idle.start();
+  if (filename.has_value()) {
+    if (QFileInfo(filename.value()).suffix() == "ptrec") {
+      m_recording = std::make_unique<RecordingReader>(filename.value());
+      m_next_uid = m_recording->nextUid();
+      m_data = m_recording->data();
+      connect(m_timer, &QTimer::timeout, this, &Room::playRecording);
+      m_playback_clock.start();
+      m_timer->start(0);
+    } else {
+      QFile file(filename.value());
+      if (!file.open(QIODevice::ReadOnly | QIODevice::ExistingOnly))
+        throw tr("Could not read file %1").arg(filename.value());
+      m_data = file.readAll();
+    }
+  }
+
+  if (save_history.has_value())
+    m_recorder = std::make_unique<RecordingWriter>(save_history.value());
+
+  if (journal_dir.has_value()) {
+    if (m_recording)
+      qWarning() << "Not journalling while replaying a recording";
+    else {
+      m_journal = new Journal(journal_dir.value(), this);
+      if (std::optional<Journal::State> state = m_journal->recover()) {
+        if (filename.has_value())
+          qInfo() << "Resuming journalled session instead of opening"
+                  << filename.value();
+        m_next_uid = state->next_uid;
+        m_data = state->data;
+        m_history = state->history;
+        m_blobs = state->blobs;
+        endRecoveredSessions();
+      }
+      pruneBlobs();
+      compactJournal();
+    }
+  }
+}
+
+const QString &Room::name() const { return m_name; }
+
+qint64 Room::idleMsec() const {
+  return m_sessions.empty() ? m_idle.elapsed() : 0;
+}
+
+bool Room::isReadingHistory() { return m_recording != nullptr; }
+
+const std::list<ServerSession *> &Room::sessions() const {
+  return m_sessions;
+}
+
+Room::~Room() {
+  // Without these disconnects, I think the sessions' destructors emit the
+  // socket disconnected signal which ends up trying to call
+  // [broadcastDeleteSession] even after this destructor's been called.
+  for (ServerSession *s : m_sessions) s->disconnect();
+  if (m_journal) {
+    pruneBlobs();
+    compactJournal();
+  }
+  if (m_recorder) {
+    if (m_recorder->finalize(m_next_uid, m_data))
+      qDebug() << "Finalized save history successfully";
+    m_recorder.reset();
+  }
+}
+
+qint64 Room::playbackPosition() const {
+  if (!m_recording) return 0;
+  return m_playback_origin + m_playback_clock.elapsed() * m_playback_speed;
+}
+
+qint64 Room::playbackDuration() const {
+  if (!m_recording) return 0;
+  return m_recording->duration();
+}
+
+double Room::playbackSpeed() const { return m_playback_speed; }
+
+void Room::setPlaybackSpeed(double speed) {
+  if (!m_recording || speed <= 0) return;
+  m_playback_origin = playbackPosition();
+  m_playback_clock.restart();
+  m_playback_speed = speed;
+  playRecording();
+}
+
+void Room::seekPlayback(qint64 position) {
+  if (!m_recording) return;
+  position = std::max<qint64>(position, 0);
+  m_timer->stop();
+  // Clients can't unwind what they've been sent, so going back means
+  // dropping them and rebuilding the history from the recording's index.
+  if (position < playbackPosition() || m_sessions.empty()) {
+    closeSessions();
+    m_history.clear();
+    for (const ServerAction &a : m_recording->seek(position))
+      m_history.push_back(withoutBlob(a));
+    qInfo() << "Seeked recording to" << position << "with"
+            << m_history.size() << "actions in history";
+  }
+  m_playback_origin = position;
+  m_playback_clock.restart();
+  playRecording();
+}
+
+void Room::playRecording() {
+  qint64 now = playbackPosition();
+  while (!m_recording->atEnd() && m_recording->peek().elapsed <= now) {
+    const RecordingReader::Entry &e = m_recording->peek();
+    if (e.action.shouldBeRecorded() ||
+        now - e.elapsed < PLAYBACK_CATCH_UP_MSEC)
+      broadcastServerAction(e.action);
+    m_recording->advance();
+  }
+  if (m_recording->atEnd()) {
+    qDebug() << "At end of recording";
+    return;
+  }
+  m_timer->start(
+      std::ceil((m_recording->peek().elapsed - now) / m_playback_speed));
+}
+
+// Whether clients can read a woice in the history.
+std::optional<bool> Room::woiceReadable(const AddWoice &w) {
+  if (!w.data.isEmpty() || w.hash.isEmpty()) return canReadWoice(w);
+  QPair<QByteArray, int> key(w.hash, w.type);
+  auto it = m_readable.find(key);
+  if (it != m_readable.end()) return it.value();
+  auto blob = m_blobs.find(w.hash);
+  if (blob == m_blobs.end()) return std::nullopt;
+  AddWoice full = w;
+  full.data = blob.value();
+  bool readable = canReadWoice(full);
+  m_readable.insert(key, readable);
+  return readable;
+}
+
+// Swaps woices that the history goes on to remove or replace for a silent
+// stand-in, so that joining clients don't fetch them and their blobs can be
+// pruned. The history stays replayable without those blobs.
+void Room::replaceRemovedWoices() {
+  std::vector<bool> removed =
+      removedWoices(m_data, m_history,
+                    [this](const AddWoice &w) { return woiceReadable(w); });
+  for (int i = 0; i < m_history.size(); ++i) {
+    if (!removed[i]) continue;
+    AddWoice *w = woiceData(m_history[i]);
+    AddWoice stand_in = standInWoice(w->name);
+    if (w->hash == stand_in.hash) continue;
+    m_blobs.insert(stand_in.hash, stand_in.data);
+    stand_in.data.clear();
+    *w = stand_in;
+  }
+}
+
+// Drops blobs that nothing in the history uses any more. Only safe with
+// nobody connected, since a client may still fetch one or send just its
+// hash.
+void Room::pruneBlobs() {
+  replaceRemovedWoices();
+  QSet<QByteArray> used;
+  for (const ServerAction &a : m_history)
+    if (const AddWoice *w = woiceData(a)) used.insert(w->hash);
+  for (auto it = m_blobs.begin(); it != m_blobs.end();)
+    if (used.contains(it.key()))
+      ++it;
+    else
+      it = m_blobs.erase(it);
+}
+
+void Room::compactJournal() {
+  m_journal->compact({m_next_uid, m_data, m_history, m_blobs});
+}
+
+// Whoever was connected when the journal was last written is gone now.
+void Room::endRecoveredSessions() {
+  QSet<qint64> open;
+  for (const ServerAction &a : m_history) {
+    if (std::holds_alternative<NewSession>(a.action)) open.insert(a.uid);
+    if (std::holds_alternative<DeleteSession>(a.action)) open.remove(a.uid);
+  }
+  for (qint64 uid : open) m_history.push_back({uid, DeleteSession{}});
+}
+
+void Room::closeSessions() {
+  for (ServerSession *s : m_sessions) {
+    s->disconnect();
+    s->close();
+    s->deleteLater();
+  }
+  m_sessions.clear();
+  m_idle.restart();
+}
+
+static QMap<qint64, QString> sessionMapping(
+    const std::list<ServerSession *> &sessions) {
+  QMap<qint64, QString> mapping;
+  for (const ServerSession *const s : sessions)
+    mapping.insert(s->uid(), s->username());
+  return mapping;
+}
+
+void Room::addSession(ServerSession *session) {
+  session->setUid(m_next_uid++);
+  broadcastNewSession(session->username(), session->uid());
+  m_sessions.push_back(session);
+
+  // Track iterator so we can delete it when it goes away
+  auto it = --m_sessions.end();
+  connect(session, &ServerSession::disconnected, [it, session, this]() {
+    m_sessions.erase(it);
+    broadcastDeleteSession(session->uid());
+    if (m_sessions.empty()) {
+      m_idle.restart();
+      pruneBlobs();
+      if (m_journal) compactJournal();
+    }
+    session->deleteLater();
+  });
+
+  // The client fetches whichever of these it doesn't have cached. Woices
+  // that are removed later on are swapped out first so it skips those.
+  replaceRemovedWoices();
+  for (const ServerAction &a : m_history)
+    if (const AddWoice *w = woiceData(a)) session->addBlob(w->hash);
+  session->sendHello(m_data, m_history, sessionMapping(m_sessions),
+                     m_undo_horizon);
+  connect(session, &ServerSession::receivedAction, this,
+          &Room::broadcastAction);
+}
+
+void Room::broadcastServerAction(const ServerAction &a) {
+  if (a.shouldBeRecorded())
+    qDebug() << QDateTime::currentDateTime().toString("yyyy.MM.dd hh:mm:ss.zzz")
+             << "Broadcast to" << m_sessions.size() << a;
+
+  // Sessions that already have the woice blob get the action without it, and
+  // so does the history. Recordings keep the data so they can be replayed.
+  ServerAction stripped = withoutBlob(a);
+  const AddWoice *original = woiceData(a);
+  const AddWoice *w = (original && !original->data.isEmpty())
+                          ? woiceData(stripped)
+                          : nullptr;
+
+  for (ServerSession *s : m_sessions) {
+    if (w && !s->hasBlob(w->hash)) {
+      s->addBlob(w->hash);
+      s->sendAction(a);
+    } else
+      s->sendAction(stripped);
+  }
+  if (m_recorder) m_recorder->write(m_history_elapsed.elapsed(), a);
+  if (a.shouldBeRecorded()) {
+    m_history.push_back(stripped);
+    if (m_journal) {
+      m_journal->append(a);
+      if (m_journal->needsCompaction()) compactJournal();
+    }
+  }
+}
+
+#include <QRandomGenerator>
+void Room::broadcastUnreliable(const ServerAction &a) {
+  if (m_drop_rate > 0 &&
+      QRandomGenerator::global()->generateDouble() < m_drop_rate) {
+    if (a.shouldBeRecorded())
+      qDebug() << QDateTime::currentDateTime().toString(
+                      "yyyy.MM.dd hh:mm:ss.zzz")
+               << "Dropping from" << m_sessions.size() << a;
+    return;
+  }
+
+  if (m_delay_msec > 0)
+    QTimer::singleShot(m_delay_msec, [this, a]() { broadcastServerAction(a); });
+  else
+    broadcastServerAction(a);
+}
+
+void Room::broadcastAction(const ClientAction &m, qint64 uid) {
+  ServerSession *session = findSession(uid);
+  if (const FetchBlobs *f = std::get_if<FetchBlobs>(&m)) {
+    if (session) sendBlobs(session, *f);
+    return;
+  }
+
+  ClientAction a = m;
+  if (AddWoice *w = woiceData(a)) {
+    if (!storeBlob(*w)) {
+      qWarning() << "Dropping woice" << w->name << "from" << uid
+                 << "with unknown data";
+      return;
+    }
+    if (session) session->addBlob(w->hash);
+  }
+  broadcastUnreliable({uid, a});
+}
+
+// Moves any woice data into the blob store, filling in the hash.
+ServerAction Room::withoutBlob(const ServerAction &a) {
+  ServerAction stripped = a;
+  AddWoice *w = woiceData(stripped);
+  if (w && !w->data.isEmpty()) {
+    // Already hashed if it came from a client.
+    if (w->hash.isEmpty()) w->hash = blobHash(w->data);
+    m_blobs.insert(w->hash, w->data);
+    w->data.clear();
+  }
+  return stripped;
+}
+
+ServerSession *Room::findSession(qint64 uid) {
+  for (ServerSession *s : m_sessions)
+    if (s->uid() == uid) return s;
+  return nullptr;
+}
+
+// Fills in whichever of the data and hash is missing, keeping the blob.
+// Returns false if only the hash was sent and we don't have the blob.
+bool Room::storeBlob(AddWoice &w) {
+  if (w.data.isEmpty()) {
+    if (w.hash.isEmpty()) return true;
+    auto it = m_blobs.find(w.hash);
+    if (it == m_blobs.end()) return false;
+    w.data = it.value();
+  } else {
+    w.hash = blobHash(w.data);
+    m_blobs.insert(w.hash, w.data);
+  }
+  return true;
+}
+
+void Room::sendBlobs(ServerSession *session, const FetchBlobs &f) {
+  for (const QByteArray &hash : f.hashes)
+    session->sendAction({session->uid(), BlobData{hash, m_blobs.value(hash)}});
+}
+
+void Room::broadcastNewSession(const QString &username, qint64 uid) {
+  broadcastServerAction({uid, NewSession{username}});
+}
+
+void Room::broadcastDeleteSession(qint64 uid) {
+  broadcastServerAction({uid, DeleteSession{}});
+}
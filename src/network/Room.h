@@ -0,0 +1,85 @@
+#ifndef ROOM_H
+#define ROOM_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QTimer>
+
+#include "Journal.h"
+#include "Recording.h"
+#include "ServerSession.h"
+#include "protocol/Data.h"
+#include "protocol/RemoteAction.h"
+
+// One project being edited on a server, with its own sessions and history.
+class Room : public QObject {
+  Q_OBJECT
+ public:
+  // Throws a QString if a file can't be read or written.
+  Room(const QString &name, std::optional<QString> filename,
+       std::optional<QString> save_history,
+       std::optional<QString> journal_dir, int undo_horizon,
+       QObject *parent = nullptr, int delay_msec = 0, double drop_rate = 0);
+  ~Room();
+  const QString &name() const;
+  // Takes over a session that's sent its hello.
+  void addSession(ServerSession *session);
+  // How long the room's had nobody in it, or 0 if someone's there.
+  qint64 idleMsec() const;
+
+  bool isReadingHistory();
+  // Where playback of a recording is, in msec of the recording.
+  qint64 playbackPosition() const;
+  // -1 if the recording doesn't say.
+  qint64 playbackDuration() const;
+  double playbackSpeed() const;
+  void setPlaybackSpeed(double speed);
+  // Seeking backwards disconnects everyone, since they can't undo what
+  // they've been sent.
+  void seekPlayback(qint64 position);
+  const std::list<ServerSession *> &sessions() const;
+ private slots:
+  void playRecording();
+
+ private:
+  void broadcastAction(const ClientAction &m, qint64 uid);
+  void broadcastNewSession(const QString &username, qint64 uid);
+  void broadcastDeleteSession(qint64 uid);
+  ServerSession *findSession(qint64 uid);
+  void closeSessions();
+  std::optional<bool> woiceReadable(const AddWoice &w);
+  void replaceRemovedWoices();
+  void pruneBlobs();
+  void compactJournal();
+  void endRecoveredSessions();
+  ServerAction withoutBlob(const ServerAction &a);
+  bool storeBlob(AddWoice &w);
+  void sendBlobs(ServerSession *session, const FetchBlobs &f);
+  QString m_name;
+  // Woice data in the history is stored once here by hash rather than inline.
+  QList<ServerAction> m_history;
+  QHash<QByteArray, QByteArray> m_blobs;
+  // Whether each blob can be read as a woice of a type, once it's been tried.
+  QHash<QPair<QByteArray, int>, bool> m_readable;
+  std::list<ServerSession *> m_sessions;
+  QByteArray m_data;
+  int m_next_uid;
+  int m_undo_horizon;
+  int m_delay_msec;
+  double m_drop_rate;
+  std::unique_ptr<RecordingReader> m_recording;
+  double m_playback_speed;
+  // Playback is at [m_playback_origin] when [m_playback_clock] starts.
+  qint64 m_playback_origin;
+  QElapsedTimer m_playback_clock;
+  std::unique_ptr<RecordingWriter> m_recorder;
+  Journal *m_journal;
+  QElapsedTimer m_history_elapsed;
+  QElapsedTimer m_idle;
+  QTimer *m_timer;
+  void broadcastServerAction(const ServerAction &a);
+  void broadcastUnreliable(const ServerAction &a);
+};
+
+#endif  // ROOM_H
@@ -4,18 +4,23 @@
 #include <QHostAddress>
 
 #include "protocol/Hello.h"
+#include "protocol/WireCodec.h"
 
-ServerSession::ServerSession(QObject *parent, QTcpSocket *conn, qint64 uid)
+ServerSession::ServerSession(QObject *parent, QTcpSocket *conn)
     : QObject(parent),
       m_socket(conn),
       m_write_stream((QIODevice *)conn),
       m_read_stream((QIODevice *)conn),
-      m_uid(uid),
+      m_uid(-1),
       m_username(""),
-      m_received_hello(false) {
+      m_room(""),
+      m_received_hello(false),
+      m_closed(false),
+      m_codec(WIRE_DATASTREAM) {
   connect(m_socket, &QIODevice::readyRead, this, &ServerSession::readMessage);
-  connect(m_socket, &QAbstractSocket::disconnected, [this]() {
+  connect(m_socket, &QAbstractSocket::disconnected, this, [this]() {
     qDebug() << "Disconnected" << m_uid;
+    m_closed = true;
     m_socket->deleteLater();
     // m_state = ServerSession::DISCONNECTED;
     m_socket = nullptr;
@@ -25,13 +30,22 @@ ServerSession::ServerSession(QObject *parent, QTcpSocket *conn, qint64 uid)
   m_read_stream.setVersion(QDataStream::Qt_5_5);
 }
 
+void ServerSession::close() {
+  m_closed = true;
+  if (m_socket) m_socket->abort();
+}
+
 // TODO: Include history, sessions, data in hello as a 'server history state'
 void ServerSession::sendHello(const QByteArray &data,
                               const QList<ServerAction> &history,
-                              const QMap<qint64, QString> &sessions) {
+                              const QMap<qint64, QString> &sessions,
+                              qint32 undo_horizon) {
   qInfo() << "Sending hello to " << m_socket->peerAddress();
 
-  m_write_stream << ServerHello(m_uid) << data << history << sessions;
+  m_write_stream << ServerHello(m_uid, m_codec, undo_horizon);
+  Wire::writeFile(m_write_stream, m_codec, data);
+  Wire::write(m_write_stream, m_codec, history);
+  m_write_stream << sessions;
 }
 
 void ServerSession::sendAction(const ServerAction &a) {
@@ -57,7 +71,7 @@ void ServerSession::sendAction(const ServerAction &a) {
                << "), error(" << m_socket->errorString() << ")";
   }*/
 
-  m_write_stream << a;
+  Wire::write(m_write_stream, m_codec, a);
   qint32 beforeFlush = m_socket->bytesToWrite();
   if (beforeFlush == 0) {
     qWarning() << "ServerSession::sendAction for u" << m_uid
@@ -71,10 +85,20 @@ void ServerSession::sendAction(const ServerAction &a) {
 
 qint64 ServerSession::uid() const { return m_uid; }
 
+void ServerSession::setUid(qint64 uid) { m_uid = uid; }
+
+QString ServerSession::room() const { return m_room; }
+
 QString ServerSession::username() const { return m_username; }
 
+bool ServerSession::hasBlob(const QByteArray &hash) const {
+  return m_blobs.contains(hash);
+}
+
+void ServerSession::addBlob(const QByteArray &hash) { m_blobs.insert(hash); }
+
 void ServerSession::readMessage() {
-  while (!m_read_stream.atEnd()) {
+  while (!m_closed && !m_read_stream.atEnd()) {
     if (!m_received_hello) {
       m_read_stream.startTransaction();
       ClientHello m;
@@ -82,12 +106,16 @@ void ServerSession::readMessage() {
       if (!m_read_stream.commitTransaction()) return;
       m_received_hello = true;
       m_username = m.username();
+      m_room = m.room();
+      m_codec = Wire::negotiate(m.codecs());
       emit receivedHello();
+      // Closed if there was no room for it.
+      if (m_closed) return;
     } else {
       m_read_stream.startTransaction();
       ClientAction action;
       try {
-        m_read_stream >> action;
+        Wire::read(m_read_stream, m_codec, action);
       } catch (const std::runtime_error &e) {
         qWarning(
             "Could not read client action from %lld (%s). Error: %s. "
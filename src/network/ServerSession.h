@@ -3,22 +3,32 @@
 
 #include <QDataStream>
 #include <QFile>
+#include <QSet>
 #include <QTcpSocket>
 
 #include "protocol/Data.h"
+#include "protocol/Hello.h"
 #include "protocol/RemoteAction.h"
 class ServerSession : public QObject {
   Q_OBJECT
  public:
-  ServerSession(QObject *parent, QTcpSocket *conn, qint64 uid);
+  // The uid is set by the room the session joins.
+  ServerSession(QObject *parent, QTcpSocket *conn);
   // Probably don't need super complex state right now. Just need to check if
   // hello is here. enum State { STARTING, READY, DISCONNECTED }; State state();
   void sendHello(const QByteArray &file, const QList<ServerAction> &history,
-                 const QMap<qint64, QString> &sessions);
+                 const QMap<qint64, QString> &sessions, qint32 undo_horizon);
   void sendAction(const ServerAction &action);
+  void close();
   qint64 uid() const;
+  void setUid(qint64 uid);
+  QString room() const;
   QString username() const;
   bool hasReceivedHello() const;
+  // Woice blobs the client has or has been sent, so the server knows when it
+  // can leave the data out of an action.
+  bool hasBlob(const QByteArray &hash) const;
+  void addBlob(const QByteArray &hash);
  signals:
   void receivedAction(const ClientAction &action, qint64 uid);
   void receivedHello();
@@ -32,8 +42,13 @@ class ServerSession : public QObject {
   QDataStream m_write_stream, m_read_stream;
   qint64 m_uid;
   QString m_username;
+  QString m_room;
   // State m_state;
   bool m_received_hello;
+  // Set once closed or disconnected, so nothing more is read from the socket.
+  bool m_closed;
+  WireCodec m_codec;
+  QSet<QByteArray> m_blobs;
 };
 
 #endif  // SERVERSESSION_H
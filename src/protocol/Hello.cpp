@@ -6,10 +6,21 @@
 // communicate with each other
 constexpr char CLIENT_HELLO[] = "CLIENT_HELLO";
 constexpr char SERVER_HELLO[] = "SERVER_HELLO";
-const qint64 PROTOCOL_VERSION = 1;
+// 2: Codec negotiation in the hellos.
+// 3: Content-addressed woice data.
+// 4: Undo horizon in the server hello.
+// 5: Batched add and delete primitives.
+// 6: Room name in the client hello.
+const qint64 PROTOCOL_VERSION = 6;
+const qint32 DEFAULT_UNDO_HORIZON = 1000;
 
-ClientHello::ClientHello(const QString &username)
-    : hello(CLIENT_HELLO), version(PROTOCOL_VERSION), m_username(username) {}
+ClientHello::ClientHello(const QString &username, const QList<qint8> &codecs,
+                         const QString &room)
+    : hello(CLIENT_HELLO),
+      version(PROTOCOL_VERSION),
+      m_username(username),
+      m_codecs(codecs),
+      m_room(room) {}
 
 bool ClientHello::isValid() {
   return (hello == CLIENT_HELLO) && (version == PROTOCOL_VERSION);
@@ -17,16 +28,29 @@ bool ClientHello::isValid() {
 
 QString ClientHello::username() { return m_username; }
 
+const QList<qint8> &ClientHello::codecs() { return m_codecs; }
+
+QString ClientHello::room() { return m_room; }
+
 QDataStream &operator<<(QDataStream &out, const ClientHello &m) {
-  return (out << m.hello << m.version << m.m_username);
+  return (out << m.hello << m.version << m.m_username << m.m_codecs
+              << m.m_room);
 }
 
+// Older clients stop after the username, so only read the codecs and room if
+// the versions match. They'd get rejected by isValid anyway.
 QDataStream &operator>>(QDataStream &in, ClientHello &m) {
-  return (in >> m.hello >> m.version >> m.m_username);
+  in >> m.hello >> m.version >> m.m_username;
+  if (m.version == PROTOCOL_VERSION) in >> m.m_codecs >> m.m_room;
+  return in;
 }
 
-ServerHello::ServerHello(qint64 uid)
-    : hello(SERVER_HELLO), version(PROTOCOL_VERSION), m_uid(uid) {}
+ServerHello::ServerHello(qint64 uid, WireCodec codec, qint32 undo_horizon)
+    : hello(SERVER_HELLO),
+      version(PROTOCOL_VERSION),
+      m_uid(uid),
+      m_codec(codec),
+      m_undo_horizon(undo_horizon) {}
 
 bool ServerHello::isValid() {
   return (hello == SERVER_HELLO && version == PROTOCOL_VERSION && m_uid != -1);
@@ -34,12 +58,18 @@ bool ServerHello::isValid() {
 
 qint64 ServerHello::uid() { return m_uid; }
 
+WireCodec ServerHello::codec() { return WireCodec(m_codec); }
+
+qint32 ServerHello::undoHorizon() { return m_undo_horizon; }
+
 QDataStream &operator<<(QDataStream &out, const ServerHello &m) {
   // qDebug() << "Sending server hello" << m.hello << m.version << m.m_uid;
-  return (out << m.hello << m.version << m.m_uid);
+  return (out << m.hello << m.version << m.m_uid << m.m_codec
+              << m.m_undo_horizon);
 }
 QDataStream &operator>>(QDataStream &in, ServerHello &m) {
-  (in >> m.hello >> m.version >> m.m_uid);
+  in >> m.hello >> m.version >> m.m_uid;
+  if (m.version == PROTOCOL_VERSION) in >> m.m_codec >> m.m_undo_horizon;
   // qDebug() << "Received server hello" << m.hello << m.version << m.m_uid;
   return in;
 }
@@ -2,18 +2,33 @@
 #define HELLO_H
 
 #include <QDataStream>
+#include <QList>
 extern const qint64 PROTOCOL_VERSION;
+// How many actions back a session keeps undo history for, unless the host
+// says otherwise.
+extern const qint32 DEFAULT_UNDO_HORIZON;
+
+// How actions are encoded after the hellos. The client offers the codecs it
+// supports and the server picks one. See WireCodec.h.
+enum WireCodec : qint8 { WIRE_DATASTREAM, WIRE_COMPACT, WIRE_COMPACT_DEFLATE };
 // Two classes to encapsulate the data sent between client and server on initial
 // connection.
 class ClientHello {
   QString hello;
   qint64 version;
   QString m_username;
+  QList<qint8> m_codecs;
+  QString m_room;
 
  public:
-  ClientHello(const QString &username = "");
+  ClientHello(const QString &username = "",
+              const QList<qint8> &codecs = {WIRE_DATASTREAM},
+              const QString &room = "");
   bool isValid();
   QString username();
+  const QList<qint8> &codecs();
+  // Which of the server's projects to join. Empty for the one it started with.
+  QString room();
   friend QDataStream &operator<<(QDataStream &out, const ClientHello &m);
   friend QDataStream &operator>>(QDataStream &in, ClientHello &m);
 };
@@ -25,11 +40,16 @@ class ServerHello {
   QString hello;
   qint64 version;
   qint64 m_uid;
+  qint8 m_codec;
+  qint32 m_undo_horizon;
 
  public:
-  ServerHello(qint64 uid = -1);
+  ServerHello(qint64 uid = -1, WireCodec codec = WIRE_DATASTREAM,
+              qint32 undo_horizon = DEFAULT_UNDO_HORIZON);
   bool isValid();
   qint64 uid();
+  WireCodec codec();
+  qint32 undoHorizon();
   friend QDataStream &operator<<(QDataStream &out, const ServerHello &m);
   friend QDataStream &operator>>(QDataStream &in, ServerHello &m);
 };
@@ -1,9 +1,23 @@
 #include "PxtoneEditAction.h"
 
 #include <QDebug>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
 namespace Action {
 
+static void extendMeasures(pxtnService *pxtn, bool *widthChanged,
+                           int end_clock) {
+  int clockPerMeas =
+      pxtn->master->get_beat_clock() * pxtn->master->get_beat_num();
+  int end_meas = end_clock / clockPerMeas;
+  if (end_meas >= pxtn->master->get_meas_num()) {
+    if (widthChanged) *widthChanged = true;
+    pxtn->master->set_meas_num(end_meas + 1);
+  }
+}
+
 void perform(const Primitive &a, pxtnService *pxtn, bool *widthChanged,
              const NoIdMap &unit_id_map, const NoIdMap &woice_id_map) {
   // if (a.kind == EVENTKIND_KEY) qDebug() << "Perform" << a;
@@ -24,14 +38,7 @@ void perform(const Primitive &a, pxtnService *pxtn, bool *widthChanged,
             // -1 since end is exclusive
             int end_clock = a.start_clock;
             if (Evelist_Kind_IsTail(a.kind)) end_clock += b.value - 1;
-
-            int clockPerMeas =
-                pxtn->master->get_beat_clock() * pxtn->master->get_beat_num();
-            int end_meas = end_clock / clockPerMeas;
-            if (end_meas >= pxtn->master->get_meas_num()) {
-              if (widthChanged) *widthChanged = true;
-              pxtn->master->set_meas_num(end_meas + 1);
-            }
+            extendMeasures(pxtn, widthChanged, end_clock);
           },
           [&](const Delete &b) {
             pxtn->evels->Record_Delete(a.start_clock, b.end_clock, unit_no,
@@ -40,16 +47,43 @@ void perform(const Primitive &a, pxtnService *pxtn, bool *widthChanged,
           [&](const Shift &b) {
             pxtn->evels->Record_Value_Change(a.start_clock, b.end_clock,
                                              unit_no, a.kind, b.offset);
+          },
+          [&](const AddBatch &b) {
+            if (b.events.empty()) return;
+            int end_clock = a.start_clock + b.events.back().first;
+            if (a.kind == EVENTKIND_VOICENO) {
+              std::vector<std::pair<qint32, qint32>> events;
+              events.reserve(b.events.size());
+              for (const auto &[offset, id] : b.events) {
+                std::optional<qint32> voice_no = woice_id_map.idToNo(id);
+                if (voice_no.has_value())
+                  events.emplace_back(offset, voice_no.value());
+              }
+              pxtn->evels->Record_Add_Batch(a.start_clock, unit_no, a.kind,
+                                            events);
+            } else {
+              pxtn->evels->Record_Add_Batch(a.start_clock, unit_no, a.kind,
+                                            b.events);
+              if (Evelist_Kind_IsTail(a.kind))
+                for (const auto &[offset, value] : b.events)
+                  end_clock =
+                      std::max(end_clock, a.start_clock + offset + value - 1);
+            }
+            extendMeasures(pxtn, widthChanged, end_clock);
+          },
+          [&](const DeleteBatch &b) {
+            pxtn->evels->Record_Delete_Batch(a.start_clock, unit_no, a.kind,
+                                             b.ranges);
           }},
       a.type);
 }
 
-std::list<Primitive> get_undo(const Primitive &a, const pxtnService *pxtn,
-                              const NoIdMap &unit_id_map,
-                              const NoIdMap &woice_id_map) {
-  std::list<Primitive> undo;
+// Appends the undo of [a] to [undo].
+void get_undo(const Primitive &a, const pxtnService *pxtn,
+              const NoIdMap &unit_id_map, const NoIdMap &woice_id_map,
+              std::vector<Primitive> &undo) {
   auto unit_no_maybe = unit_id_map.idToNo(a.unit_id);
-  if (unit_no_maybe == std::nullopt) return undo;
+  if (unit_no_maybe == std::nullopt) return;
   qint32 unit_no = unit_no_maybe.value();
 
   std::visit(
@@ -106,26 +140,160 @@ std::list<Primitive> get_undo(const Primitive &a, const pxtnService *pxtn,
             // with your undo.
             undo.push_back({a.kind, a.unit_id, a.start_clock,
                             Shift{b.end_clock, -b.offset}});
+          },
+          [&](const AddBatch &b) {
+            DeleteBatch d;
+            bool tail = Evelist_Kind_IsTail(a.kind);
+            for (const auto &[offset, value] : b.events) {
+              qint32 end = offset + (tail ? std::max(value, 1) : 1);
+              if (!d.ranges.empty() && offset <= d.ranges.back().second)
+                d.ranges.back().second = std::max(d.ranges.back().second, end);
+              else
+                d.ranges.emplace_back(offset, end);
+            }
+            if (!d.ranges.empty())
+              undo.push_back({a.kind, a.unit_id, a.start_clock, std::move(d)});
+          },
+          [&](const DeleteBatch &b) {
+            // Like Delete, but re-adding a truncated note replaces it, so it
+            // doesn't need deleting first.
+            AddBatch add;
+            bool tail = Evelist_Kind_IsTail(a.kind);
+            size_t i = 0;
+            for (const EVERECORD *p = pxtn->evels->get_Records();
+                 p && i < b.ranges.size();) {
+              qint32 start = a.start_clock + b.ranges[i].first;
+              if (p->clock >= a.start_clock + b.ranges[i].second) {
+                ++i;
+                continue;
+              }
+              if (a.kind == p->kind && unit_no == p->unit_no &&
+                  (p->clock >= start ||
+                   (tail && p->clock + p->value > start))) {
+                qint32 value = p->value;
+                if (a.kind == EVENTKIND_VOICENO)
+                  value = woice_id_map.noToId(value);
+                add.events.emplace_back(p->clock - a.start_clock, value);
+              }
+              p = p->next;
+            }
+            if (!add.events.empty())
+              undo.push_back(
+                  {a.kind, a.unit_id, a.start_clock, std::move(add)});
           }},
       a.type);
 
   // for (const auto &a : undo) {
   //  if (a.kind == EVENTKIND_KEY) qDebug() << "Compute undo" << a;
   //}
-  return undo;
 }
 
-std::list<Primitive> apply_and_get_undo(const std::list<Primitive> &actions,
-                                        pxtnService *pxtn, bool *widthChanged,
-                                        const NoIdMap &unit_id_map,
-                                        const NoIdMap &woice_id_map) {
-  std::list<Primitive> undo;
+void apply_and_get_undo(const std::vector<Primitive> &actions,
+                        pxtnService *pxtn, bool *widthChanged,
+                        const NoIdMap &unit_id_map, const NoIdMap &woice_id_map,
+                        std::vector<Primitive> &undo) {
+  // Each primitive's undo goes before those of the primitives before it.
+  // Build it back to front by reversing each one's undo as it's appended,
+  // then reversing the lot.
+  undo.clear();
   for (const Primitive &a : actions) {
-    undo.splice(undo.begin(), get_undo(a, pxtn, unit_id_map, woice_id_map));
+    size_t start = undo.size();
+    get_undo(a, pxtn, unit_id_map, woice_id_map, undo);
+    std::reverse(undo.begin() + start, undo.end());
     perform(a, pxtn, widthChanged, unit_id_map, woice_id_map);
   }
+  std::reverse(undo.begin(), undo.end());
+}
+
+std::vector<Primitive> apply_and_get_undo(const std::vector<Primitive> &actions,
+                                          pxtnService *pxtn, bool *widthChanged,
+                                          const NoIdMap &unit_id_map,
+                                          const NoIdMap &woice_id_map) {
+  std::vector<Primitive> undo;
+  apply_and_get_undo(actions, pxtn, widthChanged, unit_id_map, woice_id_map,
+                     undo);
   return undo;
 }
+Footprint::Footprint(const std::vector<Primitive> &actions) {
+  for (const Primitive &a : actions) add(a);
+}
+
+void Footprint::add(const Primitive &a) {
+  bool tail = Evelist_Kind_IsTail(a.kind);
+  constexpr qint64 MAX_CLOCK = std::numeric_limits<qint32>::max();
+  qint64 start = a.start_clock, end = start + 1;
+  std::visit(overloaded{[&](const Add &b) {
+                          if (tail) end = start + std::max(b.value, 1);
+                        },
+                        // Deletes also truncate notes that cross [start], but
+                        // those notes' own footprints cover that.
+                        [&](const Delete &b) {
+                          end = std::max(qint64(b.end_clock), end);
+                        },
+                        // Changing a note's length can stretch it anywhere to
+                        // the right.
+                        [&](const Shift &b) {
+                          end = (tail ? MAX_CLOCK
+                                      : std::max(qint64(b.end_clock), end));
+                        },
+                        // Batches get one range spanning all of them.
+                        [&](const AddBatch &b) {
+                          if (b.events.empty()) return;
+                          for (const auto &[offset, value] : b.events)
+                            end = std::max(
+                                end, start + offset +
+                                         (tail ? std::max(value, 1) : 1));
+                          start += b.events.front().first;
+                        },
+                        [&](const DeleteBatch &b) {
+                          if (b.ranges.empty()) return;
+                          end = start + b.ranges.back().second;
+                          start += b.ranges.front().first;
+                        }},
+             a.type);
+  addRange(m_ranges[{a.unit_id, a.kind}], qint32(start),
+           qint32(std::min(end, MAX_CLOCK)));
+}
+
+void Footprint::add(const Footprint &f) {
+  for (const auto &[key, ranges] : f.m_ranges) {
+    std::map<qint32, qint32> &mine = m_ranges[key];
+    for (const auto &[start, end] : ranges) addRange(mine, start, end);
+  }
+}
+
+void Footprint::addRange(std::map<qint32, qint32> &ranges, qint32 start,
+                         qint32 end) {
+  // Merge with anything overlapping or touching [start, end).
+  auto it = ranges.upper_bound(start);
+  if (it != ranges.begin() && std::prev(it)->second >= start) --it;
+  while (it != ranges.end() && it->first <= end) {
+    start = std::min(start, it->first);
+    end = std::max(end, it->second);
+    it = ranges.erase(it);
+  }
+  ranges.emplace(start, end);
+}
+
+static bool overlaps(const std::map<qint32, qint32> &ranges, qint32 start,
+                     qint32 end) {
+  auto it = ranges.upper_bound(start);
+  if (it != ranges.begin() && std::prev(it)->second > start) return true;
+  return it != ranges.end() && it->first < end;
+}
+
+bool Footprint::intersects(const Footprint &f) const {
+  const Footprint &small = (m_ranges.size() <= f.m_ranges.size() ? *this : f);
+  const Footprint &large = (&small == this ? f : *this);
+  for (const auto &[key, ranges] : small.m_ranges) {
+    auto other = large.m_ranges.find(key);
+    if (other == large.m_ranges.end()) continue;
+    for (const auto &[start, end] : ranges)
+      if (overlaps(other->second, start, end)) return true;
+  }
+  return false;
+}
+
 QDataStream &operator<<(QDataStream &out, const Add &a) {
   return (out << a.value);
 }
@@ -143,6 +311,56 @@ QDataStream &operator>>(QDataStream &in, Shift &a) {
   return (in >> a.offset >> a.end_clock);
 }
 
+bool isWellFormed(const AddBatch &a) {
+  for (size_t i = 1; i < a.events.size(); ++i)
+    if (a.events[i].first < a.events[i - 1].first) return false;
+  return true;
+}
+bool isWellFormed(const DeleteBatch &a) {
+  for (size_t i = 0; i < a.ranges.size(); ++i) {
+    if (a.ranges[i].second <= a.ranges[i].first) return false;
+    if (i > 0 && a.ranges[i].first < a.ranges[i - 1].second) return false;
+  }
+  return true;
+}
+
+static QDataStream &writePairs(
+    QDataStream &out, const std::vector<std::pair<qint32, qint32>> &pairs) {
+  out << quint64(pairs.size());
+  for (const auto &[first, second] : pairs) out << first << second;
+  return out;
+}
+static QDataStream &readPairs(QDataStream &in,
+                              std::vector<std::pair<qint32, qint32>> &pairs) {
+  quint64 size;
+  in >> size;
+  pairs.clear();
+  for (quint64 i = 0; i < size && in.status() == QDataStream::Ok; ++i) {
+    qint32 first, second;
+    in >> first >> second;
+    pairs.emplace_back(first, second);
+  }
+  return in;
+}
+QDataStream &operator<<(QDataStream &out, const AddBatch &a) {
+  return writePairs(out, a.events);
+}
+QDataStream &operator>>(QDataStream &in, AddBatch &a) {
+  readPairs(in, a.events);
+  if (in.status() == QDataStream::Ok && !isWellFormed(a))
+    throw std::runtime_error("malformed batch");
+  return in;
+}
+QDataStream &operator<<(QDataStream &out, const DeleteBatch &a) {
+  return writePairs(out, a.ranges);
+}
+QDataStream &operator>>(QDataStream &in, DeleteBatch &a) {
+  readPairs(in, a.ranges);
+  if (in.status() == QDataStream::Ok && !isWellFormed(a))
+    throw std::runtime_error("malformed batch");
+  return in;
+}
+
 QDataStream &operator<<(QDataStream &out, const Primitive &a) {
   out << qint8(a.kind) << a.unit_id << a.start_clock << a.type;
   return out;
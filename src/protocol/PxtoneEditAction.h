@@ -4,8 +4,10 @@
 #include <QDataStream>
 #include <QDebug>
 #include <QList>
+#include <map>
 #include <optional>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "NoIdMap.h"
@@ -62,11 +64,35 @@ inline QTextStream &operator<<(QTextStream &out, const Shift &a) {
   out << "Shift(" << a.end_clock << ", " << a.offset << ")";
   return out;
 }
+// Bulk versions of Add and Delete, applied in one pass over the event list
+// rather than one per event, e.g. for pastes.
+//
+// Adds (offset, value) events at start_clock + offset. Offsets are ascending.
+struct AddBatch {
+  std::vector<std::pair<qint32, qint32>> events;
+};
+inline QTextStream &operator<<(QTextStream &out, const AddBatch &a) {
+  out << "AddBatch(" << a.events.size() << ")";
+  return out;
+}
+// Deletes each [start_clock + start, start_clock + end). Ranges are non-empty,
+// ascending and disjoint.
+struct DeleteBatch {
+  std::vector<std::pair<qint32, qint32>> ranges;
+};
+inline QTextStream &operator<<(QTextStream &out, const DeleteBatch &a) {
+  out << "DeleteBatch(" << a.ranges.size() << ")";
+  return out;
+}
+// Whether a batch is ordered the way applying it assumes. Batches are checked
+// as they're read.
+bool isWellFormed(const AddBatch &a);
+bool isWellFormed(const DeleteBatch &a);
 struct Primitive {
   EVENTKIND kind;
   qint32 unit_id;
   qint32 start_clock;
-  std::variant<Add, Delete, Shift> type;
+  std::variant<Add, Delete, Shift, AddBatch, DeleteBatch> type;
 };
 inline QTextStream &operator<<(QTextStream &out, const Primitive &a) {
   out << "Primitive(" << EVENTKIND_names[a.kind] << ", u" << a.unit_id << ", "
@@ -76,12 +102,36 @@ inline QTextStream &operator<<(QTextStream &out, const Primitive &a) {
 QDataStream &operator<<(QDataStream &out, const Primitive &a);
 QDataStream &operator>>(QDataStream &in, Primitive &a);
 
+// The (unit, kind, clock range) cells a list of primitives can read or write.
+// Applying two lists whose footprints don't intersect gives the same result in
+// either order, so e.g. an undo doesn't have to roll back edits elsewhere.
+class Footprint {
+ public:
+  Footprint() {}
+  explicit Footprint(const std::vector<Primitive> &actions);
+  void add(const Primitive &a);
+  void add(const Footprint &f);
+  bool intersects(const Footprint &f) const;
+  bool empty() const { return m_ranges.empty(); }
+
+ private:
+  // Disjoint [start, end) clock ranges by start, for each (unit id, kind).
+  std::map<std::pair<qint32, EVENTKIND>, std::map<qint32, qint32>> m_ranges;
+  void addRange(std::map<qint32, qint32> &ranges, qint32 start, qint32 end);
+};
+
 // You have to compute the undo at the time the original action was applied in
 // the case of collaborative editing. You can't compute it beforehand.
-std::list<Primitive> apply_and_get_undo(const std::list<Primitive> &actions,
-                                        pxtnService *pxtn, bool *widthChanged,
-                                        const NoIdMap &unit_id_map,
-                                        const NoIdMap &woice_id_map);
+std::vector<Primitive> apply_and_get_undo(const std::vector<Primitive> &actions,
+                                          pxtnService *pxtn, bool *widthChanged,
+                                          const NoIdMap &unit_id_map,
+                                          const NoIdMap &woice_id_map);
+// The same, but writing the undo into [undo] so that its storage can be
+// reused. [undo] must not be [actions].
+void apply_and_get_undo(const std::vector<Primitive> &actions,
+                        pxtnService *pxtn, bool *widthChanged,
+                        const NoIdMap &unit_id_map, const NoIdMap &woice_id_map,
+                        std::vector<Primitive> &undo);
 }  // namespace Action
 
 #endif  // PXTONEEDITACTION_H
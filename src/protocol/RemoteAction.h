@@ -5,6 +5,7 @@
 #include <QCryptographicHash>
 #include <QDataStream>
 #include <QDateTime>
+#include <utility>
 #include <variant>
 #include <vector>
 
@@ -19,7 +20,7 @@ inline QDataStream &operator>>(QDataStream &in, std::monostate &) { return in; }
 
 struct EditAction {
   qint64 idx;
-  std::list<Action::Primitive> action;
+  std::vector<Action::Primitive> action;
 };
 inline QDataStream &operator<<(QDataStream &out, const EditAction &a) {
   out << a.idx << quint64(a.action.size());
@@ -136,18 +137,24 @@ inline QTextStream &operator<<(QTextStream &out, const SetUnitName &a) {
   return out;
 }
 
+// Woice data is content-addressed so that each sample only needs to cross
+// the wire (and sit in the server's memory) once per session. [hash] is
+// filled in by the client when sending. [data] may be left empty on the wire
+// if the receiver is known to have the blob already; the network layer fills
+// it back in before anything else sees the action.
 struct AddWoice {
   pxtnWOICETYPE type;
   QString name;
   QByteArray data;
+  QByteArray hash;
 };
 inline QDataStream &operator<<(QDataStream &out, const AddWoice &a) {
-  out << (qint8)a.type << a.name << a.data;
+  out << (qint8)a.type << a.name << a.data << a.hash;
   return out;
 }
 inline QDataStream &operator>>(QDataStream &in, AddWoice &a) {
   read_as_qint8(in, a.type);
-  in >> a.name >> a.data;
+  in >> a.name >> a.data >> a.hash;
   return in;
 }
 
@@ -161,6 +168,10 @@ inline QByteArray hashData(const QByteArray &data) {
   return hash;
 }
 
+inline QByteArray blobHash(const QByteArray &data) {
+  return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
 inline QTextStream &operator<<(QTextStream &out, const AddWoice &a) {
   out << "AddWoice(unit_id=" << pxtnWOICETYPE_names[a.type]
       << ", name=" << a.name << ", data=(" << a.data.length() << ")"
@@ -467,22 +478,51 @@ inline QTextStream &operator<<(QTextStream &out, const WatchUser &a) {
   return out;
 }
 
+// Asks the server for woice blobs the client doesn't have cached. Only sent
+// when joining; the server isn't expected to broadcast it.
+struct FetchBlobs {
+  QList<QByteArray> hashes;
+};
+inline QDataStream &operator<<(QDataStream &out, const FetchBlobs &a) {
+  out << a.hashes;
+  return out;
+}
+inline QDataStream &operator>>(QDataStream &in, FetchBlobs &a) {
+  in >> a.hashes;
+  return in;
+}
+inline QTextStream &operator<<(QTextStream &out, const FetchBlobs &a) {
+  out << "FetchBlobs(" << a.hashes.size() << ")";
+  return out;
+}
+
 using ClientAction =
     std::variant<EditAction, EditState, UndoRedo, AddUnit, RemoveUnit, MoveUnit,
                  AddWoice, RemoveWoice, ChangeWoice, TempoChange, BeatChange,
                  SetRepeatMeas, SetLastMeas, SetUnitName, Overdrive::Add,
                  Overdrive::Set, Overdrive::Remove, Delay::Set, Woice::Set,
-                 Ping, PlayState, WatchUser>;
+                 Ping, PlayState, WatchUser, FetchBlobs>;
 inline bool clientActionShouldBeRecorded(const ClientAction &a) {
   bool ret;
   std::visit(overloaded{[&ret](const EditState &) { ret = false; },
                         [&ret](const Ping &) { ret = false; },
                         [&ret](const PlayState &) { ret = false; },
+                        [&ret](const FetchBlobs &) { ret = false; },
                         [&ret](const auto &) { ret = true; }},
              a);
   return ret;
 }
 
+// The woice data carried by [a], if any.
+inline const AddWoice *woiceData(const ClientAction &a) {
+  if (const AddWoice *w = std::get_if<AddWoice>(&a)) return w;
+  if (const ChangeWoice *w = std::get_if<ChangeWoice>(&a)) return &w->add;
+  return nullptr;
+}
+inline AddWoice *woiceData(ClientAction &a) {
+  return const_cast<AddWoice *>(woiceData(std::as_const(a)));
+}
+
 struct NewSession {
   QString username;
 };
@@ -504,9 +544,29 @@ inline QTextStream &operator<<(QTextStream &out, const DeleteSession &) {
   out << "DeleteSession()";
   return out;
 }
+
+// A woice blob sent in reply to [FetchBlobs]. [data] is empty if the server
+// doesn't have it.
+struct BlobData {
+  QByteArray hash;
+  QByteArray data;
+};
+inline QDataStream &operator<<(QDataStream &out, const BlobData &a) {
+  out << a.hash << a.data;
+  return out;
+}
+inline QDataStream &operator>>(QDataStream &in, BlobData &a) {
+  in >> a.hash >> a.data;
+  return in;
+}
+inline QTextStream &operator<<(QTextStream &out, const BlobData &a) {
+  out << "BlobData(" << hashData(a.hash) << ", " << a.data.size() << ")";
+  return out;
+}
+
 struct ServerAction {
   qint64 uid;
-  std::variant<ClientAction, NewSession, DeleteSession> action;
+  std::variant<ClientAction, NewSession, DeleteSession, BlobData> action;
   bool shouldBeRecorded() const {
     // TODO: instead of using this to track history, have the broadcast server
     // update its own internal state (similar to the synchronizer) and return
@@ -515,12 +575,22 @@ struct ServerAction {
     std::visit(overloaded{[&ret](const ClientAction &a) {
                             ret = clientActionShouldBeRecorded(a);
                           },
+                          [&ret](const BlobData &) { ret = false; },
                           [&ret](const auto &) { ret = true; }},
                action);
     return ret;
   }
 };
 
+inline const AddWoice *woiceData(const ServerAction &a) {
+  if (const ClientAction *c = std::get_if<ClientAction>(&a.action))
+    return woiceData(*c);
+  return nullptr;
+}
+inline AddWoice *woiceData(ServerAction &a) {
+  return const_cast<AddWoice *>(woiceData(std::as_const(a)));
+}
+
 inline QDataStream &operator<<(QDataStream &out, const ServerAction &a) {
   out << a.uid << a.action;
   return out;
@@ -0,0 +1,463 @@
+#include "WireCodec.h"
+
+#include <limits>
+#include <stdexcept>
+
+namespace {
+// Whole files are the largest thing sent in one frame; this is just a guard
+// against allocating whatever a corrupt length prefix says.
+constexpr quint64 MAX_FRAME_SIZE = 256 * 1024 * 1024;
+constexpr int DEFLATE_MIN_SIZE = 256;
+constexpr int DEFLATE_LEVEL = 6;
+
+template <typename Variant, typename T, size_t I = 0>
+constexpr size_t variant_index() {
+  if constexpr (std::is_same_v<std::variant_alternative_t<I, Variant>, T>)
+    return I;
+  else
+    return variant_index<Variant, T, I + 1>();
+}
+constexpr size_t EDIT_ACTION_INDEX = variant_index<ClientAction, EditAction>();
+constexpr size_t CLIENT_ACTION_INDEX =
+    variant_index<decltype(ServerAction::action), ClientAction>();
+
+quint64 zigzag(qint64 v) { return (quint64(v) << 1) ^ quint64(v >> 63); }
+qint64 unzigzag(quint64 v) { return qint64(v >> 1) ^ -qint64(v & 1); }
+
+void putVarint(QByteArray &buf, quint64 v) {
+  while (v >= 0x80) {
+    buf.append(char((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  buf.append(char(v));
+}
+void putSigned(QByteArray &buf, qint64 v) { putVarint(buf, zigzag(v)); }
+
+class Reader {
+ public:
+  Reader(const QByteArray &buf) : m_buf(buf), m_pos(0) {}
+  quint8 byte() {
+    if (m_pos >= m_buf.size()) throw std::runtime_error("truncated frame");
+    return quint8(m_buf[m_pos++]);
+  }
+  quint64 varint() {
+    quint64 v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      quint8 b = byte();
+      v |= quint64(b & 0x7f) << shift;
+      if (!(b & 0x80)) return v;
+    }
+    throw std::runtime_error("varint too long");
+  }
+  qint64 signedVarint() { return unzigzag(varint()); }
+  int remaining() const { return m_buf.size() - m_pos; }
+  // What's left of the frame, for alternatives sent as QDataStream.
+  QByteArray rest() const {
+    return QByteArray::fromRawData(m_buf.constData() + m_pos,
+                                   m_buf.size() - m_pos);
+  }
+
+ private:
+  const QByteArray &m_buf;
+  int m_pos;
+};
+
+qint32 checked32(qint64 v) {
+  if (v < std::numeric_limits<qint32>::min() ||
+      v > std::numeric_limits<qint32>::max())
+    throw std::runtime_error("value out of range");
+  return qint32(v);
+}
+
+template <typename T>
+void putFallback(QByteArray &buf, const T &v) {
+  QDataStream s(&buf, QIODevice::WriteOnly | QIODevice::Append);
+  s.setVersion(QDataStream::Qt_5_5);
+  s << v;
+}
+
+template <typename Variant>
+void readFallback(Reader &r, size_t index, Variant &v) {
+  QByteArray rest = r.rest();
+  QDataStream s(rest);
+  s.setVersion(QDataStream::Qt_5_5);
+  ::detail::variant_switch<std::variant_size_v<Variant> - 1>{}(index, s, v);
+  if (s.status() != QDataStream::Ok)
+    throw std::runtime_error("malformed action");
+}
+
+// Batch entries are delta-encoded against the previous entry: values for
+// adds, and ends against their own start for deletes.
+void putBatch(QByteArray &buf, const std::vector<std::pair<qint32, qint32>> &a,
+              bool ranges) {
+  putVarint(buf, a.size());
+  qint64 last_first = 0, last_second = 0;
+  for (const auto &[first, second] : a) {
+    putSigned(buf, first - last_first);
+    putSigned(buf, second - (ranges ? first : last_second));
+    last_first = first;
+    last_second = second;
+  }
+}
+
+std::vector<std::pair<qint32, qint32>> readBatch(Reader &r, bool ranges) {
+  quint64 size = r.varint();
+  // Each entry takes at least two bytes.
+  if (size > quint64(r.remaining()) / 2)
+    throw std::runtime_error("truncated frame");
+  std::vector<std::pair<qint32, qint32>> a;
+  a.reserve(size);
+  qint64 last_first = 0, last_second = 0;
+  for (quint64 i = 0; i < size; ++i) {
+    qint32 first = checked32(last_first + r.signedVarint());
+    qint32 second =
+        checked32((ranges ? first : last_second) + r.signedVarint());
+    a.emplace_back(first, second);
+    last_first = first;
+    last_second = second;
+  }
+  return a;
+}
+
+bool sameRun(const Action::Primitive &a, const Action::Primitive &b) {
+  return a.kind == b.kind && a.unit_id == b.unit_id &&
+         a.type.index() == b.type.index();
+}
+
+void putEditAction(QByteArray &buf, const EditAction &a) {
+  putSigned(buf, a.idx);
+
+  // Runs keep the primitives in order since the order they're applied in
+  // matters; edits tend to come out grouped by unit and kind anyway.
+  std::vector<std::pair<std::vector<Action::Primitive>::const_iterator, size_t>>
+      runs;
+  for (auto it = a.action.begin(); it != a.action.end(); ++it) {
+    if (runs.empty() || !sameRun(*runs.back().first, *it))
+      runs.emplace_back(it, 0);
+    ++runs.back().second;
+  }
+
+  putVarint(buf, runs.size());
+  qint64 last_unit = 0, last_clock = 0;
+  for (const auto &[start, size] : runs) {
+    buf.append(char(start->kind));
+    putSigned(buf, start->unit_id - last_unit);
+    buf.append(char(start->type.index()));
+    putVarint(buf, size);
+    last_unit = start->unit_id;
+
+    qint64 last_value = 0;
+    auto it = start;
+    for (size_t i = 0; i < size; ++i, ++it) {
+      const Action::Primitive &p = *it;
+      putSigned(buf, p.start_clock - last_clock);
+      last_clock = p.start_clock;
+      std::visit(overloaded{[&](const Action::Add &t) {
+                              putSigned(buf, t.value - last_value);
+                              last_value = t.value;
+                            },
+                            [&](const Action::Delete &t) {
+                              putSigned(buf, t.end_clock - last_clock);
+                            },
+                            [&](const Action::Shift &t) {
+                              putSigned(buf, t.end_clock - last_clock);
+                              putSigned(buf, t.offset);
+                            },
+                            [&](const Action::AddBatch &t) {
+                              putBatch(buf, t.events, false);
+                            },
+                            [&](const Action::DeleteBatch &t) {
+                              putBatch(buf, t.ranges, true);
+                            }},
+                 p.type);
+    }
+  }
+}
+
+EditAction readEditAction(Reader &r) {
+  EditAction a;
+  a.idx = r.signedVarint();
+
+  quint64 runs = r.varint();
+  qint64 last_unit = 0, last_clock = 0;
+  for (quint64 i = 0; i < runs; ++i) {
+    quint8 kind = r.byte();
+    if (kind >= EVENTKIND_NUM) throw std::runtime_error("invalid event kind");
+    qint32 unit_id = checked32(last_unit + r.signedVarint());
+    quint8 type = r.byte();
+    quint64 size = r.varint();
+    last_unit = unit_id;
+
+    qint64 last_value = 0;
+    for (quint64 j = 0; j < size; ++j) {
+      Action::Primitive p{EVENTKIND(kind), unit_id,
+                          checked32(last_clock + r.signedVarint()),
+                          Action::Add{0}};
+      last_clock = p.start_clock;
+      switch (type) {
+        case 0:
+          last_value = checked32(last_value + r.signedVarint());
+          p.type = Action::Add{qint32(last_value)};
+          break;
+        case 1:
+          p.type = Action::Delete{checked32(p.start_clock + r.signedVarint())};
+          break;
+        case 2: {
+          qint32 end_clock = checked32(p.start_clock + r.signedVarint());
+          p.type = Action::Shift{end_clock, checked32(r.signedVarint())};
+          break;
+        }
+        case 3: {
+          Action::AddBatch batch{readBatch(r, false)};
+          if (!Action::isWellFormed(batch))
+            throw std::runtime_error("malformed batch");
+          p.type = std::move(batch);
+          break;
+        }
+        case 4: {
+          Action::DeleteBatch batch{readBatch(r, true)};
+          if (!Action::isWellFormed(batch))
+            throw std::runtime_error("malformed batch");
+          p.type = std::move(batch);
+          break;
+        }
+        default:
+          throw std::runtime_error("invalid primitive type");
+      }
+      a.action.push_back(std::move(p));
+    }
+  }
+  return a;
+}
+
+void putClientAction(QByteArray &buf, const ClientAction &a) {
+  buf.append(char(a.index()));
+  std::visit(overloaded{[&buf](const EditAction &e) { putEditAction(buf, e); },
+                        [&buf](const auto &v) { putFallback(buf, v); }},
+             a);
+}
+
+void readClientAction(Reader &r, ClientAction &a) {
+  size_t index = r.byte();
+  if (index == EDIT_ACTION_INDEX)
+    a = readEditAction(r);
+  else
+    readFallback(r, index, a);
+}
+
+void putServerAction(QByteArray &buf, const ServerAction &a) {
+  putSigned(buf, a.uid);
+  buf.append(char(a.action.index()));
+  std::visit(
+      overloaded{[&buf](const ClientAction &c) { putClientAction(buf, c); },
+                 [&buf](const auto &v) { putFallback(buf, v); }},
+      a.action);
+}
+
+void readServerAction(Reader &r, ServerAction &a) {
+  a.uid = r.signedVarint();
+  size_t index = r.byte();
+  if (index == CLIENT_ACTION_INDEX) {
+    ClientAction c;
+    readClientAction(r, c);
+    a.action = c;
+  } else
+    readFallback(r, index, a.action);
+}
+
+// With deflate, the low bit of the length says whether the payload is
+// compressed. Small frames like edit states and pings are left alone since
+// deflating them only adds overhead.
+void writeFrame(QDataStream &out, const QByteArray &payload, bool deflate) {
+  QByteArray frame;
+  if (deflate) {
+    QByteArray compressed;
+    if (payload.size() >= DEFLATE_MIN_SIZE)
+      compressed = qCompress(payload, DEFLATE_LEVEL);
+    bool use_compressed =
+        !compressed.isEmpty() && compressed.size() < payload.size();
+    const QByteArray &data = (use_compressed ? compressed : payload);
+    frame.reserve(data.size() + 5);
+    putVarint(frame, (quint64(data.size()) << 1) | (use_compressed ? 1 : 0));
+    frame.append(data);
+  } else {
+    frame.reserve(payload.size() + 5);
+    putVarint(frame, payload.size());
+    frame.append(payload);
+  }
+  out.writeRawData(frame.constData(), frame.size());
+}
+
+// Returns false if the whole frame isn't available yet.
+bool readFrame(QDataStream &in, QByteArray &payload, bool deflate) {
+  quint64 size = 0;
+  for (int shift = 0;; shift += 7) {
+    if (shift >= 64) throw std::runtime_error("invalid frame length");
+    quint8 b;
+    in >> b;
+    if (in.status() != QDataStream::Ok) return false;
+    size |= quint64(b & 0x7f) << shift;
+    if (!(b & 0x80)) break;
+  }
+  bool compressed = false;
+  if (deflate) {
+    compressed = (size & 1);
+    size >>= 1;
+  }
+  if (size > MAX_FRAME_SIZE) throw std::runtime_error("frame too large");
+  payload.resize(int(size));
+  if (in.readRawData(payload.data(), int(size)) != int(size)) {
+    in.setStatus(QDataStream::ReadPastEnd);
+    return false;
+  }
+  if (compressed) {
+    // qCompress prefixes the uncompressed size, which qUncompress trusts.
+    if (payload.size() < 4) throw std::runtime_error("truncated frame");
+    const uchar *p = reinterpret_cast<const uchar *>(payload.constData());
+    quint64 uncompressed_size = (quint64(p[0]) << 24) | (quint64(p[1]) << 16) |
+                                (quint64(p[2]) << 8) | quint64(p[3]);
+    if (uncompressed_size > MAX_FRAME_SIZE)
+      throw std::runtime_error("frame too large");
+    payload = qUncompress(payload);
+    if (payload.size() != int(uncompressed_size))
+      throw std::runtime_error("could not decompress frame");
+  }
+  return true;
+}
+
+void writeHistory(QDataStream &out, const QList<ServerAction> &a) {
+  out << quint32(a.size());
+  QByteArray payload;
+  for (const ServerAction &s : a) {
+    payload.clear();
+    putServerAction(payload, s);
+    writeFrame(out, payload, false);
+  }
+}
+
+void readHistory(QDataStream &in, QList<ServerAction> &a) {
+  quint32 size;
+  in >> size;
+  if (in.status() != QDataStream::Ok) return;
+  a.clear();
+  QByteArray payload;
+  for (quint32 i = 0; i < size; ++i) {
+    if (!readFrame(in, payload, false)) return;
+    Reader r(payload);
+    ServerAction s;
+    readServerAction(r, s);
+    a.push_back(s);
+  }
+}
+
+bool isCompact(WireCodec codec) {
+  return codec == WIRE_COMPACT || codec == WIRE_COMPACT_DEFLATE;
+}
+bool deflates(WireCodec codec) { return codec == WIRE_COMPACT_DEFLATE; }
+}  // namespace
+
+namespace Wire {
+QList<qint8> supportedCodecs() {
+  return {WIRE_COMPACT_DEFLATE, WIRE_COMPACT, WIRE_DATASTREAM};
+}
+
+WireCodec negotiate(const QList<qint8> &offered) {
+  for (qint8 c : offered)
+    if (c == WIRE_DATASTREAM || isCompact(WireCodec(c))) return WireCodec(c);
+  return WIRE_DATASTREAM;
+}
+
+QByteArray encodeCompact(const ClientAction &a) {
+  QByteArray payload;
+  putClientAction(payload, a);
+  return payload;
+}
+
+QByteArray encodeCompact(const ServerAction &a) {
+  QByteArray payload;
+  putServerAction(payload, a);
+  return payload;
+}
+
+void write(QDataStream &out, WireCodec codec, const ClientAction &a) {
+  if (isCompact(codec))
+    writeFrame(out, encodeCompact(a), deflates(codec));
+  else
+    out << a;
+}
+
+void write(QDataStream &out, WireCodec codec, const ServerAction &a) {
+  if (isCompact(codec))
+    writeFrame(out, encodeCompact(a), deflates(codec));
+  else
+    out << a;
+}
+
+void write(QDataStream &out, WireCodec codec, const QList<ServerAction> &a) {
+  if (!isCompact(codec))
+    out << a;
+  else if (!deflates(codec))
+    writeHistory(out, a);
+  else {
+    // The whole history goes in one frame so that the many small actions in
+    // it get compressed together.
+    QByteArray history;
+    QDataStream history_out(&history, QIODevice::WriteOnly);
+    history_out.setVersion(QDataStream::Qt_5_5);
+    writeHistory(history_out, a);
+    writeFrame(out, history, true);
+  }
+}
+
+void writeFile(QDataStream &out, WireCodec codec, const QByteArray &data) {
+  if (deflates(codec))
+    writeFrame(out, data, true);
+  else
+    out << data;
+}
+
+void read(QDataStream &in, WireCodec codec, ClientAction &a) {
+  if (!isCompact(codec)) {
+    in >> a;
+    return;
+  }
+  QByteArray payload;
+  if (!readFrame(in, payload, deflates(codec))) return;
+  Reader r(payload);
+  readClientAction(r, a);
+}
+
+void read(QDataStream &in, WireCodec codec, ServerAction &a) {
+  if (!isCompact(codec)) {
+    in >> a;
+    return;
+  }
+  QByteArray payload;
+  if (!readFrame(in, payload, deflates(codec))) return;
+  Reader r(payload);
+  readServerAction(r, a);
+}
+
+void read(QDataStream &in, WireCodec codec, QList<ServerAction> &a) {
+  if (!isCompact(codec))
+    in >> a;
+  else if (!deflates(codec))
+    readHistory(in, a);
+  else {
+    QByteArray history;
+    if (!readFrame(in, history, true)) return;
+    QDataStream history_in(history);
+    history_in.setVersion(QDataStream::Qt_5_5);
+    readHistory(history_in, a);
+    if (history_in.status() != QDataStream::Ok)
+      throw std::runtime_error("truncated history");
+  }
+}
+
+void readFile(QDataStream &in, WireCodec codec, QByteArray &data) {
+  if (deflates(codec))
+    readFrame(in, data, true);
+  else
+    in >> data;
+}
+}  // namespace Wire
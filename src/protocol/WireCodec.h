@@ -0,0 +1,50 @@
+#ifndef WIRECODEC_H
+#define WIRECODEC_H
+
+#include <QDataStream>
+#include <QList>
+
+#include "protocol/Hello.h"
+#include "protocol/RemoteAction.h"
+
+// Reading and writing actions on the wire in whichever codec the client and
+// server agreed on in their hellos.
+//
+// WIRE_DATASTREAM is the plain QDataStream encoding that recordings also use.
+// WIRE_COMPACT sends each action as a frame: a varint payload length followed
+// by the payload. Tags are single bytes, integers are zigzag varints, and edit
+// actions are sent as runs of primitives sharing a unit, kind and type, with
+// clocks and values delta-encoded within a run. Everything else falls back to
+// the QDataStream encoding inside the frame.
+//
+// WIRE_COMPACT_DEFLATE is the same, except that frames large enough to be
+// worth it are deflated, and the initial file and history each go in one
+// deflated frame. That's mostly for joining sample-heavy projects over slow
+// uplinks.
+namespace Wire {
+
+// Codecs this build can speak, most preferred first.
+QList<qint8> supportedCodecs();
+// Picks the first of [offered] that this build can speak.
+WireCodec negotiate(const QList<qint8> &offered);
+
+void write(QDataStream &out, WireCodec codec, const ClientAction &a);
+void write(QDataStream &out, WireCodec codec, const ServerAction &a);
+void write(QDataStream &out, WireCodec codec, const QList<ServerAction> &a);
+// The project file sent in the server's hello.
+void writeFile(QDataStream &out, WireCodec codec, const QByteArray &data);
+
+// These throw std::runtime_error on a malformed action, like the plain
+// QDataStream operators do. Reading past the end of the available data is
+// reported through the stream status so callers can use transactions.
+void read(QDataStream &in, WireCodec codec, ClientAction &a);
+void read(QDataStream &in, WireCodec codec, ServerAction &a);
+void read(QDataStream &in, WireCodec codec, QList<ServerAction> &a);
+void readFile(QDataStream &in, WireCodec codec, QByteArray &data);
+
+// Exposed for size comparisons, e.g. in benchmarks.
+QByteArray encodeCompact(const ClientAction &a);
+QByteArray encodeCompact(const ServerAction &a);
+}  // namespace Wire
+
+#endif  // WIRECODEC_H
@@ -0,0 +1,128 @@
+#include "WoiceHistory.h"
+
+#include <QDebug>
+#include <QTextCodec>
+
+#include "pxtone/pxtnService.h"
+
+static const QTextCodec *codec() {
+  static const QTextCodec *codec = QTextCodec::codecForName("Shift-JIS");
+  return codec;
+}
+
+// The name a woice ends up with when it's given [name].
+static QString storedName(const QString &name) {
+  QByteArray jis = codec()->fromUnicode(name).left(pxtnMAX_TUNEWOICENAME);
+  return codec()->toUnicode(jis.constData());
+}
+
+// A woice's name, and the index in the history of the action that added it,
+// or -1 if it was in the project file.
+struct Slot {
+  QString name;
+  int source;
+};
+
+static std::optional<std::vector<Slot>> projectWoices(const QByteArray &data) {
+  std::vector<Slot> woices;
+  if (data.isEmpty()) return woices;
+  pxtnService pxtn;
+  if (pxtn.init() != pxtnOK) return std::nullopt;
+  pxtnDescriptor d;
+  d.set_memory_r(data.constData(), data.size());
+  if (pxtn.read(&d) != pxtnOK) return std::nullopt;
+  for (int i = 0; i < pxtn.Woice_Num(); ++i)
+    woices.push_back(
+        {codec()->toUnicode(pxtn.Woice_Get(i)->get_name_buf_jis(nullptr)),
+         -1});
+  return woices;
+}
+
+// Matches validateRemoveName in PxtoneController.
+static bool canRemove(const std::vector<Slot> &woices, const RemoveWoice &a) {
+  if (a.id < 0 || size_t(a.id) >= woices.size()) return false;
+  QString expected_name(a.name);
+  expected_name.truncate(pxtnMAX_TUNEWOICENAME);
+  return woices[a.id].name == expected_name;
+}
+
+std::vector<bool> removedWoices(const QByteArray &data,
+                                const QList<ServerAction> &history,
+                                const WoiceReadable &readable) {
+  std::vector<bool> removed(history.size(), false);
+  bool any_removed = false;
+  for (const ServerAction &a : history)
+    if (const ClientAction *c = std::get_if<ClientAction>(&a.action))
+      any_removed |= std::holds_alternative<RemoveWoice>(*c) ||
+                     std::holds_alternative<ChangeWoice>(*c);
+  // Saves reading the project when nothing could have gone.
+  if (!any_removed) return removed;
+
+  std::optional<std::vector<Slot>> project = projectWoices(data);
+  if (!project.has_value()) {
+    qWarning() << "Could not read project to follow its woices";
+    return removed;
+  }
+  std::vector<Slot> &woices = project.value();
+  auto remove = [&](size_t idx) {
+    if (woices[idx].source >= 0) removed[woices[idx].source] = true;
+  };
+  // Like PxtoneController, adds fail on a full song or unreadable data, and
+  // a change fails on unreadable data.
+  for (int i = 0; i < history.size(); ++i) {
+    const ClientAction *a = std::get_if<ClientAction>(&history[i].action);
+    if (!a) continue;
+    if (const AddWoice *w = std::get_if<AddWoice>(a)) {
+      if (woices.size() >= pxtnMAX_TUNEWOICESTRUCT) continue;
+      std::optional<bool> ok = readable(*w);
+      if (!ok.has_value()) break;
+      if (ok.value()) woices.push_back({storedName(w->name), i});
+    } else if (const RemoveWoice *w = std::get_if<RemoveWoice>(a)) {
+      if (woices.size() <= 1 || !canRemove(woices, *w)) continue;
+      remove(w->id);
+      woices.erase(woices.begin() + w->id);
+    } else if (const ChangeWoice *w = std::get_if<ChangeWoice>(a)) {
+      if (!canRemove(woices, w->remove)) continue;
+      std::optional<bool> ok = readable(w->add);
+      if (!ok.has_value()) break;
+      if (!ok.value()) continue;
+      remove(w->remove.id);
+      woices[w->remove.id] = {storedName(w->add.name), i};
+    } else if (const Woice::Set *w = std::get_if<Woice::Set>(a)) {
+      const Woice::Name *name = std::get_if<Woice::Name>(&w->setting);
+      if (name && w->id >= 0 && size_t(w->id) < woices.size())
+        woices[w->id].name = storedName(name->name);
+    }
+  }
+  return removed;
+}
+
+bool canReadWoice(const AddWoice &w) {
+  if (w.data.isEmpty()) return false;
+  pxtnWoice woice;
+  pxtnDescriptor d;
+  d.set_memory_r(w.data.constData(), w.data.size());
+  return woice.read(&d, w.type) == pxtnOK;
+}
+
+AddWoice standInWoice(const QString &name) {
+  constexpr int sps = 44100, smp_num = 16;
+  QByteArray wav;
+  auto put = [&wav](uint32_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) wav.push_back(char((v >> (8 * i)) & 0xFF));
+  };
+  wav.append("RIFF");
+  put(36 + smp_num * 2, 4);
+  wav.append("WAVEfmt ");
+  put(16, 4);
+  put(1, 2);  // PCM
+  put(1, 2);  // mono
+  put(sps, 4);
+  put(sps * 2, 4);
+  put(2, 2);
+  put(16, 2);
+  wav.append("data");
+  put(smp_num * 2, 4);
+  wav.append(smp_num * 2, '\0');
+  return AddWoice{pxtnWOICE_PCM, name, wav, blobHash(wav)};
+}
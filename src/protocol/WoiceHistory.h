@@ -0,0 +1,31 @@
+#ifndef WOICEHISTORY_H
+#define WOICEHISTORY_H
+
+#include <QByteArray>
+#include <QList>
+#include <functional>
+#include <optional>
+#include <vector>
+
+#include "RemoteAction.h"
+
+// Whether a client could read the woice data, or nullopt if that's not known.
+using WoiceReadable = std::function<std::optional<bool>(const AddWoice &)>;
+
+// For each action in [history], whether it added a woice that a later action
+// in [history] then removes or replaces, when the history is replayed on
+// [data], the project file, by the same rules clients apply woice actions
+// with. Only true where that's certain: from the first point the replay
+// can't tell what a client would do, nothing more counts as removed.
+std::vector<bool> removedWoices(const QByteArray &data,
+                                const QList<ServerAction> &history,
+                                const WoiceReadable &readable);
+
+// Whether a client could read [w]'s data. Needs the data.
+bool canReadWoice(const AddWoice &w);
+
+// A short silent woice named [name], to stand in for a removed one so that
+// it's still added and removed in the same place.
+AddWoice standInWoice(const QString &name);
+
+#endif  // WOICEHISTORY_H
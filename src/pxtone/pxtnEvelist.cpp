@@ -16,6 +16,7 @@ void pxtnEvelist::Release() {
   _eves = NULL;
   _start = NULL;
   _eve_allocated_num = 0;
+  _edit_count++;
 }
 
 pxtnEvelist::pxtnEvelist() {
@@ -24,6 +25,7 @@ pxtnEvelist::pxtnEvelist() {
   _eve_allocated_num = 0;
   _linear = 0;
   _p_x4x_rec = 0;
+  _edit_count = 0;
 }
 
 pxtnEvelist::~pxtnEvelist() { pxtnEvelist::Release(); }
@@ -31,6 +33,7 @@ pxtnEvelist::~pxtnEvelist() { pxtnEvelist::Release(); }
 void pxtnEvelist::Clear() {
   if (_eves) memset(_eves, 0, sizeof(EVERECORD) * _eve_allocated_num);
   _start = NULL;
+  _edit_count++;
 }
 
 bool pxtnEvelist::Allocate(int32_t max_event_num) {
@@ -42,11 +45,35 @@ bool pxtnEvelist::Allocate(int32_t max_event_num) {
   return true;
 }
 
+bool pxtnEvelist::Copy(pxtnEvelist* p_dst) const {
+  int32_t num = get_Count();
+  if (!p_dst->Allocate(num > 0 ? num : 1)) return false;
+  EVERECORD* prev = NULL;
+  EVERECORD* rec = p_dst->_eves;
+  for (const EVERECORD* p = _start; p; p = p->next, rec++) {
+    *rec = *p;
+    rec->prev = prev;
+    rec->next = NULL;
+    if (prev) prev->next = rec;
+    prev = rec;
+  }
+  p_dst->_start = (num > 0 ? p_dst->_eves : NULL);
+  p_dst->_linear = 0;
+  p_dst->_p_x4x_rec = NULL;
+  return true;
+}
+
 int32_t pxtnEvelist::get_Num_Max() const {
   if (!_eves) return 0;
   return _eve_allocated_num;
 }
 
+uint32_t pxtnEvelist::get_Edit_Count() const { return _edit_count; }
+
+int32_t pxtnEvelist::get_Slot(const EVERECORD* p_rec) const {
+  return (int32_t)(p_rec - _eves);
+}
+
 int32_t pxtnEvelist::get_Max_Clock() const {
   int32_t max_clock = 0;
   int32_t clock;
@@ -191,6 +218,7 @@ void pxtnEvelist::_rec_set(EVERECORD* p_rec, EVERECORD* prev, EVERECORD* next,
   p_rec->kind = kind;
   p_rec->unit_no = unit_no;
   p_rec->value = value;
+  _edit_count++;
 }
 
 static int32_t _ComparePriority(uint8_t kind1, uint8_t kind2) {
@@ -223,6 +251,7 @@ void pxtnEvelist::_rec_cut(EVERECORD* p_rec) {
     _start = p_rec->next;
   if (p_rec->next) p_rec->next->prev = p_rec->prev;
   p_rec->kind = EVENTKIND_NULL;
+  _edit_count++;
 }
 
 bool pxtnEvelist::Record_Add_f(int32_t clock, uint8_t unit_no, uint8_t kind,
@@ -234,28 +263,43 @@ bool pxtnEvelist::Record_Add_f(int32_t clock, uint8_t unit_no, uint8_t kind,
 bool pxtnEvelist::Record_Add_i(int32_t clock, uint8_t unit_no, uint8_t kind,
                                int32_t value) {
   if (!_eves) return false;
+  int32_t free_from = 0;
+  return _rec_add(_start, &free_from, clock, unit_no, kind, value) != NULL;
+}
 
+// Searches for the new event's place from [p_from], which must not be after
+// it, and for a free record from [*free_from].
+EVERECORD* pxtnEvelist::_rec_add(EVERECORD* p_from, int32_t* free_from,
+                                 int32_t clock, uint8_t unit_no, uint8_t kind,
+                                 int32_t value) {
   EVERECORD* p_new = NULL;
   EVERECORD* p_prev = NULL;
   EVERECORD* p_next = NULL;
 
   // 空き検索
-  for (int32_t r = 0; r < _eve_allocated_num; r++) {
-    if (_eves[r].kind == EVENTKIND_NULL) {
-      p_new = &_eves[r];
-      break;
+  bool wrapped = (*free_from == 0);
+  while (!p_new) {
+    for (; *free_from < _eve_allocated_num; (*free_from)++) {
+      if (_eves[*free_from].kind == EVENTKIND_NULL) {
+        p_new = &_eves[*free_from];
+        break;
+      }
     }
+    if (p_new || wrapped) break;
+    *free_from = 0;
+    wrapped = true;
   }
-  if (!p_new) return false;
+  if (!p_new) return NULL;
 
   // first.
   if (!_start) {
   }
   // top.
-  else if (clock < _start->clock) {
-    p_next = _start;
+  else if (clock < p_from->clock) {
+    p_prev = p_from->prev;
+    p_next = p_from;
   } else {
-    for (EVERECORD* p = _start; p; p = p->next) {
+    for (EVERECORD* p = p_from; p; p = p->next) {
       if (p->clock == clock)  // 同時
       {
         for (; true; p = p->next) {
@@ -315,7 +359,31 @@ bool pxtnEvelist::Record_Add_i(int32_t clock, uint8_t unit_no, uint8_t kind,
     }
   }
 
-  return true;
+  return p_new;
+}
+
+int32_t pxtnEvelist::Record_Add_Batch(
+    int32_t clock, uint8_t unit_no, uint8_t kind,
+    const std::vector<std::pair<int32_t, int32_t> >& events) {
+  if (!_eves) return 0;
+
+  int32_t count = 0;
+  int32_t free_from = 0;
+  EVERECORD* p_last = NULL;
+  for (size_t i = 0; i < events.size(); i++) {
+    int32_t c = clock + events[i].first;
+    // Events are sorted, so start from the last one added, or the first
+    // event at the same clock since the priority order applies there.
+    EVERECORD* p_from = (p_last ? p_last : _start);
+    while (p_from && p_from->prev && p_from->prev->clock == c)
+      p_from = p_from->prev;
+    EVERECORD* p_new =
+        _rec_add(p_from, &free_from, c, unit_no, kind, events[i].second);
+    if (!p_new) break;
+    p_last = p_new;
+    count++;
+  }
+  return count;
 }
 
 int32_t pxtnEvelist::Record_Delete(int32_t clock1, int32_t clock2,
@@ -346,6 +414,36 @@ int32_t pxtnEvelist::Record_Delete(int32_t clock1, int32_t clock2,
   return count;
 }
 
+int32_t pxtnEvelist::Record_Delete_Batch(
+    int32_t clock, uint8_t unit_no, uint8_t kind,
+    const std::vector<std::pair<int32_t, int32_t> >& ranges) {
+  if (!_eves) return 0;
+
+  int32_t count = 0;
+  bool tail = Evelist_Kind_IsTail(kind);
+  size_t i = 0;
+  for (EVERECORD* p = _start; p && i < ranges.size();) {
+    int32_t clock1 = clock + ranges[i].first;
+    int32_t clock2 = clock + ranges[i].second;
+    if (p->clock >= clock2) {
+      i++;
+      continue;
+    }
+    EVERECORD* next = p->next;
+    if (p->unit_no == unit_no && p->kind == kind) {
+      if (p->clock >= clock1) {
+        _rec_cut(p);
+        count++;
+      } else if (tail && p->clock + p->value > clock1) {
+        p->value = clock1 - p->clock;
+        count++;
+      }
+    }
+    p = next;
+  }
+  return count;
+}
+
 int32_t pxtnEvelist::Record_Delete(int32_t clock1, int32_t clock2,
                                    uint8_t unit_no) {
   if (!_eves) return 0;
@@ -374,6 +472,7 @@ int32_t pxtnEvelist::Record_Delete(int32_t clock1, int32_t clock2,
 
 int32_t pxtnEvelist::Record_UnitNo_Miss(uint8_t unit_no) {
   if (!_eves) return 0;
+  _edit_count++;
 
   int32_t count = 0;
 
@@ -391,6 +490,7 @@ int32_t pxtnEvelist::Record_UnitNo_Miss(uint8_t unit_no) {
 
 int32_t pxtnEvelist::Record_UnitNo_Set(uint8_t unit_no) {
   if (!_eves) return 0;
+  _edit_count++;
 
   int32_t count = 0;
   for (EVERECORD* p = _start; p; p = p->next) {
@@ -402,6 +502,7 @@ int32_t pxtnEvelist::Record_UnitNo_Set(uint8_t unit_no) {
 
 int32_t pxtnEvelist::Record_UnitNo_Replace(uint8_t old_u, uint8_t new_u) {
   if (!_eves) return 0;
+  _edit_count++;
 
   int32_t count = 0;
 
@@ -451,6 +552,7 @@ int32_t pxtnEvelist::Record_Value_Set(int32_t clock1, int32_t clock2,
 
 int32_t pxtnEvelist::BeatClockOperation(int32_t rate) {
   if (!_eves) return 0;
+  _edit_count++;
 
   int32_t count = 0;
 
@@ -663,6 +765,7 @@ void pxtnEvelist::Linear_Add_f(int32_t clock, uint8_t unit_no, uint8_t kind,
 }
 
 void pxtnEvelist::Linear_End(bool b_connect) {
+  _edit_count++;
   if (_eves[0].kind != EVENTKIND_NULL) _start = &_eves[0];
 
   if (b_connect) {
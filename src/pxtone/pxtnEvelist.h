@@ -1,6 +1,9 @@
 #ifndef pxtnEvelist_H
 #define pxtnEvelist_H
 
+#include <utility>
+#include <vector>
+
 #include "./pxtn.h"
 #include "./pxtnDescriptor.h"
 
@@ -67,10 +70,13 @@ class pxtnEvelist {
   int32_t _linear;
 
   EVERECORD *_p_x4x_rec;
+  uint32_t _edit_count;
 
   void _rec_set(EVERECORD *p_rec, EVERECORD *prev, EVERECORD *next,
                 int32_t clock, uint8_t unit_no, uint8_t kind, int32_t value);
   void _rec_cut(EVERECORD *p_rec);
+  EVERECORD *_rec_add(EVERECORD *p_from, int32_t *free_from, int32_t clock,
+                      uint8_t unit_no, uint8_t kind, int32_t value);
 
  public:
   void Release();
@@ -80,8 +86,16 @@ class pxtnEvelist {
   ~pxtnEvelist();
 
   bool Allocate(int32_t max_event_num);
+  // Copies the events into [p_dst], allocating only as many as there are, so
+  // the copy is for reading rather than adding to.
+  bool Copy(pxtnEvelist *p_dst) const;
 
   int32_t get_Num_Max() const;
+  // Goes up whenever records are added, removed or moved, so that anything
+  // derived from them knows to be rebuilt. Value changes don't count.
+  uint32_t get_Edit_Count() const;
+  // Where [p_rec] is in the record pool, from 0 up to get_Num_Max().
+  int32_t get_Slot(const EVERECORD *p_rec) const;
   int32_t get_Max_Clock() const;
   int32_t get_Count() const;
   int32_t get_Count(uint8_t kind, int32_t value) const;
@@ -96,6 +110,11 @@ class pxtnEvelist {
                     int32_t value);
   bool Record_Add_f(int32_t clock, uint8_t unit_no, uint8_t kind,
                     float value_f);
+  // Same as Record_Add_i for each (clock + offset, value) in turn, but in one
+  // pass. Offsets must be ascending.
+  int32_t Record_Add_Batch(
+      int32_t clock, uint8_t unit_no, uint8_t kind,
+      const std::vector<std::pair<int32_t, int32_t> > &events);
 
   bool Linear_Start();
   void Linear_Add_i(int32_t clock, uint8_t unit_no, uint8_t kind,
@@ -116,6 +135,11 @@ class pxtnEvelist {
   int32_t Record_Delete(int32_t clock1, int32_t clock2, uint8_t unit_no,
                         uint8_t kind);
   int32_t Record_Delete(int32_t clock1, int32_t clock2, uint8_t unit_no);
+  // Same as Record_Delete for each [clock + start, clock + end) in turn, but
+  // in one pass. Ranges must be non-empty, ascending and disjoint.
+  int32_t Record_Delete_Batch(
+      int32_t clock, uint8_t unit_no, uint8_t kind,
+      const std::vector<std::pair<int32_t, int32_t> > &ranges);
 
   int32_t Record_UnitNo_Miss(uint8_t unit_no);  // delete event has the unit-no
   int32_t Record_UnitNo_Set(uint8_t unit_no);   // set the unit-no
@@ -18,6 +18,15 @@ void pxtnMaster::Reset() {
   _last_meas = 0;
 }
 
+void pxtnMaster::Copy(pxtnMaster *p_dst) const {
+  p_dst->_beat_num = _beat_num;
+  p_dst->_beat_tempo = _beat_tempo;
+  p_dst->_beat_clock = _beat_clock;
+  p_dst->_meas_num = _meas_num;
+  p_dst->_repeat_meas = _repeat_meas;
+  p_dst->_last_meas = _last_meas;
+}
+
 void pxtnMaster::Set(int32_t beat_num, float beat_tempo, int32_t beat_clock) {
   _beat_num = beat_num;
   _beat_tempo = beat_tempo;
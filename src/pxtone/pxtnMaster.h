@@ -24,6 +24,7 @@ class pxtnMaster {
   ~pxtnMaster();
 
   void Reset();
+  void Copy(pxtnMaster *p_dst) const;
 
   void Set(int32_t beat_num, float beat_tempo, int32_t beat_clock);
   void Get(int32_t *p_beat_num, float *p_beat_tempo, int32_t *p_beat_clock,
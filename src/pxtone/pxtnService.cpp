@@ -101,6 +101,7 @@ pxtnService::pxtnService() {
   _unit_max = _unit_num = 0;
 
   _ptn_bldr = NULL;
+  _dst_format = pxtnSAMPLEFORMAT_s16;
 
   _sampled_proc = NULL;
   _sampled_user = NULL;
@@ -206,6 +207,51 @@ End:
   return res;
 }
 
+pxtnERR pxtnService::init_snapshot(const pxtnService &src) {
+  if (!src._b_init) return pxtnERR_INIT;
+  pxtnERR res = _init(0, false);
+  if (res != pxtnOK) return res;
+  res = pxtnERR_memory;
+
+  if (!src.evels->Copy(evels)) goto End;
+  src.master->Copy(master);
+  int32_t size;
+  const char *buf;
+  buf = src.text->get_name_buf(&size);
+  if (buf && !text->set_name_buf(buf, size)) goto End;
+  buf = src.text->get_comment_buf(&size);
+  if (buf && !text->set_comment_buf(buf, size)) goto End;
+
+  _delays = src._delays;
+  for (const pxtnOverDrive &o : src._ovdrvs) {
+    _ovdrvs.emplace_back();
+    _ovdrvs.rbegin()->Set(o.get_cut(), o.get_amp(), o.get_group(), false);
+    _ovdrvs.rbegin()->set_played(o.get_played());
+  }
+  for (int32_t i = 0; i < src._woice_num; i++) _woices[i] = src._woices[i];
+  _woice_num = src._woice_num;
+  for (int32_t i = 0; i < src._unit_num; i++) {
+    const pxtnUnit *u = src._units[i];
+    if (!(_units[i] = new pxtnUnit())) goto End;
+    _unit_num = i + 1;
+    buf = u->get_name_buf_jis(&size);
+    _units[i]->set_name_buf_jis(buf, size);
+    _units[i]->set_visible(u->get_visible());
+    _units[i]->set_operated(u->get_operated());
+    _units[i]->set_played(u->get_played());
+  }
+  _group_num = src._group_num;
+  _dst_ch_num = src._dst_ch_num;
+  _dst_sps = src._dst_sps;
+  _dst_byte_per_smp = src._dst_byte_per_smp;
+  _dst_format = src._dst_format;
+  _moo_b_valid_data = src._moo_b_valid_data;
+  res = pxtnOK;
+End:
+  if (res != pxtnOK) _release();
+  return res;
+}
+
 bool pxtnService::AdjustMeasNum() {
   if (!_b_init) return false;
   master->AdjustMeasNum(evels->get_Max_Clock());
@@ -217,18 +263,20 @@ int32_t pxtnService::Group_Num() const { return _b_init ? _group_num : 0; }
 pxtnERR pxtnService::tones_ready(mooState &moo_state) {
   if (!_b_init) return pxtnERR_INIT;
 
-  pxtnERR res = pxtnERR_VOID;
+  pxtnERR res = delays_ready(moo_state);
+  if (res != pxtnOK) return res;
+  return Woice_ReadyTones();
+}
+
+pxtnERR pxtnService::delays_ready(mooState &moo_state) const {
+  if (!_b_init) return pxtnERR_INIT;
+
   int32_t beat_num = master->get_beat_num();
   float beat_tempo = master->get_beat_tempo();
 
   moo_state.delays.clear();
   for (size_t i = 0; i < _delays.size(); i++)
     moo_state.delays.emplace_back(_delays[i], beat_num, beat_tempo, _dst_sps);
-
-  for (int32_t i = 0; i < _woice_num; i++) {
-    res = _woices[i]->Tone_Ready(_ptn_bldr, _dst_sps);
-    if (res != pxtnOK) return res;
-  }
   return pxtnOK;
 }
 
@@ -379,6 +427,22 @@ pxtnERR pxtnService::Woice_ReadyTone(std::shared_ptr<pxtnWoice> woice) const {
   return woice->Tone_Ready(_ptn_bldr, _dst_sps);
 }
 
+pxtnERR pxtnService::Woice_ReadyTones() {
+  if (!_b_init) return pxtnERR_INIT;
+  for (int32_t i = 0; i < _woice_num; i++) {
+    pxtnERR res = _woices[i]->Tone_Ready(_ptn_bldr, _dst_sps);
+    if (res != pxtnOK) return res;
+  }
+  return pxtnOK;
+}
+
+bool pxtnService::Woice_Set(int32_t idx, std::shared_ptr<pxtnWoice> woice) {
+  if (!_b_init || !woice) return false;
+  if (idx < 0 || idx >= _woice_num) return false;
+  _woices[idx] = woice;
+  return true;
+}
+
 bool pxtnService::Woice_Remove(int32_t idx) {
   if (!_b_init) return false;
   if (idx < 0 || idx >= _woice_num) return false;
@@ -503,7 +567,8 @@ bool pxtnService::Unit_Solo(int idx) {
 // Quality..
 // ---------------------------
 
-bool pxtnService::set_destination_quality(int32_t ch_num, int32_t sps) {
+bool pxtnService::set_destination_quality(int32_t ch_num, int32_t sps,
+                                          pxtnSAMPLEFORMAT format) {
   if (!_b_init) return false;
   switch (ch_num) {
     case 1:
@@ -516,10 +581,18 @@ bool pxtnService::set_destination_quality(int32_t ch_num, int32_t sps) {
 
   _dst_ch_num = ch_num;
   _dst_sps = sps;
-  _dst_byte_per_smp = pxtnBITPERSAMPLE / 8 * ch_num;
+  _dst_format = format;
+  if (format == pxtnSAMPLEFORMAT_f32)
+    _dst_byte_per_smp = sizeof(float) * ch_num;
+  else
+    _dst_byte_per_smp = pxtnBITPERSAMPLE / 8 * ch_num;
   return true;
 }
 
+pxtnSAMPLEFORMAT pxtnService::get_destination_format() const {
+  return _dst_format;
+}
+
 bool pxtnService::get_destination_quality(int32_t *p_ch_num,
                                           int32_t *p_sps) const {
   if (!_b_init) return false;
@@ -2,6 +2,7 @@
 #define pxtnService_H
 
 #include <map>
+#include <optional>
 #include <vector>
 
 #include "./pxtn.h"
@@ -21,6 +22,14 @@
 #define pxtnVOMITPREPFLAG_loop 0x01
 #define pxtnVOMITPREPFLAG_unit_mute 0x02
 
+// What Moo can split its output into, alongside the full mix. Unit stems are
+// taken before group effects, group stems after.
+enum pxtnSTEMKIND { pxtnSTEM_none = 0, pxtnSTEM_unit, pxtnSTEM_group };
+
+// How Moo writes samples. Float samples are scaled so that 16-bit full scale
+// is 1.0, and aren't clipped, so the mix keeps its headroom.
+enum pxtnSAMPLEFORMAT { pxtnSAMPLEFORMAT_s16 = 0, pxtnSAMPLEFORMAT_f32 };
+
 typedef struct {
   int32_t start_pos_meas;
   int32_t start_pos_sample;
@@ -36,6 +45,46 @@ typedef struct {
 
 class pxtnService;
 
+// Stages of producing a sample, for profiling moo.
+enum pxtnMOOSTAGE {
+  pxtnMOOSTAGE_envelope = 0,
+  pxtnMOOSTAGE_events,
+  pxtnMOOSTAGE_sample,
+  pxtnMOOSTAGE_group_mix,
+  pxtnMOOSTAGE_overdrive,
+  pxtnMOOSTAGE_delay,
+  pxtnMOOSTAGE_output,
+  pxtnMOOSTAGE_increment,
+  pxtnMOOSTAGE_num
+};
+
+// Where moo's time goes, added to while it's set as a mooState's profile.
+// Every Moo call is timed as a whole, and every [stride]th sample is timed
+// stage by stage. A stride of 1 costs a clock read per stage per sample, which
+// suits benchmarks; a larger one is cheap enough to leave on while playing.
+struct pxtnMooProfile {
+  int32_t stride;
+  // Time per stage, over the samples that were timed.
+  int64_t ns[pxtnMOOSTAGE_num];
+  int64_t smp_num;
+  int64_t timed_smp_num;
+  // Time spent in Moo, and the highest ratio of a call's time to the length
+  // of the audio it made.
+  int64_t moo_ns;
+  double peak_load;
+  // Voices still sounding per unit after the last Moo, and the most there
+  // have been in total.
+  std::vector<int32_t> unit_voices;
+  int32_t peak_voices;
+
+  pxtnMooProfile(int32_t stride = 1) : stride(stride) { reset(); }
+  // Keeps [unit_voices], which still holds, and saves reallocating it.
+  void reset();
+  // Fraction of real time at [sps] spent in Moo.
+  double load(int32_t sps) const;
+  static const char *stage_name(pxtnMOOSTAGE stage);
+};
+
 // Static parameters that are computed when moo is initialized.
 struct mooParams {
   // Whether muting individual units is allowed or not
@@ -56,8 +105,12 @@ struct mooParams {
 
   mooParams();
 
-  void processEvent(pxtnUnitTone *p_u, const EVERECORD *e, int32_t clock,
-                    int32_t smp_num, const pxtnService *pxtn) const;
+  // [next_on] is the unit's next ON after [e], if the caller already knows
+  // it. Otherwise it's found by scanning ahead.
+  void processEvent(
+      pxtnUnitTone *p_u, const EVERECORD *e, int32_t clock, int32_t smp_num,
+      const pxtnService *pxtn,
+      std::optional<const EVERECORD *> next_on = std::nullopt) const;
   void processNonOnEvent(pxtnUnitTone *p_u, EVENTKIND kind, int32_t value,
                          const pxtnService *pxtn) const;
 
@@ -80,6 +133,12 @@ struct mooState {
   // Next event
   const EVERECORD *p_eve;
 
+  // For each ON, the next ON of the same unit, by slot in the event list.
+  // Rebuilt whenever the list's been edited since.
+  std::vector<const EVERECORD *> next_ons;
+  const pxtnEvelist *next_ons_evels;
+  uint32_t next_ons_edit_count;
+
   // Number of times this moo has looped. For ptcollab bookkeeping.
   int num_loop;
 
@@ -91,6 +150,9 @@ struct mooState {
   std::vector<pxtnUnitTone> units;
   std::vector<pxtnDelayTone> delays;
 
+  // If set, where to accumulate per-stage timings.
+  pxtnMooProfile *profile;
+
   mooState();
 
   void release();
@@ -127,6 +189,7 @@ class pxtnService {
   bool _b_fix_evels_num;
 
   int32_t _dst_ch_num, _dst_sps, _dst_byte_per_smp;
+  pxtnSAMPLEFORMAT _dst_format;
 
   pxtnPulse_NoiseBuilder *_ptn_bldr;
 
@@ -176,10 +239,17 @@ class pxtnService {
   pxtnERR _pre_count_event(pxtnDescriptor *p_doc, int32_t *p_count);
 
   bool _moo_InitUnitTone(mooState &moo_state) const;
+  void _moo_update_next_ons(mooState &moo_state) const;
   pxtnSampledCallback _sampled_proc;
   void *_sampled_user;
 
-  bool _moo_PXTONE_SAMPLE(void *p_data, mooState &moo_state) const;
+  template <typename T>
+  bool _moo_PXTONE_SAMPLE(T *p_data, mooState &moo_state,
+                          pxtnSTEMKIND stem_kind = pxtnSTEM_none,
+                          T *p_stems = nullptr) const;
+  template <typename T>
+  void _moo_fill(mooState &moo_state, T *p_buf, int32_t smp_num,
+                 pxtnSTEMKIND stem_kind, T *p_stems) const;
 
  public:
   pxtnService();
@@ -191,6 +261,10 @@ class pxtnService {
 
   pxtnERR init();
   pxtnERR init_collage(int32_t fix_evels_num);
+  // Initializes this as a read-only copy of [src] to moo from while [src]
+  // keeps changing. Woices are shared with [src] rather than copied, so they
+  // mustn't be changed in place while the copy is around.
+  pxtnERR init_snapshot(const pxtnService &src);
   bool clear();
 
   pxtnERR write(pxtnDescriptor *p_doc, bool bTune, uint16_t exe_ver);
@@ -201,6 +275,9 @@ class pxtnService {
   int32_t get_last_error_id() const;
 
   pxtnERR tones_ready(mooState &moo_state);
+  // The part of tones_ready that only sets up [moo_state], for when the
+  // woices are already ready, as they are in a snapshot.
+  pxtnERR delays_ready(mooState &moo_state) const;
 
   int32_t Group_Num() const;
 
@@ -233,6 +310,10 @@ class pxtnService {
 
   pxtnERR Woice_read(int32_t idx, pxtnDescriptor *desc, pxtnWOICETYPE type);
   pxtnERR Woice_ReadyTone(std::shared_ptr<pxtnWoice> woice) const;
+  pxtnERR Woice_ReadyTones();
+  // Puts [woice] in place of woice [idx], leaving the old one to whoever
+  // else holds it.
+  bool Woice_Set(int32_t idx, std::shared_ptr<pxtnWoice> woice);
   bool Woice_Remove(int32_t idx);
   bool Woice_Replace(int32_t old_place, int32_t new_place);
 
@@ -249,8 +330,11 @@ class pxtnService {
   bool Unit_Solo(int32_t idx);
 
   // q
-  bool set_destination_quality(int32_t ch_num, int32_t sps);
+  bool set_destination_quality(
+      int32_t ch_num, int32_t sps,
+      pxtnSAMPLEFORMAT format = pxtnSAMPLEFORMAT_s16);
   bool get_destination_quality(int32_t *p_ch_num, int32_t *p_sps) const;
+  pxtnSAMPLEFORMAT get_destination_format() const;
   bool get_byte_per_smp(int32_t *p_byte_per_smp) const;
   bool set_sampled_callback(pxtnSampledCallback proc, void *user);
 
@@ -260,10 +344,20 @@ class pxtnService {
 
   bool Moo(mooState &moo_state, void *p_buf, int32_t size,
            int32_t *filled_size = nullptr) const;
+  // Also writes one frame per unit / group for each sample into [p_stem_buf],
+  // which must fit (size / byte_per_smp) * stem count frames. Stems are in
+  // the destination format too.
+  bool Moo(mooState &moo_state, void *p_buf, int32_t size,
+           int32_t *filled_size, pxtnSTEMKIND stem_kind,
+           void *p_stem_buf) const;
+  int32_t moo_get_stem_num(pxtnSTEMKIND stem_kind) const;
 
-  int32_t moo_tone_sample_multi(std::map<int, pxtnUnitTone *> p_us,
+  // Adds [p_us] into the [buf_size] bytes of output already at [data].
+  // Returns how many bytes were mixed. Only for 16-bit output.
+  int32_t moo_tone_sample_multi(const std::vector<pxtnUnitTone *> &p_us,
                                 const mooParams &params, void *data,
-                                int32_t buf_size, int32_t time_pan_index) const;
+                                int32_t buf_size,
+                                int32_t *time_pan_index) const;
 
   bool moo_is_valid_data() const;
   // TODO: Adjust delays here
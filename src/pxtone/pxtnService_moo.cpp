@@ -1,8 +1,49 @@
 
+#include <algorithm>
+#include <chrono>
+
 #include "./pxtn.h"
 #include "./pxtnMem.h"
 #include "./pxtnService.h"
 
+void pxtnMooProfile::reset() {
+  for (int64_t &n : ns) n = 0;
+  smp_num = 0;
+  timed_smp_num = 0;
+  moo_ns = 0;
+  peak_load = 0;
+  peak_voices = 0;
+}
+
+double pxtnMooProfile::load(int32_t sps) const {
+  if (smp_num == 0) return 0;
+  return moo_ns * 1e-9 * sps / smp_num;
+}
+
+const char *pxtnMooProfile::stage_name(pxtnMOOSTAGE stage) {
+  switch (stage) {
+    case pxtnMOOSTAGE_envelope:
+      return "envelope";
+    case pxtnMOOSTAGE_events:
+      return "events";
+    case pxtnMOOSTAGE_sample:
+      return "sample";
+    case pxtnMOOSTAGE_group_mix:
+      return "group mix";
+    case pxtnMOOSTAGE_overdrive:
+      return "overdrive";
+    case pxtnMOOSTAGE_delay:
+      return "delay";
+    case pxtnMOOSTAGE_output:
+      return "fade/clamp";
+    case pxtnMOOSTAGE_increment:
+      return "increment";
+    case pxtnMOOSTAGE_num:
+      break;
+  }
+  return "";
+}
+
 mooParams::mooParams() {
   b_mute_by_unit = false;
   b_loop = true;
@@ -12,6 +53,9 @@ mooParams::mooParams() {
 
 mooState::mooState() {
   p_eve = NULL;
+  next_ons_evels = nullptr;
+  next_ons_edit_count = 0;
+  profile = nullptr;
   num_loop = 0;
   smp_count = 0;
   fade_fade = 0;
@@ -50,20 +94,41 @@ void mooParams::resetVoiceOn(pxtnUnitTone* p_u) const {
 bool pxtnService::_moo_InitUnitTone(mooState& moo_state) const {
   return moo_state.resetUnits(_unit_num, Woice_Get(EVENTDEFAULT_VOICENO));
 }
+
+// Links up each unit's ONs in one pass, so that playing a note doesn't have
+// to scan ahead through every other unit's events for its next one.
+void pxtnService::_moo_update_next_ons(mooState& moo_state) const {
+  if (moo_state.next_ons_evels == evels &&
+      moo_state.next_ons_edit_count == evels->get_Edit_Count())
+    return;
+  moo_state.next_ons_evels = evels;
+  moo_state.next_ons_edit_count = evels->get_Edit_Count();
+  moo_state.next_ons.resize(evels->get_Num_Max());
+
+  const EVERECORD* last_ons[UINT8_MAX + 1] = {};  // by unit_no
+  for (const EVERECORD* p = evels->get_Records(); p; p = p->next) {
+    if (p->kind != EVENTKIND_ON) continue;
+    const EVERECORD*& last_on = last_ons[p->unit_no];
+    if (last_on) moo_state.next_ons[evels->get_Slot(last_on)] = p;
+    moo_state.next_ons[evels->get_Slot(p)] = nullptr;
+    last_on = p;
+  }
+}
 #include <QDebug>
 void mooParams::processNonOnEvent(pxtnUnitTone* p_u, EVENTKIND kind,
                                   int32_t value,
                                   const pxtnService* pxtn) const {
   int32_t dst_ch_num, dst_sps;
-  pxtn->get_destination_quality(&dst_ch_num, &dst_sps);
   switch (kind) {
     case EVENTKIND_KEY:
       p_u->Tone_Key(value);
       break;
     case EVENTKIND_PAN_VOLUME:
+      pxtn->get_destination_quality(&dst_ch_num, nullptr);
       p_u->Tone_Pan_Volume(dst_ch_num, value);
       break;
     case EVENTKIND_PAN_TIME:
+      pxtn->get_destination_quality(&dst_ch_num, &dst_sps);
       p_u->Tone_Pan_Time(dst_ch_num, value, dst_sps);
       break;
     case EVENTKIND_VELOCITY:
@@ -105,7 +170,8 @@ void mooParams::processNonOnEvent(pxtnUnitTone* p_u, EVENTKIND kind,
 // This note duration cutting is for the smoothing near the end of a note.
 void mooParams::processEvent(pxtnUnitTone* p_u, const EVERECORD* e,
                              int32_t clock, int32_t smp_end,
-                             const pxtnService* pxtn) const {
+                             const pxtnService* pxtn,
+                             std::optional<const EVERECORD*> next_on) const {
   pxtnVOICETONE* p_tone;
   std::shared_ptr<const pxtnWoice> p_wc;
   const pxtnVOICEINSTANCE* p_vi;
@@ -134,12 +200,17 @@ void mooParams::processEvent(pxtnUnitTone* p_u, const EVERECORD* e,
               p_vi->env_release;
           int32_t max_life_count2;
           int32_t c = e->clock + e->value + p_tone->env_release_clock;
-          EVERECORD* next = NULL;
-          for (EVERECORD* p = e->next; p; p = p->next) {
-            if (p->clock > c) break;
-            if (p->unit_no == e->unit_no && p->kind == EVENTKIND_ON) {
-              next = p;
-              break;
+          const EVERECORD* next = NULL;
+          if (next_on.has_value()) {
+            if (next_on.value() && next_on.value()->clock <= c)
+              next = next_on.value();
+          } else {
+            for (const EVERECORD* p = e->next; p; p = p->next) {
+              if (p->clock > c) break;
+              if (p->unit_no == e->unit_no && p->kind == EVENTKIND_ON) {
+                next = p;
+                break;
+              }
             }
           }
           /* end the note at the end of the song if there's no next note */
@@ -182,12 +253,53 @@ void mooParams::processEvent(pxtnUnitTone* p_u, const EVERECORD* e,
   }
 }
 #include <QDebug>
+// Master volume and conversion to an output sample. 16-bit samples are
+// clipped, while float ones keep whatever headroom the mix has.
+static inline void _moo_output(int16_t* p, int32_t work,
+                               const mooParams& params) {
+  work = (int32_t)(work * params.master_vol);
+  if (work > params.top) work = params.top;
+  if (work < -params.top) work = -params.top;
+  *p = (int16_t)(work);
+}
+static inline void _moo_output(float* p, int32_t work,
+                               const mooParams& params) {
+  *p = work * params.master_vol * (1.0f / 32768.0f);
+}
+
 // TODO: Could probably put this in moo_state. Maybe make moo_state.params a
 // member of it.
-bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data, mooState& moo_state) const {
+template <typename T>
+bool pxtnService::_moo_PXTONE_SAMPLE(T* p_data, mooState& moo_state,
+                                     pxtnSTEMKIND stem_kind,
+                                     T* p_stems) const {
+  using steady = std::chrono::steady_clock;
+  pxtnMooProfile* profile = moo_state.profile;
+  steady::time_point lap_start;
+  bool timed = false;
+  if (profile) {
+    timed = (profile->smp_num++ % profile->stride == 0);
+    if (timed) {
+      lap_start = steady::now();
+      profile->timed_smp_num++;
+    }
+  }
+  auto lap = [&](pxtnMOOSTAGE stage) {
+    if (!timed) return;
+    steady::time_point now = steady::now();
+    profile->ns[stage] +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(now - lap_start)
+            .count();
+    lap_start = now;
+  };
+
+  // Units that have gone quiet are skipped until an event wakes them. Groups
+  // aren't, since delays can still be feeding them.
+
   // envelope..
   for (size_t u = 0; u < moo_state.units.size(); u++)
-    moo_state.units[u].Tone_Envelope();
+    if (!moo_state.units[u].Tone_IsQuiet()) moo_state.units[u].Tone_Envelope();
+  lap(pxtnMOOSTAGE_envelope);
 
   int32_t clock = (int32_t)(moo_state.smp_count / moo_state.params.clock_rate);
 
@@ -207,38 +319,68 @@ bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data, mooState& moo_state) const {
   // could have lasting effects to now.
   const EVERECORD* next =
       (moo_state.p_eve ? moo_state.p_eve->next : evels->get_Records());
+  if (next && next->clock <= clock) _moo_update_next_ons(moo_state);
   while (next && next->clock <= clock) {
     int32_t u = next->unit_no;
     // TODO: Be robust to if there's a mention of a new unit. Generate the new
     // unit on the fly? (update: currently done by adding in the controller)
+    std::optional<const EVERECORD*> next_on;
+    if (next->kind == EVENTKIND_ON)
+      next_on = moo_state.next_ons[evels->get_Slot(next)];
     moo_state.params.processEvent(&moo_state.units[u], next, clock, smp_end,
-                                  this);
+                                  this, next_on);
     moo_state.p_eve = next;
     next = moo_state.p_eve->next;
   }
+  lap(pxtnMOOSTAGE_events);
 
   // sampling..
   for (size_t u = 0; u < moo_state.units.size(); u++) {
+    if (moo_state.units[u].Tone_IsQuiet()) continue;
     bool muted = moo_state.params.b_mute_by_unit && !_units[u]->get_played();
     moo_state.units[u].Tone_Sample(muted, _dst_ch_num, moo_state.time_pan_index,
                                    moo_state.params.smp_smooth);
   }
+  lap(pxtnMOOSTAGE_sample);
+
+  /* Fade, master volume and clip a sample for output */
+  auto finish = [&moo_state](T* p, int32_t work) {
+    // fade..
+    if (moo_state.fade_fade)
+      work = work * (moo_state.fade_count >> 8) / moo_state.fade_max;
+
+    // to buffer..
+    _moo_output(p, work, moo_state.params);
+  };
 
   for (int32_t ch = 0; ch < _dst_ch_num; ch++) {
     for (int32_t g = 0; g < _group_num; g++) moo_state.group_smps[g] = 0;
     /* Sample the units into a group buffer */
     for (size_t u = 0; u < moo_state.units.size(); u++)
-      moo_state.units[u].Tone_Supple(moo_state.group_smps.data(), ch,
-                                     moo_state.time_pan_index);
+      if (!moo_state.units[u].Tone_IsQuiet())
+        moo_state.units[u].Tone_Supple(moo_state.group_smps.data(), ch,
+                                       moo_state.time_pan_index);
+    if (stem_kind == pxtnSTEM_unit)
+      for (size_t u = 0; u < moo_state.units.size(); u++)
+        finish(
+            &p_stems[u * _dst_ch_num + ch],
+            moo_state.units[u].Tone_Supple_get(ch, moo_state.time_pan_index));
+    lap(pxtnMOOSTAGE_group_mix);
     /* Add overdrive, delay to group buffer */
     for (size_t o = 0; o < _ovdrvs.size(); o++)
       _ovdrvs[o].Tone_Supple(moo_state.group_smps.data());
+    lap(pxtnMOOSTAGE_overdrive);
     for (size_t d = 0; d < _delays.size(); d++) {
       // TODO: Be robust to if there's a new delay. Generate new delay on the
       // fly?
       moo_state.delays[d].Tone_Supple(_delays[d], ch,
                                       moo_state.group_smps.data());
     }
+    lap(pxtnMOOSTAGE_delay);
+
+    if (stem_kind == pxtnSTEM_group)
+      for (int32_t g = 0; g < _group_num; g++)
+        finish(&p_stems[g * _dst_ch_num + ch], moo_state.group_smps[g]);
 
     /* Add group samples together for final */
     // collect.
@@ -246,17 +388,8 @@ bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data, mooState& moo_state) const {
     for (int32_t g = 0; g < _group_num; g++) work += moo_state.group_smps[g];
 
     /* Fading scale probably for rendering at the end */
-    // fade..
-    if (moo_state.fade_fade)
-      work = work * (moo_state.fade_count >> 8) / moo_state.fade_max;
-
-    // master volume
-    work = (int32_t)(work * moo_state.params.master_vol);
-
-    // to buffer..
-    if (work > moo_state.params.top) work = moo_state.params.top;
-    if (work < -moo_state.params.top) work = -moo_state.params.top;
-    *((int16_t*)p_data + ch) = (int16_t)(work);
+    finish(p_data + ch, work);
+    lap(pxtnMOOSTAGE_output);
   }
 
   // --------------
@@ -267,7 +400,9 @@ bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data, mooState& moo_state) const {
       (moo_state.time_pan_index + 1) & (pxtnBUFSIZE_TIMEPAN - 1);
 
   for (size_t u = 0; u < moo_state.units.size(); u++) {
+    // Portamento carries on while quiet.
     int32_t key_now = moo_state.units[u].Tone_Increment_Key();
+    if (moo_state.units[u].Tone_IsQuiet()) continue;
     moo_state.units[u].Tone_Increment_Sample(
         pxtnPulse_Frequency::Get2(key_now) * moo_state.params.smp_stride);
   }
@@ -275,6 +410,7 @@ bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data, mooState& moo_state) const {
   // delay
   for (size_t d = 0; d < moo_state.delays.size(); d++)
     moo_state.delays[d].Tone_Increment();
+  lap(pxtnMOOSTAGE_increment);
 
   // fade out
   if (moo_state.fade_fade < 0) {
@@ -309,31 +445,37 @@ bool pxtnService::_moo_PXTONE_SAMPLE(void* p_data, mooState& moo_state) const {
 ///////////////////////
 
 #include <QDebug>
-int32_t pxtnService::moo_tone_sample_multi(std::map<int, pxtnUnitTone*> p_us,
-                                           const mooParams& moo_params,
-                                           void* data, int32_t buf_size,
-                                           int32_t time_pan_index) const {
+int32_t pxtnService::moo_tone_sample_multi(
+    const std::vector<pxtnUnitTone*>& p_us, const mooParams& moo_params,
+    void* data, int32_t buf_size, int32_t* time_pan_index) const {
   // TODO: Try to deduplicate this with _moo_PXTONE_SAMPLE
-  if (buf_size < _dst_ch_num) return 0;
-
-  for (auto& [id, p_u] : p_us) {
-    if (!p_u) return 0;
-    p_u->Tone_Sample(false, _dst_ch_num, time_pan_index, moo_params.smp_smooth);
-    int32_t key_now = p_u->Tone_Increment_Key();
-    p_u->Tone_Increment_Sample(pxtnPulse_Frequency::Get2(key_now) *
-                               moo_params.smp_stride);
-  }
-  for (int ch = 0; ch < _dst_ch_num; ++ch) {
-    int32_t work = 0;
-    for (auto& [id, p_u] : p_us)
-      work += p_u->Tone_Supple_get(ch, time_pan_index);
-    work *= moo_params.master_vol;
-    if (work > moo_params.top) work = moo_params.top;
-    if (work < -moo_params.top) work = -moo_params.top;
-    *((int16_t*)data + ch) += (int16_t)(work);
+  if (_dst_format != pxtnSAMPLEFORMAT_s16) return 0;
+  int32_t smp_num = buf_size / (_dst_ch_num * (int32_t)sizeof(int16_t));
+  int16_t* p_dst = (int16_t*)data;
+
+  for (int32_t smp = 0; smp < smp_num; ++smp) {
+    for (pxtnUnitTone* p_u : p_us) {
+      p_u->Tone_Envelope();
+      p_u->Tone_Sample(false, _dst_ch_num, *time_pan_index,
+                       moo_params.smp_smooth);
+      int32_t key_now = p_u->Tone_Increment_Key();
+      p_u->Tone_Increment_Sample(pxtnPulse_Frequency::Get2(key_now) *
+                                 moo_params.smp_stride);
+    }
+    for (int ch = 0; ch < _dst_ch_num; ++ch, ++p_dst) {
+      int32_t work = 0;
+      for (pxtnUnitTone* p_u : p_us)
+        work += p_u->Tone_Supple_get(ch, *time_pan_index);
+      // Clip the sum with what's already there, since it's a mix.
+      work = work * moo_params.master_vol + *p_dst;
+      if (work > moo_params.top) work = moo_params.top;
+      if (work < -moo_params.top) work = -moo_params.top;
+      *p_dst = (int16_t)work;
+    }
+    *time_pan_index = (*time_pan_index + 1) & (pxtnBUFSIZE_TIMEPAN - 1);
   }
 
-  return _dst_ch_num * sizeof(int16_t);
+  return smp_num * _dst_ch_num * sizeof(int16_t);
 }
 
 bool pxtnService::moo_is_valid_data() const { return _moo_b_valid_data; }
@@ -442,6 +584,7 @@ bool pxtnService::moo_preparation(const pxtnVOMITPREPARATION* p_prep,
   moo_state.tones_clear();
 
   moo_state.p_eve = nullptr;
+  moo_state.next_ons_evels = nullptr;
   moo_state.num_loop = 0;
 
   _moo_InitUnitTone(moo_state);
@@ -470,15 +613,77 @@ int32_t pxtnService::moo_get_total_sample() const {
 
 bool pxtnService::Moo(mooState& moo_state, void* p_buf, int32_t size,
                       int32_t* filled_size) const {
+  return Moo(moo_state, p_buf, size, filled_size, pxtnSTEM_none, nullptr);
+}
+
+int32_t pxtnService::moo_get_stem_num(pxtnSTEMKIND stem_kind) const {
+  switch (stem_kind) {
+    case pxtnSTEM_unit:
+      return _unit_num;
+    case pxtnSTEM_group:
+      return _group_num;
+    case pxtnSTEM_none:
+      break;
+  }
+  return 0;
+}
+
+template <typename T>
+void pxtnService::_moo_fill(mooState& moo_state, T* p_buf, int32_t smp_num,
+                            pxtnSTEMKIND stem_kind, T* p_stems) const {
+  T sample[2]; /* for left and right? */
+  int32_t stem_frame = moo_get_stem_num(stem_kind) * _dst_ch_num;
+  int32_t smp_w;
+
+  /* Iterate thru samples [smp_num] times, fill buffer with this sample */
+  for (smp_w = 0; smp_w < smp_num; smp_w++) {
+    if (!_moo_PXTONE_SAMPLE(sample, moo_state, stem_kind, p_stems)) {
+      moo_state.end_vomit = true;
+      break;
+    }
+    for (int ch = 0; ch < _dst_ch_num; ch++, p_buf++) *p_buf = sample[ch];
+    if (p_stems) p_stems += stem_frame;
+  }
+  for (; smp_w < smp_num; smp_w++) {
+    for (int ch = 0; ch < _dst_ch_num; ch++, p_buf++) *p_buf = 0;
+    if (p_stems)
+      for (int i = 0; i < stem_frame; i++, p_stems++) *p_stems = 0;
+  }
+}
+
+// Bookkeeping for a Moo call that made [smp_num] samples in [ns].
+static void _moo_profile_call(pxtnMooProfile* profile, mooState& moo_state,
+                              int64_t ns, int32_t smp_num, int32_t sps) {
+  profile->moo_ns += ns;
+  if (smp_num > 0)
+    profile->peak_load =
+        std::max(profile->peak_load, ns * 1e-9 * sps / smp_num);
+
+  int32_t voices = 0;
+  profile->unit_voices.resize(moo_state.units.size());
+  for (size_t u = 0; u < moo_state.units.size(); u++) {
+    const pxtnUnitTone& unit = moo_state.units[u];
+    int32_t n = 0;
+    if (unit.get_woice())
+      for (int32_t i = 0; i < unit.get_woice()->get_voice_num(); i++)
+        if (unit.get_tone(i)->life_count > 0) n++;
+    profile->unit_voices[u] = n;
+    voices += n;
+  }
+  profile->peak_voices = std::max(profile->peak_voices, voices);
+}
+
+bool pxtnService::Moo(mooState& moo_state, void* p_buf, int32_t size,
+                      int32_t* filled_size, pxtnSTEMKIND stem_kind,
+                      void* p_stem_buf) const {
   if (filled_size) *filled_size = 0;
+  if (!p_stem_buf) stem_kind = pxtnSTEM_none;
 
   if (!_moo_b_valid_data) return false;
   if (moo_state.end_vomit) return false;
 
   bool b_ret = false;
 
-  int32_t smp_w = 0;
-
   // Testing what happens if mooing takes a long time
   // for (int i = 0, j = 0; i < 20000000; ++i) j += i * i;
   /* No longer failing on remainder - we just return the filled size */
@@ -487,25 +692,23 @@ bool pxtnService::Moo(mooState& moo_state, void* p_buf, int32_t size,
   /* Size/smp_num probably is used to sync the playback with the position */
   int32_t smp_num = size / _dst_byte_per_smp;
 
-  {
-    /* Buffer is renamed here */
-    int16_t* p16 = (int16_t*)p_buf;
-    int16_t sample[2]; /* for left and right? */
-
-    /* Iterate thru samples [smp_num] times, fill buffer with this sample */
-    for (smp_w = 0; smp_w < smp_num; smp_w++) {
-      if (!_moo_PXTONE_SAMPLE(sample, moo_state)) {
-        moo_state.end_vomit = true;
-        break;
-      }
-      for (int ch = 0; ch < _dst_ch_num; ch++, p16++) *p16 = sample[ch];
-    }
-    for (; smp_w < smp_num; smp_w++) {
-      for (int ch = 0; ch < _dst_ch_num; ch++, p16++) *p16 = 0;
-    }
-
-    if (filled_size) *filled_size = smp_num * _dst_byte_per_smp;
-  }
+  using steady = std::chrono::steady_clock;
+  steady::time_point start;
+  if (moo_state.profile) start = steady::now();
+  if (_dst_format == pxtnSAMPLEFORMAT_f32)
+    _moo_fill(moo_state, (float*)p_buf, smp_num, stem_kind,
+              (float*)p_stem_buf);
+  else
+    _moo_fill(moo_state, (int16_t*)p_buf, smp_num, stem_kind,
+              (int16_t*)p_stem_buf);
+  if (filled_size) *filled_size = smp_num * _dst_byte_per_smp;
+  if (moo_state.profile)
+    _moo_profile_call(
+        moo_state.profile, moo_state,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(steady::now() -
+                                                             start)
+            .count(),
+        smp_num, _dst_sps);
 
   if (_sampled_proc) {
     if (!_sampled_proc(_sampled_user, this)) {
@@ -15,6 +15,10 @@ pxtnUnit::pxtnUnit() {
 
 pxtnUnit::~pxtnUnit() {}
 
+// A voice's last sample stays in the time pan buffer until a silent one's
+// been written over every slot.
+static constexpr int32_t QUIET_SMP_NUM = pxtnBUFSIZE_TIMEPAN + 1;
+
 pxtnUnitTone::pxtnUnitTone(std::shared_ptr<const pxtnWoice> p_woice) {
   _v_GROUPNO = EVENTDEFAULT_GROUPNO;
   _v_VELOCITY = EVENTDEFAULT_VELOCITY;
@@ -22,6 +26,7 @@ pxtnUnitTone::pxtnUnitTone(std::shared_ptr<const pxtnWoice> p_woice) {
   _v_TUNING = EVENTDEFAULT_TUNING;
   _portament_sample_num = 0;
   _portament_sample_pos = 0;
+  _quiet_smp_num = 0;
 
   for (int32_t i = 0; i < pxtnMAX_CHANNEL; i++) {
     _pan_vols[i] = 64;
@@ -200,7 +205,8 @@ void pxtnUnitTone::Tone_Envelope() { Tone_Envelope_Custom(_vts); }
  * pxtnVOICETONE associated with the actual unit during playback. */
 void pxtnUnitTone::Tone_Sample_Custom(int32_t ch_num, int32_t smooth_smp,
                                       pxtnVOICETONE *vts, int32_t *bufs) const {
-  for (int32_t ch = 0; ch < pxtnMAX_CHANNEL; ch++) {
+  // Mono only ever reads back channel 0.
+  for (int32_t ch = 0; ch < ch_num; ch++) {
     int32_t time_pan_buf = 0;
 
     for (int32_t v = 0; v < _p_woice->get_voice_num(); v++) {
@@ -289,9 +295,10 @@ int pxtnUnitTone::Tone_Increment_Key() {
   return _key_now;
 }
 
-void pxtnUnitTone::Tone_Increment_Sample_Custom(float freq,
+bool pxtnUnitTone::Tone_Increment_Sample_Custom(float freq,
                                                 pxtnVOICETONE *vts) const {
-  if (!_p_woice) return;
+  if (!_p_woice) return false;
+  bool sounding = false;
 
   /* Up to two voices (the ones you see in ptvoice) */
   for (int32_t v = 0; v < _p_woice->get_voice_num(); v++) {
@@ -320,11 +327,20 @@ void pxtnUnitTone::Tone_Increment_Sample_Custom(float freq,
         p_vt->env_pos = 0;
       }
     }
+    if (p_vt->life_count > 0) sounding = true;
   }
+  return sounding;
 }
 
 void pxtnUnitTone::Tone_Increment_Sample(float freq) {
-  Tone_Increment_Sample_Custom(freq, _vts);
+  if (Tone_Increment_Sample_Custom(freq, _vts))
+    _quiet_smp_num = 0;
+  else if (_quiet_smp_num < QUIET_SMP_NUM)
+    _quiet_smp_num++;
+}
+
+bool pxtnUnitTone::Tone_IsQuiet() const {
+  return _quiet_smp_num >= QUIET_SMP_NUM;
 }
 
 std::shared_ptr<const pxtnWoice> pxtnUnitTone::get_woice() const {
@@ -332,6 +348,11 @@ std::shared_ptr<const pxtnWoice> pxtnUnitTone::get_woice() const {
 }
 
 pxtnVOICETONE *pxtnUnitTone::get_tone(int32_t voice_idx) {
+  _quiet_smp_num = 0;
+  return &_vts[voice_idx];
+}
+
+const pxtnVOICETONE *pxtnUnitTone::get_tone(int32_t voice_idx) const {
   return &_vts[voice_idx];
 }
 
@@ -22,6 +22,8 @@ class pxtnUnitTone {
   int32_t _pan_times[pxtnMAX_CHANNEL];
 
   /* Flipped the row-col order here so that Tone_Sample_Custom is easier */
+  /* Written every sample even without a time pan, since one can start
+   * mid-note and needs what was played before it. */
   int32_t _pan_time_bufs[pxtnBUFSIZE_TIMEPAN][pxtnMAX_CHANNEL];
   int32_t _v_VOLUME;
   int32_t _v_VELOCITY;
@@ -32,6 +34,10 @@ class pxtnUnitTone {
 
   pxtnVOICETONE _vts[pxtnMAX_UNITCONTROLVOICE];
 
+  // Samples in a row that no voice has sounded for, up to when the time pan
+  // buffer is all zeros and the unit can be skipped.
+  int32_t _quiet_smp_num;
+
  public:
   pxtnUnitTone(std::shared_ptr<const pxtnWoice> p_woice);
 
@@ -64,13 +70,20 @@ class pxtnUnitTone {
   void Tone_Supple(int32_t *group_smps, int32_t ch_num,
                    int32_t time_pan_index) const;
   int32_t Tone_Increment_Key();
-  void Tone_Increment_Sample_Custom(float freq, pxtnVOICETONE *vts) const;
+  // Returns whether any voice is still sounding.
+  bool Tone_Increment_Sample_Custom(float freq, pxtnVOICETONE *vts) const;
   void Tone_Increment_Sample(float freq);
+  // Whether sampling would only give silence until a voice starts, so the
+  // envelope, sample, supple and sample increment steps can be skipped. The
+  // key still needs incrementing for portamento.
+  bool Tone_IsQuiet() const;
 
   bool set_woice(std::shared_ptr<const pxtnWoice> p_woice, bool resetKey);
   std::shared_ptr<const pxtnWoice> get_woice() const;
 
+  // Getting a tone to change might start it, so this wakes the unit up.
   pxtnVOICETONE *get_tone(int32_t voice_idx);
+  const pxtnVOICETONE *get_tone(int32_t voice_idx) const;
 };
 
 class pxtnUnit {
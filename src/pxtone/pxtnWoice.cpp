@@ -147,6 +147,8 @@ bool pxtnWoice::Copy(pxtnWoice* p_dst) const {
 
   memcpy(p_dst->_name_buf, _name_buf, sizeof(_name_buf));
   p_dst->_name_size = _name_size;
+  p_dst->_x3x_tuning = _x3x_tuning;
+  p_dst->_x3x_basic_key = _x3x_basic_key;
 
   for (v = 0; v < _voice_num; v++) {
     p_vc1 = &_voices[v];
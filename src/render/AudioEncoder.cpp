@@ -0,0 +1,50 @@
+#include "AudioEncoder.h"
+
+#include <cmath>
+
+#include "FlacEncoder.h"
+#include "VorbisEncoder.h"
+#include "WavEncoder.h"
+
+const std::vector<AudioFileFormatInfo> &audioFileFormats() {
+  static const std::vector<AudioFileFormatInfo> formats{
+      {AudioFileFormat::WAV, "WAV", "wav"},
+      {AudioFileFormat::FLAC, "FLAC", "flac"},
+#ifdef pxINCLUDE_VORBISENC
+      {AudioFileFormat::OGG_VORBIS, "Ogg Vorbis", "ogg"},
+#endif
+  };
+  return formats;
+}
+
+const AudioFileFormatInfo *audioFileFormatOfSuffix(const QString &suffix) {
+  for (const AudioFileFormatInfo &info : audioFileFormats())
+    if (suffix.compare(info.suffix, Qt::CaseInsensitive) == 0) return &info;
+  return nullptr;
+}
+
+bool AudioEncoder::write(const float *samples, int num_samples) {
+  // Only called with a chunk at a time, so the copy stays small.
+  std::vector<qint16> clipped(size_t(num_samples) * m_num_channels);
+  for (size_t i = 0; i < clipped.size(); ++i)
+    clipped[i] = qint16(qBound(-32768l, std::lround(samples[i] * 32768.f),
+                               32767l));
+  return write(clipped.data(), num_samples);
+}
+
+std::unique_ptr<AudioEncoder> AudioEncoder::make(AudioFileFormat format,
+                                                 bool float_samples) {
+  switch (format) {
+    case AudioFileFormat::WAV:
+      return std::make_unique<WavEncoder>(float_samples);
+    case AudioFileFormat::FLAC:
+      return std::make_unique<FlacEncoder>();
+    case AudioFileFormat::OGG_VORBIS:
+#ifdef pxINCLUDE_VORBISENC
+      return std::make_unique<VorbisEncoder>();
+#else
+      break;
+#endif
+  }
+  return nullptr;
+}
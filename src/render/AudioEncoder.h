@@ -0,0 +1,47 @@
+#ifndef AUDIOENCODER_H
+#define AUDIOENCODER_H
+
+#include <QIODevice>
+#include <QString>
+#include <memory>
+#include <vector>
+
+enum class AudioFileFormat { WAV, FLAC, OGG_VORBIS };
+
+struct AudioFileFormatInfo {
+  AudioFileFormat format;
+  QString name;
+  QString suffix;
+};
+
+// The formats this build can write, WAV first.
+const std::vector<AudioFileFormatInfo> &audioFileFormats();
+const AudioFileFormatInfo *audioFileFormatOfSuffix(const QString &suffix);
+
+// Turns interleaved 16-bit or float PCM into a file of some format. Calls go
+// begin, write..., end.
+class AudioEncoder {
+ public:
+  virtual ~AudioEncoder() = default;
+  // [num_samples] is how many sample frames are expected in total, for formats
+  // that want to know the length up front.
+  virtual bool begin(QIODevice *dev, int num_channels, int sample_rate,
+                     qint64 num_samples) = 0;
+  virtual bool write(const qint16 *samples, int num_samples) = 0;
+  // Float samples have 16-bit full scale at 1.0 and may go past it. Formats
+  // without float support clip them to 16 bits.
+  virtual bool write(const float *samples, int num_samples);
+  virtual bool end() = 0;
+
+  // With [float_samples], formats that can store float do, rather than
+  // 16-bit.
+  static std::unique_ptr<AudioEncoder> make(AudioFileFormat format,
+                                            bool float_samples = false);
+
+ protected:
+  AudioEncoder() : m_num_channels(0) {}
+  // Set by begin().
+  int m_num_channels;
+};
+
+#endif  // AUDIOENCODER_H
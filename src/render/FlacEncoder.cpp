@@ -0,0 +1,405 @@
+#include "FlacEncoder.h"
+
+#include <QDebug>
+#include <QtEndian>
+#include <algorithm>
+#include <limits>
+
+// https://xiph.org/flac/format.html
+constexpr int BLOCK_SIZE = 4096;
+constexpr int BITS_PER_SAMPLE = 16;
+constexpr int MAX_FIXED_ORDER = 4;
+constexpr int MAX_PARTITION_ORDER = 8;
+constexpr int MAX_RICE_PARAM = 14;  // 15 is the escape code
+constexpr size_t OUTPUT_CHUNK = 1 << 20;
+
+namespace {
+class BitWriter {
+  std::vector<uchar> &m_buf;
+  quint64 m_acc;
+  int m_bits;
+
+ public:
+  BitWriter(std::vector<uchar> &buf) : m_buf(buf), m_acc(0), m_bits(0) {}
+
+  // [bits] <= 32
+  void put(quint32 value, int bits) {
+    if (bits == 0) return;
+    m_acc = (m_acc << bits) | (value & ((quint64(1) << bits) - 1));
+    m_bits += bits;
+    while (m_bits >= 8) {
+      m_bits -= 8;
+      m_buf.push_back(uchar(m_acc >> m_bits));
+    }
+  }
+
+  void putSigned(qint32 value, int bits) { put(quint32(value), bits); }
+
+  void putRice(qint32 value, int k) {
+    quint32 u = (quint32(value) << 1) ^ quint32(value >> 31);
+    quint32 q = u >> k;
+    for (; q >= 32; q -= 32) put(0, 32);
+    put(1, q + 1);
+    put(u, k);
+  }
+
+  void putUtf8(quint32 value) {
+    if (value < 0x80) {
+      put(value, 8);
+      return;
+    }
+    int extra = (value < 0x800       ? 1
+                 : value < 0x10000   ? 2
+                 : value < 0x200000  ? 3
+                 : value < 0x4000000 ? 4
+                                     : 5);
+    // Leading byte: (extra + 1) ones, a zero, then the top bits.
+    put(((1 << (extra + 1)) - 1) << 1, extra + 2);
+    put(value >> (6 * extra), 8 - (extra + 2));
+    for (int i = extra - 1; i >= 0; --i)
+      put(0x80 | ((value >> (6 * i)) & 0x3F), 8);
+  }
+
+  void alignToByte() {
+    if (m_bits > 0) put(0, 8 - m_bits);
+  }
+};
+
+uchar crc8(const uchar *data, size_t len) {
+  uchar crc = 0;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; ++b)
+      crc = uchar((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+  }
+  return crc;
+}
+
+quint16 crc16(const uchar *data, size_t len) {
+  static const std::vector<quint16> table = [] {
+    std::vector<quint16> t(256);
+    for (int i = 0; i < 256; ++i) {
+      quint16 crc = quint16(i << 8);
+      for (int b = 0; b < 8; ++b)
+        crc = quint16((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1);
+      t[i] = crc;
+    }
+    return t;
+  }();
+  quint16 crc = 0;
+  for (size_t i = 0; i < len; ++i)
+    crc = quint16((crc << 8) ^ table[(crc >> 8) ^ data[i]]);
+  return crc;
+}
+
+// How to code one channel of a block.
+struct Subframe {
+  enum Type { CONSTANT, VERBATIM, FIXED } type;
+  int order;
+  int partition_order;
+  std::vector<int> rice_params;
+  std::vector<qint32> residual;
+  quint64 bits;
+};
+
+void fixedResidual(const qint32 *x, int n, int order, qint32 *r) {
+  for (int i = order; i < n; ++i) switch (order) {
+      case 0:
+        r[i] = x[i];
+        break;
+      case 1:
+        r[i] = x[i] - x[i - 1];
+        break;
+      case 2:
+        r[i] = x[i] - 2 * x[i - 1] + x[i - 2];
+        break;
+      case 3:
+        r[i] = x[i] - 3 * x[i - 1] + 3 * x[i - 2] - x[i - 3];
+        break;
+      case 4:
+        r[i] = x[i] - 4 * x[i - 1] + 6 * x[i - 2] - 4 * x[i - 3] + x[i - 4];
+        break;
+    }
+}
+
+// Pick a Rice parameter for a partition whose zigzagged residuals sum to
+// [sum], and estimate the bits it takes.
+int riceParam(quint64 sum, quint64 count, quint64 *bits) {
+  int k = 0;
+  while (k < MAX_RICE_PARAM && (count << (k + 1)) < sum) ++k;
+  *bits = 4 + count * (k + 1) + (sum >> k);
+  return k;
+}
+
+// Choose the partition order and Rice parameters for the residual r[order..n).
+void chooseRice(Subframe &s, int n) {
+  int max_p = 0;
+  while (max_p < MAX_PARTITION_ORDER && n % (2 << max_p) == 0 &&
+         (n >> (max_p + 1)) > s.order)
+    ++max_p;
+
+  // Sums for the finest partitioning, which coarser ones are merged from.
+  std::vector<quint64> sums(1 << max_p, 0);
+  int part_len = n >> max_p;
+  for (int i = s.order; i < n; ++i) {
+    qint32 r = s.residual[i];
+    sums[i / part_len] += (quint32(r) << 1) ^ quint32(r >> 31);
+  }
+
+  s.bits = std::numeric_limits<quint64>::max();
+  for (int p = max_p; p >= 0; --p) {
+    int parts = 1 << p;
+    std::vector<int> params(parts);
+    quint64 bits = 2 + 4;
+    for (int j = 0; j < parts; ++j) {
+      quint64 count = (n >> p) - (j == 0 ? s.order : 0);
+      quint64 part_bits;
+      params[j] = riceParam(sums[j], count, &part_bits);
+      bits += part_bits;
+    }
+    if (bits < s.bits) {
+      s.bits = bits;
+      s.partition_order = p;
+      s.rice_params = std::move(params);
+    }
+    if (p > 0)
+      for (int j = 0; j < parts / 2; ++j)
+        sums[j] = sums[2 * j] + sums[2 * j + 1];
+  }
+}
+
+Subframe analyze(const qint32 *x, int n, int bps) {
+  Subframe best;
+  bool constant = true;
+  for (int i = 1; i < n && constant; ++i) constant = (x[i] == x[0]);
+  if (constant) {
+    best.type = Subframe::CONSTANT;
+    best.bits = 8 + bps;
+    return best;
+  }
+
+  best.type = Subframe::VERBATIM;
+  best.bits = 8 + quint64(n) * bps;
+  Subframe s;
+  s.type = Subframe::FIXED;
+  s.residual.resize(n);
+  for (int order = 0; order <= std::min(MAX_FIXED_ORDER, n - 1); ++order) {
+    s.order = order;
+    fixedResidual(x, n, order, s.residual.data());
+    chooseRice(s, n);
+    s.bits += 8 + quint64(order) * bps;
+    if (s.bits < best.bits) best = s;
+  }
+  return best;
+}
+
+void writeSubframe(BitWriter &w, const Subframe &s, const qint32 *x, int n,
+                   int bps) {
+  w.put(0, 1);
+  switch (s.type) {
+    case Subframe::CONSTANT:
+      w.put(0b000000, 6);
+      w.put(0, 1);
+      w.putSigned(x[0], bps);
+      break;
+    case Subframe::VERBATIM:
+      w.put(0b000001, 6);
+      w.put(0, 1);
+      for (int i = 0; i < n; ++i) w.putSigned(x[i], bps);
+      break;
+    case Subframe::FIXED: {
+      w.put(0b001000 | s.order, 6);
+      w.put(0, 1);
+      for (int i = 0; i < s.order; ++i) w.putSigned(x[i], bps);
+      w.put(0, 2);  // Rice coding with 4-bit parameters
+      w.put(s.partition_order, 4);
+      int part_len = n >> s.partition_order;
+      for (size_t j = 0; j < s.rice_params.size(); ++j) {
+        int k = s.rice_params[j];
+        w.put(k, 4);
+        int start = (j == 0 ? s.order : j * part_len);
+        for (int i = start; i < int(j + 1) * part_len; ++i)
+          w.putRice(s.residual[i], k);
+      }
+    } break;
+  }
+}
+}  // namespace
+
+FlacEncoder::FlacEncoder()
+    : m_dev(nullptr),
+      m_sample_rate(0),
+      m_stream_info_pos(0),
+      m_written_samples(0),
+      m_frame_num(0),
+      m_min_frame_size(0),
+      m_max_frame_size(0),
+      m_md5(QCryptographicHash::Md5) {}
+
+bool FlacEncoder::writeStreamInfo(qint64 num_samples, const QByteArray &md5) {
+  std::vector<uchar> buf;
+  BitWriter w(buf);
+  w.put(1, 1);  // last metadata block
+  w.put(0, 7);  // STREAMINFO
+  w.put(34, 24);
+  w.put(BLOCK_SIZE, 16);
+  w.put(BLOCK_SIZE, 16);
+  w.put(m_min_frame_size, 24);
+  w.put(m_max_frame_size, 24);
+  w.put(m_sample_rate, 20);
+  w.put(m_num_channels - 1, 3);
+  w.put(BITS_PER_SAMPLE - 1, 5);
+  w.put(quint32(quint64(num_samples) >> 32), 4);
+  w.put(quint32(num_samples), 32);
+  for (int i = 0; i < 16; ++i) w.put(i < md5.size() ? uchar(md5[i]) : 0, 8);
+  return m_dev->write((const char *)buf.data(), buf.size()) ==
+         qint64(buf.size());
+}
+
+bool FlacEncoder::begin(QIODevice *dev, int num_channels, int sample_rate,
+                        qint64 num_samples) {
+  if (num_channels < 1 || num_channels > 2) {
+    qWarning() << "FLAC encoder only supports mono and stereo";
+    return false;
+  }
+  m_dev = dev;
+  m_num_channels = num_channels;
+  m_sample_rate = sample_rate;
+  m_written_samples = 0;
+  m_frame_num = 0;
+  m_min_frame_size = m_max_frame_size = 0;
+  m_md5.reset();
+  m_pending.clear();
+  m_out.clear();
+  if (m_dev->write("fLaC", 4) != 4) return false;
+  m_stream_info_pos = m_dev->pos();
+  return writeStreamInfo(num_samples, QByteArray());
+}
+
+void FlacEncoder::encodeFrame(const qint32 *samples, int n) {
+  std::vector<std::vector<qint32>> channels(m_num_channels,
+                                            std::vector<qint32>(n));
+  for (int i = 0; i < n; ++i)
+    for (int ch = 0; ch < m_num_channels; ++ch)
+      channels[ch][i] = samples[i * m_num_channels + ch];
+
+  // Which channels to code, how many bits each, and the assignment code.
+  std::vector<const std::vector<qint32> *> coded;
+  std::vector<int> bps;
+  std::vector<Subframe> subframes;
+  int assignment = m_num_channels - 1;
+  std::vector<qint32> mid, side;
+  if (m_num_channels == 1) {
+    coded = {&channels[0]};
+    bps = {BITS_PER_SAMPLE};
+    subframes.push_back(analyze(channels[0].data(), n, BITS_PER_SAMPLE));
+  } else {
+    const std::vector<qint32> &left = channels[0], &right = channels[1];
+    mid.resize(n);
+    side.resize(n);
+    for (int i = 0; i < n; ++i) {
+      mid[i] = (left[i] + right[i]) >> 1;
+      side[i] = left[i] - right[i];
+    }
+    Subframe l = analyze(left.data(), n, BITS_PER_SAMPLE),
+             r = analyze(right.data(), n, BITS_PER_SAMPLE),
+             m = analyze(mid.data(), n, BITS_PER_SAMPLE),
+             s = analyze(side.data(), n, BITS_PER_SAMPLE + 1);
+    quint64 independent = l.bits + r.bits, left_side = l.bits + s.bits,
+            right_side = s.bits + r.bits, mid_side = m.bits + s.bits;
+    quint64 best =
+        std::min({independent, left_side, right_side, mid_side});
+    if (best == independent) {
+      coded = {&left, &right};
+      bps = {BITS_PER_SAMPLE, BITS_PER_SAMPLE};
+      subframes = {std::move(l), std::move(r)};
+    } else if (best == left_side) {
+      assignment = 0b1000;
+      coded = {&left, &side};
+      bps = {BITS_PER_SAMPLE, BITS_PER_SAMPLE + 1};
+      subframes = {std::move(l), std::move(s)};
+    } else if (best == right_side) {
+      assignment = 0b1001;
+      coded = {&side, &right};
+      bps = {BITS_PER_SAMPLE + 1, BITS_PER_SAMPLE};
+      subframes = {std::move(s), std::move(r)};
+    } else {
+      assignment = 0b1010;
+      coded = {&mid, &side};
+      bps = {BITS_PER_SAMPLE, BITS_PER_SAMPLE + 1};
+      subframes = {std::move(m), std::move(s)};
+    }
+  }
+
+  size_t frame_start = m_out.size();
+  BitWriter w(m_out);
+  w.put(0b11111111111110, 14);
+  w.put(0, 1);       // reserved
+  w.put(0, 1);       // fixed blocksize
+  w.put(0b0111, 4);  // blocksize - 1 follows as 16 bits
+  w.put(0b0000, 4);  // sample rate from STREAMINFO
+  w.put(assignment, 4);
+  w.put(0b100, 3);  // 16 bits per sample
+  w.put(0, 1);
+  w.putUtf8(m_frame_num);
+  w.put(n - 1, 16);
+  w.put(crc8(m_out.data() + frame_start, m_out.size() - frame_start), 8);
+
+  for (size_t ch = 0; ch < coded.size(); ++ch)
+    writeSubframe(w, subframes[ch], coded[ch]->data(), n, bps[ch]);
+  w.alignToByte();
+  w.put(crc16(m_out.data() + frame_start, m_out.size() - frame_start), 16);
+
+  quint32 frame_size = quint32(m_out.size() - frame_start);
+  if (m_frame_num == 0 || frame_size < m_min_frame_size)
+    m_min_frame_size = frame_size;
+  m_max_frame_size = std::max(m_max_frame_size, frame_size);
+  ++m_frame_num;
+}
+
+bool FlacEncoder::flush(size_t threshold) {
+  if (m_out.size() < threshold || m_out.empty()) return true;
+  qint64 len = qint64(m_out.size());
+  if (m_dev->write((const char *)m_out.data(), len) < len) {
+    qWarning() << "Unable to fill file buffer";
+    return false;
+  }
+  m_out.clear();
+  return true;
+}
+
+bool FlacEncoder::write(const qint16 *samples, int num_samples) {
+  size_t len = size_t(num_samples) * m_num_channels;
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+  for (size_t i = 0; i < len; ++i) {
+    qint16 s = qToLittleEndian(samples[i]);
+    m_md5.addData((const char *)&s, sizeof(s));
+  }
+#else
+  m_md5.addData((const char *)samples, int(len * sizeof(qint16)));
+#endif
+  m_pending.insert(m_pending.end(), samples, samples + len);
+  m_written_samples += num_samples;
+
+  size_t frame_len = size_t(BLOCK_SIZE) * m_num_channels;
+  size_t consumed = 0;
+  for (; m_pending.size() - consumed >= frame_len; consumed += frame_len)
+    encodeFrame(m_pending.data() + consumed, BLOCK_SIZE);
+  m_pending.erase(m_pending.begin(), m_pending.begin() + consumed);
+  return flush(OUTPUT_CHUNK);
+}
+
+bool FlacEncoder::end() {
+  if (!m_pending.empty())
+    encodeFrame(m_pending.data(), int(m_pending.size() / m_num_channels));
+  m_pending.clear();
+  if (!flush(0)) return false;
+
+  // Fill in what we only know now: frame sizes, the real length and the MD5.
+  if (m_dev->isSequential()) return true;
+  qint64 end_pos = m_dev->pos();
+  if (!m_dev->seek(m_stream_info_pos) ||
+      !writeStreamInfo(m_written_samples, m_md5.result()))
+    return false;
+  return m_dev->seek(end_pos);
+}
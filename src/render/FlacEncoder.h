@@ -0,0 +1,39 @@
+#ifndef FLACENCODER_H
+#define FLACENCODER_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+
+#include "AudioEncoder.h"
+
+// A small FLAC encoder: fixed blocksize, fixed predictors (order 0-4), stereo
+// decorrelation and partitioned Rice coding. No LPC, so files are a bit
+// larger than the reference encoder's, but still lossless and well below WAV.
+class FlacEncoder : public AudioEncoder {
+  QIODevice *m_dev;
+  int m_sample_rate;
+  qint64 m_stream_info_pos;
+  qint64 m_written_samples;
+  quint32 m_frame_num;
+  quint32 m_min_frame_size;
+  quint32 m_max_frame_size;
+  QCryptographicHash m_md5;
+  // Interleaved samples that don't fill a block yet.
+  std::vector<qint32> m_pending;
+  // Encoded bytes, written out in large chunks.
+  std::vector<uchar> m_out;
+
+  bool writeStreamInfo(qint64 num_samples, const QByteArray &md5);
+  void encodeFrame(const qint32 *samples, int block_size);
+  bool flush(size_t threshold);
+
+ public:
+  FlacEncoder();
+  bool begin(QIODevice *dev, int num_channels, int sample_rate,
+             qint64 num_samples) override;
+  using AudioEncoder::write;
+  bool write(const qint16 *samples, int num_samples) override;
+  bool end() override;
+};
+
+#endif  // FLACENCODER_H
@@ -0,0 +1,24 @@
+#include "RenderJob.h"
+
+RenderJob::RenderJob(std::shared_ptr<const pxtnService> pxtn,
+                     const QString &destination,
+                     const RenderSettings &settings, QObject *parent)
+    : QThread(parent),
+      m_pxtn(std::move(pxtn)),
+      m_destination(destination),
+      m_settings(settings),
+      m_cancelled(false),
+      m_succeeded(false) {}
+
+void RenderJob::run() {
+  try {
+    m_succeeded = renderToFile(m_pxtn.get(), m_destination, m_settings,
+                               [this](double progress) {
+                                 emit progressed(progress);
+                                 return !m_cancelled;
+                               });
+  } catch (const QString &e) {
+    m_error = e;
+    m_succeeded = false;
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef RENDERJOB_H
+#define RENDERJOB_H
+
+#include <QThread>
+#include <atomic>
+
+#include "Renderer.h"
+
+// Renders a snapshot of the project on its own thread, so that the editor
+// stays usable in the meantime.
+class RenderJob : public QThread {
+  Q_OBJECT
+  std::shared_ptr<const pxtnService> m_pxtn;
+  QString m_destination;
+  RenderSettings m_settings;
+  std::atomic<bool> m_cancelled;
+  bool m_succeeded;
+  QString m_error;
+
+ protected:
+  void run() override;
+
+ public:
+  RenderJob(std::shared_ptr<const pxtnService> pxtn,
+            const QString &destination, const RenderSettings &settings,
+            QObject *parent = nullptr);
+  void cancel() { m_cancelled = true; }
+  // Only meaningful once the job has finished.
+  bool succeeded() const { return m_succeeded; }
+  const QString &error() const { return m_error; }
+
+ signals:
+  void progressed(double progress);
+};
+
+#endif  // RENDERJOB_H
@@ -0,0 +1,120 @@
+#include "Renderer.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+
+QString stemDestination(const QString &destination, pxtnSTEMKIND stems,
+                        int index) {
+  QFileInfo info(destination);
+  QString kind = (stems == pxtnSTEM_unit ? "unit" : "group");
+  return info.dir().filePath(QString("%1_%2%3.%4")
+                                 .arg(info.completeBaseName())
+                                 .arg(kind)
+                                 .arg(index, 2, 10, QChar('0'))
+                                 .arg(info.suffix()));
+}
+
+namespace {
+struct Output {
+  QString filename;
+  std::unique_ptr<QSaveFile> file;
+  std::unique_ptr<AudioEncoder> encoder;
+};
+}  // namespace
+
+// Rendered a chunk at a time, big enough that encoders write in large pieces.
+constexpr int CHUNK_SAMPLES = 1 << 16;
+
+static bool writeSamples(AudioEncoder *encoder, const char *buf,
+                         int num_samples, bool float_samples) {
+  if (float_samples)
+    return encoder->write((const float *)buf, num_samples);
+  return encoder->write((const qint16 *)buf, num_samples);
+}
+
+bool renderToFile(const pxtnService *pxtn, const QString &destination,
+                  const RenderSettings &settings,
+                  std::function<bool(double progress)> should_continue) {
+  qDebug() << "Rendering" << destination << settings.length
+           << settings.fadeout;
+  int num_channels, sample_rate, byte_per_smp;
+  pxtn->get_destination_quality(&num_channels, &sample_rate);
+  pxtn->get_byte_per_smp(&byte_per_smp);
+  bool float_samples =
+      (pxtn->get_destination_format() == pxtnSAMPLEFORMAT_f32);
+  qint64 main_samples = qint64(sample_rate * settings.length);
+  qint64 num_samples = main_samples;
+  if (settings.fadeout > 0)
+    num_samples += qint64(sample_rate * settings.fadeout) + 10;
+
+  mooState moo_state;
+  if (pxtn->delays_ready(moo_state) != pxtnOK)
+    throw QString("Error getting delays ready");
+  moo_state.profile = settings.profile;
+  pxtnVOMITPREPARATION prep{};
+  prep.flags |= pxtnVOMITPREPFLAG_loop | pxtnVOMITPREPFLAG_unit_mute;
+  prep.start_pos_sample = 0;
+  prep.master_volume = moo_state.params.master_vol;
+  if (!pxtn->moo_preparation(&prep, moo_state))
+    throw QString("Moo preparation error");
+
+  int stem_num = pxtn->moo_get_stem_num(settings.stems);
+  std::vector<Output> outputs;
+  for (int i = -1; i < stem_num; ++i) {
+    Output o;
+    o.filename = (i < 0 ? destination
+                        : stemDestination(destination, settings.stems, i));
+    o.file = std::make_unique<QSaveFile>(o.filename);
+    o.encoder = AudioEncoder::make(settings.format, float_samples);
+    if (!o.encoder) throw QString("This render format is not supported");
+    if (!o.file->open(QIODevice::WriteOnly))
+      throw QString("Could not open %1 for writing").arg(o.filename);
+    if (!o.encoder->begin(o.file.get(), num_channels, sample_rate,
+                          num_samples))
+      throw QString("Could not write to %1").arg(o.filename);
+    outputs.push_back(std::move(o));
+  }
+
+  // Bytes, since the sample format depends on [pxtn].
+  std::vector<char> buf(size_t(CHUNK_SAMPLES) * byte_per_smp);
+  std::vector<char> stem_buf(buf.size() * stem_num);
+  std::vector<char> stem(stem_num > 0 ? buf.size() : 0);
+  for (qint64 written = 0; written < num_samples;) {
+    if (written == main_samples)
+      pxtn->moo_set_fade(-1, settings.fadeout, moo_state);
+    qint64 phase_end = (written < main_samples ? main_samples : num_samples);
+    int n = int(std::min(qint64(CHUNK_SAMPLES), phase_end - written));
+
+    if (!pxtn->Moo(moo_state, buf.data(), n * byte_per_smp, nullptr,
+                   settings.stems, stem_num > 0 ? stem_buf.data() : nullptr)) {
+      // Once the fade out is over the song stops, and the rest is silence.
+      if (!moo_state.end_vomit) throw QString("Moo error during rendering");
+      std::fill(buf.begin(), buf.end(), 0);
+      std::fill(stem_buf.begin(), stem_buf.end(), 0);
+    }
+
+    if (!writeSamples(outputs[0].encoder.get(), buf.data(), n, float_samples))
+      throw QString("Could not write to %1").arg(outputs[0].filename);
+    for (int s = 0; s < stem_num; ++s) {
+      for (int i = 0; i < n; ++i)
+        memcpy(&stem[size_t(i) * byte_per_smp],
+               &stem_buf[(size_t(i) * stem_num + s) * byte_per_smp],
+               byte_per_smp);
+      if (!writeSamples(outputs[s + 1].encoder.get(), stem.data(), n,
+                        float_samples))
+        throw QString("Could not write to %1").arg(outputs[s + 1].filename);
+    }
+
+    written += n;
+    if (!should_continue(double(written) / num_samples)) return false;
+  }
+
+  for (Output &o : outputs)
+    if (!o.encoder->end() || !o.file->commit())
+      throw QString("Could not finish writing %1").arg(o.filename);
+  return true;
+}
@@ -0,0 +1,36 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include <QString>
+#include <functional>
+#include <memory>
+
+#include "AudioEncoder.h"
+#include "pxtone/pxtnService.h"
+
+struct RenderSettings {
+  // Seconds, not counting the fade out.
+  double length;
+  double fadeout;
+  AudioFileFormat format;
+  // Also write a file per unit / group next to the full mix.
+  pxtnSTEMKIND stems;
+  // If set, where to profile the moo.
+  pxtnMooProfile *profile = nullptr;
+};
+
+// Where stem [index] of a render to [destination] goes.
+QString stemDestination(const QString &destination, pxtnSTEMKIND stems,
+                        int index);
+
+// Renders [pxtn] to [destination] (and its stems) with its own moo state.
+// Its woices must already be ready. Returns false if [should_continue] asked
+// to stop. Throws a QString on failure.
+bool renderToFile(
+    const pxtnService *pxtn, const QString &destination,
+    const RenderSettings &settings,
+    std::function<bool(double progress)> should_continue = [](double) {
+      return true;
+    });
+
+#endif  // RENDERER_H
@@ -0,0 +1,116 @@
+#include "VorbisEncoder.h"
+
+#ifdef pxINCLUDE_VORBISENC
+#include <QDebug>
+#include <QRandomGenerator>
+
+// Roughly 160kbps for stereo 44.1kHz.
+constexpr float VORBIS_QUALITY = 0.5f;
+// libvorbis wants its input in modest pieces.
+constexpr int ANALYSIS_CHUNK = 1024;
+
+VorbisEncoder::VorbisEncoder()
+    : m_dev(nullptr), m_started(false) {}
+
+VorbisEncoder::~VorbisEncoder() { clear(); }
+
+void VorbisEncoder::clear() {
+  if (!m_started) return;
+  ogg_stream_clear(&m_os);
+  vorbis_block_clear(&m_vb);
+  vorbis_dsp_clear(&m_vd);
+  vorbis_comment_clear(&m_vc);
+  vorbis_info_clear(&m_vi);
+  m_started = false;
+}
+
+bool VorbisEncoder::writePage(const ogg_page &og) {
+  if (m_dev->write((const char *)og.header, og.header_len) < og.header_len ||
+      m_dev->write((const char *)og.body, og.body_len) < og.body_len) {
+    qWarning() << "Unable to fill file buffer";
+    return false;
+  }
+  return true;
+}
+
+bool VorbisEncoder::begin(QIODevice *dev, int num_channels, int sample_rate,
+                          qint64 num_samples) {
+  (void)num_samples;
+  clear();
+  m_dev = dev;
+  m_num_channels = num_channels;
+  vorbis_info_init(&m_vi);
+  if (vorbis_encode_init_vbr(&m_vi, num_channels, sample_rate,
+                             VORBIS_QUALITY) != 0) {
+    qWarning() << "Could not set up vorbis encoder";
+    vorbis_info_clear(&m_vi);
+    return false;
+  }
+  vorbis_comment_init(&m_vc);
+  vorbis_comment_add_tag(&m_vc, "ENCODER", "ptcollab");
+  vorbis_analysis_init(&m_vd, &m_vi);
+  vorbis_block_init(&m_vd, &m_vb);
+  ogg_stream_init(&m_os, int(QRandomGenerator::global()->generate() >> 1));
+  m_started = true;
+
+  ogg_packet header, header_comm, header_code;
+  vorbis_analysis_headerout(&m_vd, &m_vc, &header, &header_comm, &header_code);
+  ogg_stream_packetin(&m_os, &header);
+  ogg_stream_packetin(&m_os, &header_comm);
+  ogg_stream_packetin(&m_os, &header_code);
+  // The headers need to be on their own pages.
+  ogg_page og;
+  while (ogg_stream_flush(&m_os, &og) != 0)
+    if (!writePage(og)) return false;
+  return true;
+}
+
+bool VorbisEncoder::drain() {
+  ogg_packet op;
+  ogg_page og;
+  while (vorbis_analysis_blockout(&m_vd, &m_vb) == 1) {
+    vorbis_analysis(&m_vb, nullptr);
+    vorbis_bitrate_addblock(&m_vb);
+    while (vorbis_bitrate_flushpacket(&m_vd, &op)) {
+      ogg_stream_packetin(&m_os, &op);
+      while (ogg_stream_pageout(&m_os, &og) != 0)
+        if (!writePage(og)) return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+bool VorbisEncoder::writeScaled(const T *samples, int num_samples,
+                                float scale) {
+  while (num_samples > 0) {
+    int n = std::min(num_samples, ANALYSIS_CHUNK);
+    float **buffer = vorbis_analysis_buffer(&m_vd, n);
+    for (int i = 0; i < n; ++i)
+      for (int ch = 0; ch < m_num_channels; ++ch)
+        buffer[ch][i] = samples[i * m_num_channels + ch] * scale;
+    vorbis_analysis_wrote(&m_vd, n);
+    if (!drain()) return false;
+    samples += n * m_num_channels;
+    num_samples -= n;
+  }
+  return true;
+}
+
+bool VorbisEncoder::write(const qint16 *samples, int num_samples) {
+  return writeScaled(samples, num_samples, 1 / 32768.f);
+}
+
+bool VorbisEncoder::write(const float *samples, int num_samples) {
+  return writeScaled(samples, num_samples, 1.f);
+}
+
+bool VorbisEncoder::end() {
+  vorbis_analysis_wrote(&m_vd, 0);
+  bool ok = drain();
+  ogg_page og;
+  while (ok && ogg_stream_flush(&m_os, &og) != 0) ok = writePage(og);
+  clear();
+  return ok;
+}
+#endif
@@ -0,0 +1,35 @@
+#ifndef VORBISENCODER_H
+#define VORBISENCODER_H
+
+#ifdef pxINCLUDE_VORBISENC
+#include <vorbis/vorbisenc.h>
+
+#include "AudioEncoder.h"
+
+class VorbisEncoder : public AudioEncoder {
+  QIODevice *m_dev;
+  bool m_started;
+  ogg_stream_state m_os;
+  vorbis_info m_vi;
+  vorbis_comment m_vc;
+  vorbis_dsp_state m_vd;
+  vorbis_block m_vb;
+
+  bool writePage(const ogg_page &og);
+  bool drain();
+  template <typename T>
+  bool writeScaled(const T *samples, int num_samples, float scale);
+  void clear();
+
+ public:
+  VorbisEncoder();
+  ~VorbisEncoder();
+  bool begin(QIODevice *dev, int num_channels, int sample_rate,
+             qint64 num_samples) override;
+  bool write(const qint16 *samples, int num_samples) override;
+  bool write(const float *samples, int num_samples) override;
+  bool end() override;
+};
+#endif
+
+#endif  // VORBISENCODER_H
@@ -0,0 +1,116 @@
+#include "WavEncoder.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QtEndian>
+
+// from
+// https://stackoverflow.com/questions/40238343/qfile-write-a-wav-header-writes-only-4-byte-data
+struct WavHdr {
+  constexpr static quint32 k_riff_id = 0x46464952;
+  constexpr static quint32 k_wave_format = 0x45564157;
+  constexpr static quint32 k_fmt_id = 0x20746d66;
+  constexpr static quint32 k_data_id = 0x61746164;
+  // RIFF
+  quint32 chunk_id = k_riff_id;
+  quint32 chunk_size;
+  quint32 chunk_format = k_wave_format;
+  // fmt
+  quint32 fmt_id = k_fmt_id;
+  quint32 fmt_size;
+  quint16 audio_format;
+  quint16 num_channels;
+  quint32 sample_rate;
+  quint32 byte_rate;
+  quint16 block_align;
+  quint16 bits_per_sample;
+  // data
+  quint32 data_id = k_data_id;
+  quint32 data_size;
+};
+
+static bool write(QIODevice *dev, const WavHdr &h) {
+  QDataStream s{dev};
+  s.setByteOrder(QDataStream::LittleEndian);  // for RIFF
+  s << h.chunk_id << h.chunk_size << h.chunk_format;
+  s << h.fmt_id << h.fmt_size << h.audio_format << h.num_channels
+    << h.sample_rate << h.byte_rate << h.block_align << h.bits_per_sample;
+  s << h.data_id << h.data_size;
+  return s.status() == QDataStream::Ok;
+}
+
+WavEncoder::WavEncoder(bool float_samples)
+    : m_dev(nullptr),
+      m_float_samples(float_samples),
+      m_sample_rate(0),
+      m_header_pos(0),
+      m_expected_samples(0),
+      m_written_samples(0) {}
+
+bool WavEncoder::writeHeader(qint64 num_samples) {
+  WavHdr h;
+  h.fmt_size = 16;
+  // WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_PCM
+  h.bits_per_sample = (m_float_samples ? 32 : 16);
+  h.audio_format = (m_float_samples ? 3 : 1);
+  h.num_channels = m_num_channels;
+  h.sample_rate = m_sample_rate;
+  h.block_align = h.num_channels * h.bits_per_sample / 8;
+  h.byte_rate = h.sample_rate * h.block_align;
+  h.data_size = quint32(num_samples * h.block_align);
+  h.chunk_size = 36 + h.data_size;
+  return ::write(m_dev, h);
+}
+
+bool WavEncoder::begin(QIODevice *dev, int num_channels, int sample_rate,
+                       qint64 num_samples) {
+  m_dev = dev;
+  m_num_channels = num_channels;
+  m_sample_rate = sample_rate;
+  m_header_pos = dev->pos();
+  m_expected_samples = num_samples;
+  m_written_samples = 0;
+  return writeHeader(num_samples);
+}
+
+template <typename T>
+bool WavEncoder::writeLittleEndian(const T *samples, int num_samples) {
+  qint64 len = qint64(num_samples) * m_num_channels * sizeof(T);
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+  std::vector<T> le(samples, samples + num_samples * m_num_channels);
+  for (T &s : le) s = qToLittleEndian(s);
+  samples = le.data();
+#endif
+  if (m_dev->write((const char *)samples, len) < len) {
+    qWarning() << "Unable to fill file buffer";
+    return false;
+  }
+  m_written_samples += num_samples;
+  return true;
+}
+
+bool WavEncoder::write(const qint16 *samples, int num_samples) {
+  if (!m_float_samples) return writeLittleEndian(samples, num_samples);
+  std::vector<float> f(samples, samples + num_samples * m_num_channels);
+  for (float &s : f) s /= 32768.f;
+  return writeLittleEndian(f.data(), num_samples);
+}
+
+bool WavEncoder::write(const float *samples, int num_samples) {
+  if (!m_float_samples) return AudioEncoder::write(samples, num_samples);
+  return writeLittleEndian(samples, num_samples);
+}
+
+bool WavEncoder::end() {
+  if (m_written_samples == m_expected_samples) return true;
+  // Fix up the sizes if we ended up writing a different amount than promised.
+  if (m_dev->isSequential()) {
+    qWarning() << "Wrote" << m_written_samples << "samples to WAV instead of"
+               << m_expected_samples << "and cannot fix the header";
+    return false;
+  }
+  qint64 end_pos = m_dev->pos();
+  if (!m_dev->seek(m_header_pos) || !writeHeader(m_written_samples))
+    return false;
+  return m_dev->seek(end_pos);
+}
@@ -0,0 +1,28 @@
+#ifndef WAVENCODER_H
+#define WAVENCODER_H
+
+#include "AudioEncoder.h"
+
+class WavEncoder : public AudioEncoder {
+  QIODevice *m_dev;
+  bool m_float_samples;
+  int m_sample_rate;
+  qint64 m_header_pos;
+  qint64 m_expected_samples;
+  qint64 m_written_samples;
+
+  bool writeHeader(qint64 num_samples);
+  template <typename T>
+  bool writeLittleEndian(const T *samples, int num_samples);
+
+ public:
+  // With [float_samples], writes 32-bit float rather than 16-bit PCM.
+  WavEncoder(bool float_samples = false);
+  bool begin(QIODevice *dev, int num_channels, int sample_rate,
+             qint64 num_samples) override;
+  bool write(const qint16 *samples, int num_samples) override;
+  bool write(const float *samples, int num_samples) override;
+  bool end() override;
+};
+
+#endif  // WAVENCODER_H